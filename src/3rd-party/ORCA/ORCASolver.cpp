@@ -59,7 +59,7 @@ namespace ORCALibrary
 
 	/* Search for the best new velocity. */
 	void Solver::solveOrcaProgram(const Agent& agent, 
-		const float timeHorizon, const float currentTime, const float simulationTimeStep, const NeighborList& neighbors, const float maxDistance,
+		const float timeHorizon, const float currentTime, const float simulationTimeStep, const NeighborView& neighbors, const float maxDistance,
 		Solution& result) const
 	{
 		const Vector2D& prefVelocity_ = agent.getPreferredVelocity();
@@ -112,7 +112,7 @@ namespace ORCALibrary
 			const Vector2D& relativePosition = other.GetPosition() - position_;
 			const Vector2D& relativeVelocity = velocity_ - other.GetVelocity();
 			const float distSq = relativePosition.sqrMagnitude();
-			const float combinedRadius = radius_ + other.realAgent->getRadius();
+			const float combinedRadius = radius_ + other.GetRadius();
 			const float combinedRadiusSq = combinedRadius * combinedRadius;
 
 			Line line;
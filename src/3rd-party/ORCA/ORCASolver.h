@@ -54,7 +54,7 @@
 
 namespace ORCALibrary
 {
-	typedef std::vector<PhantomAgent> AgentNeighborList;
+	typedef Span<PhantomAgent> AgentNeighborList;
 
 	/**
 	* \brief       A sufficiently small positive number.
@@ -65,7 +65,7 @@ namespace ORCALibrary
 	{
 	public:
 		void solveOrcaProgram(const Agent& agent,
-			const float timeHorizon, const float currentTime, const float simulationTimeStep, const NeighborList& neighbors, const float maxDistance, Solution& result) const;
+			const float timeHorizon, const float currentTime, const float simulationTimeStep, const NeighborView& neighbors, const float maxDistance, Solution& result) const;
 
 	private:
 		/*void createObstacleOrcaLines(const Agent& agent, 
@@ -0,0 +1,376 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#include <core/crowdSimulator.h>
+#include <core/ScenarioGenerator.h>
+#include <tools/HelperFunctions.h>
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#endif
+
+using namespace std;
+
+/// <summary>The results of running one scenario with one number of threads.</summary>
+struct BenchmarkResult
+{
+	std::string scenario;
+	size_t nrAgents = 0;
+	int nrThreads = 1;
+	int nrSteps = 0;
+	double seconds = 0;
+	double agentSteps = 0;
+	double parallelEfficiency = 1;
+	/// <summary>The peak resident set size of the process during the run, from loading the scenario until after the last step, in kilobytes.</summary>
+	long long peakMemoryKB = 0;
+	/// <summary>Whether peakMemoryKB was measured for this run only. If the peak could not be reset before the run (e.g. on Windows), 
+	/// peakMemoryKB is the peak of the whole process so far, which may include earlier runs.</summary>
+	bool peakMemoryIsPerRun = false;
+};
+
+void printBasicInfo()
+{
+	std::cout
+		<< "-----------------------------------------------------" << std::endl
+		<< "UMANS: Unified Microscopic Agent Navigation Simulator" << std::endl
+		<< "Benchmark application" << std::endl
+		<< "-----------------------------------------------------" << std::endl << std::endl;
+}
+
+void printUsageInfo(const std::string& programName)
+{
+	std::cout
+		<< "Usage: " << programName << " [-i] [-g] [-policies] [-policy] [-a] [-t] [-s] [-w] [-o] [-label]" << std::endl
+		<< "  -i (or -input)     = (optional, repeatable) An XML file describing a scenario to run." << std::endl
+		<< "                       If you specify neither -i nor -g, the program runs examples/Circle50-ORCA.xml and examples/OneWayFlow200-ORCA.xml." << std::endl
+		<< "  -g (or -generate)  = (optional) A layout of agents to generate for each agent count:" << std::endl
+		<< "                       circle, crossing_flows, bidirectional_corridor, or random_dense." << std::endl
+		<< "  -policies          = (optional, default=examples/policies/ORCA.xml) The policies file to use for generated scenarios." << std::endl
+		<< "  -policy            = (optional, default=0) The ID of the policy that the agents of generated scenarios use." << std::endl
+		<< "  -a (or -agents)    = (optional, default=250,1000,4000) A comma-separated list of agent counts for generated scenarios." << std::endl
+		<< "  -t (or -nrThreads) = (optional, default=1,2,4) A comma-separated list of thread counts." << std::endl
+		<< "  -s (or -steps)     = (optional, default=100) The number of simulation steps to measure per run." << std::endl
+		<< "  -w (or -warmup)    = (optional, default=10) The number of steps to run before measuring." << std::endl
+		<< "  -o (or -output)    = (optional) Name of a JSON file to which the results will be written." << std::endl
+		<< "  -label             = (optional) A label to store in the JSON file, e.g. a commit hash." << std::endl << std::endl;
+}
+
+/// <summary>Parses a comma-separated list of positive integers.</summary>
+bool parseIntegerList(const std::string& str, std::vector<int>& result)
+{
+	result.clear();
+	for (const std::string& part : HelperFunctions::SplitString(str, ','))
+	{
+		const int value = atoi(part.c_str());
+		if (value < 1)
+			return false;
+		result.push_back(value);
+	}
+	return !result.empty();
+}
+
+/// <summary>Resets the peak memory usage (resident set size) of this process to its current memory usage, 
+/// so that getPeakMemoryKB() returns the peak from now on.</summary>
+/// <returns>true if the peak was reset; false if this is not supported.</returns>
+bool resetPeakMemory()
+{
+#ifdef _WIN32
+	return false;
+#else
+	// writing 5 to /proc/self/clear_refs resets the "VmHWM" value in /proc/self/status
+	std::ofstream clearRefs("/proc/self/clear_refs");
+	clearRefs << "5" << std::flush;
+	return (bool)clearRefs;
+#endif
+}
+
+/// <summary>Returns the peak memory usage (resident set size) of this process, in kilobytes, or 0 if it cannot be determined.</summary>
+long long getPeakMemoryKB()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return (long long)(counters.PeakWorkingSetSize / 1024);
+	return 0;
+#else
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line))
+		if (line.compare(0, 6, "VmHWM:") == 0)
+			return atoll(line.c_str() + 6);
+	return 0;
+#endif
+}
+
+/// <summary>Writes a scenario file that generates agents with the given layout, and returns its name (or an empty string if this failed).</summary>
+std::string generateScenario(const std::string& layout, int nrAgents, const std::string& policiesFile, int policyID)
+{
+	const auto& directory = std::filesystem::temp_directory_path();
+	const auto& filename = (directory / ("UMANS-Benchmark-" + layout + "-" + std::to_string(nrAgents) + ".xml")).string();
+
+	// the simulator looks for the policies file relative to the scenario file
+	const auto& policiesPath = std::filesystem::relative(std::filesystem::absolute(policiesFile), directory).generic_string();
+
+	std::ofstream file(filename);
+	if (!file)
+		return "";
+
+	file << "<?xml version=\"1.0\" encoding=\"utf-8\"?>" << std::endl
+		<< "<Simulation delta_time=\"0.1\">" << std::endl
+		<< "<World type=\"Infinite\" />" << std::endl
+		<< "<Policies file=\"" << policiesPath << "\" />" << std::endl
+		<< "<Agents generator=\"" << layout << "\" count=\"" << nrAgents << "\" policy=\"" << policyID << "\" />" << std::endl
+		<< "</Simulation>" << std::endl;
+	return filename;
+}
+
+/// <summary>Loads a scenario, runs it with the given number of threads, and measures the time.</summary>
+bool runScenario(const std::string& scenarioFile, int nrThreads, int nrSteps, int nrWarmupSteps, BenchmarkResult& result)
+{
+	result.peakMemoryIsPerRun = resetPeakMemory();
+
+	CrowdSimulator* cs = CrowdSimulator::FromConfigFile(scenarioFile);
+	if (cs == nullptr)
+		return false;
+
+	cs->GetWorld()->SetNumberOfThreads(nrThreads);
+	cs->RunSimulationSteps(nrWarmupSteps);
+
+	result.nrAgents = cs->GetWorld()->GetAgents().size();
+	result.nrThreads = nrThreads;
+	result.nrSteps = nrSteps;
+	result.agentSteps = 0;
+
+	const auto& startTime = HelperFunctions::GetCurrentTime();
+	for (int i = 0; i < nrSteps; ++i)
+	{
+		result.agentSteps += (double)cs->GetWorld()->GetAgents().size();
+		cs->RunSimulationSteps(1);
+	}
+	result.seconds = HelperFunctions::GetIntervalMilliseconds(startTime, HelperFunctions::GetCurrentTime()) / 1000.0;
+	result.peakMemoryKB = getPeakMemoryKB();
+
+	delete cs;
+	return true;
+}
+
+/// <summary>Writes a string as a JSON string literal.</summary>
+void writeJSONString(std::ostream& stream, const std::string& str)
+{
+	stream << '"';
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+			stream << '\\';
+		stream << c;
+	}
+	stream << '"';
+}
+
+void writeJSON(std::ostream& stream, const std::vector<BenchmarkResult>& results, const std::string& label, int nrSteps, int nrWarmupSteps)
+{
+	stream << "{" << std::endl << "  \"label\": ";
+	writeJSONString(stream, label);
+	stream << "," << std::endl
+		<< "  \"steps\": " << nrSteps << "," << std::endl
+		<< "  \"warmup_steps\": " << nrWarmupSteps << "," << std::endl
+		<< "  \"runs\": [" << std::endl;
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		const BenchmarkResult& r = results[i];
+		stream << "    {\"scenario\": ";
+		writeJSONString(stream, r.scenario);
+		stream << ", \"agents\": " << r.nrAgents
+			<< ", \"threads\": " << r.nrThreads
+			<< ", \"seconds\": " << r.seconds
+			<< ", \"steps_per_second\": " << r.nrSteps / r.seconds
+			<< ", \"agent_steps_per_second\": " << r.agentSteps / r.seconds
+			<< ", \"parallel_efficiency\": " << r.parallelEfficiency
+			<< ", \"peak_rss_kb\": " << r.peakMemoryKB
+			<< ", \"peak_rss_per_run\": " << (r.peakMemoryIsPerRun ? "true" : "false") << "}"
+			<< (i + 1 < results.size() ? "," : "") << std::endl;
+	}
+
+	stream << "  ]" << std::endl << "}" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	printBasicInfo();
+
+	std::vector<std::string> scenarioFiles;
+	std::string pattern = "", policiesFile = "examples/policies/ORCA.xml", outputFile = "", label = "";
+	int policyID = 0, nrSteps = 100, nrWarmupSteps = 10;
+	std::vector<int> agentCounts = { 250, 1000, 4000 }, threadCounts = { 1, 2, 4 };
+
+	// parse the arguments one by one
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string paramName(argv[i]);
+		std::string paramValue(argv[i + 1]);
+
+		if (paramName[0] != '-')
+		{
+			std::cerr << "Input error: " << paramName << " is not a valid parameter name." << std::endl;
+			printUsageInfo(argv[0]);
+			return -1;
+		}
+
+		bool valid = true;
+		if (paramName == "-i" || paramName == "-input")
+			scenarioFiles.push_back(paramValue);
+		else if (paramName == "-g" || paramName == "-generate")
+		{
+			ScenarioGenerator::Layout layout;
+			pattern = paramValue;
+			valid = ScenarioGenerator::LayoutFromString(pattern, layout);
+		}
+		else if (paramName == "-policies")
+			policiesFile = paramValue;
+		else if (paramName == "-policy")
+			policyID = atoi(paramValue.c_str());
+		else if (paramName == "-a" || paramName == "-agents")
+			valid = parseIntegerList(paramValue, agentCounts);
+		else if (paramName == "-t" || paramName == "-nrThreads")
+			valid = parseIntegerList(paramValue, threadCounts);
+		else if (paramName == "-s" || paramName == "-steps")
+			valid = (nrSteps = atoi(paramValue.c_str())) > 0;
+		else if (paramName == "-w" || paramName == "-warmup")
+			valid = (nrWarmupSteps = atoi(paramValue.c_str())) >= 0;
+		else if (paramName == "-o" || paramName == "-output")
+			outputFile = paramValue;
+		else if (paramName == "-label")
+			label = paramValue;
+
+		if (!valid)
+		{
+			std::cerr << "Input error: " << paramValue << " is not a valid value for " << paramName << "." << std::endl;
+			printUsageInfo(argv[0]);
+			return -1;
+		}
+	}
+
+	// by default, run the scenarios that are most often used for timing
+	if (scenarioFiles.empty() && pattern == "")
+		scenarioFiles = { "examples/Circle50-ORCA.xml", "examples/OneWayFlow200-ORCA.xml" };
+
+	// collect all scenarios: the given files, and one generated file per agent count
+	std::vector<std::pair<std::string, std::string>> scenarios; // (name, file)
+	for (const std::string& file : scenarioFiles)
+		scenarios.push_back({ file, file });
+
+	std::vector<std::string> generatedFiles;
+	if (pattern != "")
+	{
+		for (int nrAgents : agentCounts)
+		{
+			const std::string& file = generateScenario(pattern, nrAgents, policiesFile, policyID);
+			if (file == "")
+			{
+				std::cerr << "Error: Could not write a generated scenario to the temporary directory." << std::endl;
+				return -1;
+			}
+			scenarios.push_back({ pattern + "-" + std::to_string(nrAgents), file });
+			generatedFiles.push_back(file);
+		}
+	}
+
+	// run each scenario with each number of threads
+	std::vector<BenchmarkResult> results;
+	for (const auto& scenario : scenarios)
+	{
+		const size_t firstResult = results.size();
+		for (int nrThreads : threadCounts)
+		{
+			BenchmarkResult result;
+			result.scenario = scenario.first;
+			if (!runScenario(scenario.second, nrThreads, nrSteps, nrWarmupSteps, result))
+			{
+				std::cerr << "Error: Could not load scenario " << scenario.second << "; skipping it." << std::endl;
+				break;
+			}
+			results.push_back(result);
+		}
+
+		// compute the parallel efficiency relative to the run with the fewest threads
+		if (results.size() > firstResult)
+		{
+			const BenchmarkResult* base = &results[firstResult];
+			for (size_t i = firstResult; i < results.size(); ++i)
+				if (results[i].nrThreads < base->nrThreads)
+					base = &results[i];
+			for (size_t i = firstResult; i < results.size(); ++i)
+				results[i].parallelEfficiency = (base->seconds * base->nrThreads) / (results[i].seconds * results[i].nrThreads);
+		}
+	}
+
+	for (const std::string& file : generatedFiles)
+		std::filesystem::remove(file);
+
+	// report the results in the console
+	std::cout << std::endl << std::left << std::setw(40) << "Scenario" << std::right
+		<< std::setw(8) << "Agents" << std::setw(9) << "Threads" << std::setw(12) << "Steps/s"
+		<< std::setw(16) << "Agent-steps/s" << std::setw(12) << "Efficiency" << std::setw(15) << "Peak RSS (MB)" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	for (const BenchmarkResult& r : results)
+	{
+		std::cout << std::left << std::setw(40) << r.scenario << std::right
+			<< std::setw(8) << r.nrAgents << std::setw(9) << r.nrThreads
+			<< std::setw(12) << r.nrSteps / r.seconds
+			<< std::setw(16) << r.agentSteps / r.seconds
+			<< std::setw(12) << r.parallelEfficiency
+			<< std::setw(15) << r.peakMemoryKB / 1024.0 << (r.peakMemoryIsPerRun ? "" : " (process)") << std::endl;
+	}
+	std::cout << std::defaultfloat;
+
+	// write the results to a JSON file, if desired
+	if (outputFile != "")
+	{
+		std::ofstream stream(outputFile);
+		if (!stream)
+		{
+			std::cerr << "Error: Could not write the results to " << outputFile << "." << std::endl;
+			return -1;
+		}
+		writeJSON(stream, results, label, nrSteps, nrWarmupSteps);
+		std::cout << std::endl << "Results written to " << outputFile << "." << std::endl;
+	}
+
+	return 0;
+}
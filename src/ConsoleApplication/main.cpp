@@ -27,6 +27,7 @@
 */
 
 #include <core/crowdSimulator.h>
+#include <core/BinaryScenario.h>
 
 #include <vector>
 #include <iostream>
@@ -46,21 +47,35 @@ void printBasicInfo()
 void printUsageInfo(const std::string& programName)
 {
 	std::cout
-		<< "Usage: " << programName << " -i [-o] [-t]" << std::endl
+		<< "Usage: " << programName << " -i [-o] [-m] [-t] [-p] [-trace] [-convert]" << std::endl
 		<< "  -i (or -input)     = An XML file describing the simulation scenario to run." << std::endl
 		<< "                       For help on creating scenario files, please see the UMANS documentation." << std::endl
+		<< "                       This may also be a binary scenario file created with -convert." << std::endl
 		<< "  -o (or -output)    = (optional) Name of a folder to which the simulation output will be written." << std::endl
 		<< "                       The program will write a CSV file for each agent's trajectory." << std::endl
+		<< "                       If the name ends with .bin, the program will instead write all trajectories to a single binary file," << std::endl
+		<< "                       which is much faster for large crowds." << std::endl
 		<< "                       If you omit this, the program will run faster, but no results will be saved." << std::endl
-		<< "  -t (or -nrThreads) = (optional, default=1) The number of parallel threads to use." << std::endl << std::endl;
+		<< "  -m (or -memory)    = (optional, default=256) The maximum amount of memory (in MB) for buffered output." << std::endl
+		<< "                       When this is exceeded, the program writes the buffered output to disk. Use 0 for no limit." << std::endl
+		<< "  -t (or -nrThreads) = (optional, default=1) The number of parallel threads to use." << std::endl
+		<< "  -p (or -profile)   = (optional) Name of a text file to which a profile of the simulation will be written," << std::endl
+		<< "                       showing the time spent in each phase of a step and in each cost function." << std::endl
+		<< "                       Use - to print the profile in the console instead." << std::endl
+		<< "  -trace             = (optional) Name of a JSON file to which a timeline of the simulation will be written," << std::endl
+		<< "                       showing the work of each thread in each phase of a step." << std::endl
+		<< "                       Open this file in chrome://tracing or https://ui.perfetto.dev." << std::endl
+		<< "  -convert           = (optional) Name of a binary scenario file to which the input scenario will be converted." << std::endl
+		<< "                       The program only converts the scenario, without running it." << std::endl
+		<< "                       Binary scenarios load much faster than XML scenarios with many agents." << std::endl << std::endl;
 }
 
 int main( int argc, char * argv[] )
 {
 	printBasicInfo();
 	
-	std::string configFile = "", outputFolder = "";
-	int nrThreads = 1;
+	std::string configFile = "", outputFolder = "", profileFile = "", traceFile = "", binaryFile = "";
+	int nrThreads = 1, outputMemoryMB = 256;
 
 	// parse the arguments one by one
 	for (int i = 1; i + 1 < argc; i += 2)
@@ -81,6 +96,14 @@ int main( int argc, char * argv[] )
 			outputFolder = paramValue;
 		else if (paramName == "-t" || paramName == "-nrThreads")
 			nrThreads = atoi(paramValue.c_str());
+		else if (paramName == "-m" || paramName == "-memory")
+			outputMemoryMB = atoi(paramValue.c_str());
+		else if (paramName == "-p" || paramName == "-profile")
+			profileFile = paramValue;
+		else if (paramName == "-trace")
+			traceFile = paramValue;
+		else if (paramName == "-convert")
+			binaryFile = paramValue;
 	}
 
 	// input file is mandatory
@@ -91,6 +114,15 @@ int main( int argc, char * argv[] )
 		return -1;
 	}
 
+	// if desired, only convert the scenario to a binary file
+	if (binaryFile != "")
+	{
+		if (!BinaryScenario::ConvertFromXML(configFile, binaryFile))
+			return -1;
+		std::cout << "Converted " << configFile << " to binary scenario file " << binaryFile << "." << std::endl;
+		return 0;
+	}
+
 	// number of threads must be at least 1
 	if (nrThreads < 1)
 	{
@@ -112,12 +144,48 @@ int main( int argc, char * argv[] )
 		return -1;
 
 	cs->GetWorld()->SetNumberOfThreads(nrThreads);
-	if (outputFolder != "")
+	cs->SetOutputMemoryBudget((size_t)std::max(0, outputMemoryMB) * 1024 * 1024);
+	const bool binaryOutput = outputFolder.size() > 4 && outputFolder.substr(outputFolder.size() - 4) == ".bin";
+	if (binaryOutput)
+		cs->StartBinaryOutput(outputFolder, false); // false = don't write the file until the simulation ends
+	else if (outputFolder != "")
 		cs->StartCSVOutput(outputFolder, false); // false = don't save any files until the simulation ends
+	if (profileFile != "")
+		cs->SetProfilingEnabled(true);
+	if (traceFile != "")
+		cs->SetTracingEnabled(true);
 
 	// run the full simulation; show a progress bar and measure the time
 	cs->RunSimulationUntilEnd(true, true);
 
+	// write the profile, if desired
+	if (profileFile == "-")
+		cs->GetWorld()->GetProfiler()->WriteReport(std::cout);
+	else if (profileFile != "")
+	{
+		std::ofstream profileStream(profileFile);
+		if (profileStream)
+		{
+			cs->GetWorld()->GetProfiler()->WriteReport(profileStream);
+			std::cout << "Profile written to " << profileFile << "." << std::endl;
+		}
+		else
+			std::cerr << "Error: Could not write the profile to " << profileFile << "." << std::endl;
+	}
+
+	// write the trace, if desired
+	if (traceFile != "")
+	{
+		std::ofstream traceStream(traceFile);
+		if (traceStream)
+		{
+			cs->GetWorld()->GetTracer()->WriteJSON(traceStream);
+			std::cout << "Trace written to " << traceFile << "." << std::endl;
+		}
+		else
+			std::cerr << "Error: Could not write the trace to " << traceFile << "." << std::endl;
+	}
+
 	delete cs;
 	return 0;
 }
@@ -85,7 +85,7 @@ float FOEAvoidance::GetCost(const Vector2D& velocity, Agent* agent, const WorldB
 		float dx = xg - xf;
 		float ttc = -Pos.y / Vel.y;
 
-		float sigma = (float)(((agent->getRadius() + neighbor.realAgent->getRadius()) / Pos.y) / log(10));
+		float sigma = (float)(((agent->getRadius() + neighbor.GetRadius()) / Pos.y) / log(10));
 
 		float localCost = Importance(ttc)*exp(-abs(dx) / sigma);
 
@@ -129,7 +129,7 @@ Vector2D FOEAvoidance::GetGradient(const Vector2D& velocity, Agent* agent, const
 		float dx = xg - xf;
 		float ttc = -Pos.y / Vel.y;
 
-		float sigma = (float)(((agent->getRadius() + neighbor.realAgent->getRadius()) / Pos.y) / log(10));
+		float sigma = (float)(((agent->getRadius() + neighbor.GetRadius()) / Pos.y) / log(10));
 
 		float localgradtheta = Importance(ttc)*exp(-abs(dx) / sigma) * sgn(dx)*(xf*xf - xg * xg - (velocity.magnitude() / (-Vel.y))) / sigma;
 		float localgradv = Importance(ttc)*exp(-abs(dx) / sigma) * sgn(dx)*(-xf / (-Vel.y)) / sigma;
@@ -36,6 +36,13 @@ float ForceBasedFunction::GetCost(const Vector2D& velocity, Agent* agent, const
 	return 0.5f * (velocity - targetV).sqrMagnitude() / world->GetDeltaTime();
 }
 
+void ForceBasedFunction::GetCostBatch(const Vector2D* velocities, size_t n, float* out, Agent* agent, const WorldBase* world) const
+{
+	const Vector2D& targetV = ComputeTargetVelocity(agent, world);
+	for (size_t i = 0; i < n; ++i)
+		out[i] = 0.5f * (velocities[i] - targetV).sqrMagnitude() / world->GetDeltaTime();
+}
+
 Vector2D ForceBasedFunction::GetGradient(const Vector2D& velocity, Agent* agent, const WorldBase * world) const
 {
 	const Vector2D& targetV = ComputeTargetVelocity(agent, world);
@@ -44,7 +51,7 @@ Vector2D ForceBasedFunction::GetGradient(const Vector2D& velocity, Agent* agent,
 
 Vector2D ForceBasedFunction::GetGradientFromCurrentVelocity(Agent* agent, const WorldBase * world) const
 {
-	return -ComputeForce(agent, world) / agent->getMass();
+	return -GetForce(agent, world) / agent->getMass();
 }
 
 Vector2D ForceBasedFunction::GetGlobalMinimum(Agent* agent, const WorldBase* world) const
@@ -59,5 +66,15 @@ void ForceBasedFunction::parseParameters(const CostFunctionParameters & params)
 
 Vector2D ForceBasedFunction::ComputeTargetVelocity(Agent* agent, const WorldBase* world) const
 {
-	return agent->getVelocity() + ComputeForce(agent, world) / agent->getMass() * world->GetDeltaTime();
+	return agent->getVelocity() + GetForce(agent, world) / agent->getMass() * world->GetDeltaTime();
+}
+
+void ForceBasedFunction::PrepareForAgent(Agent* agent, const WorldBase* world, CostFunctionScratch& scratch) const
+{
+	scratch.vectors.assign(1, ComputeForce(agent, world));
+}
+
+Vector2D ForceBasedFunction::GetForce(Agent* agent, const WorldBase* world) const
+{
+	return GetPreparedScratch(agent, world).vectors[0];
 }
\ No newline at end of file
@@ -53,6 +53,9 @@ public:
 	/// <returns>A floating-point cost, derived from the result of ComputeForce().</param>
 	virtual float GetCost(const Vector2D& velocity, Agent* agent, const WorldBase * world) const override;
 
+	/// <summary>Computes the costs of many velocities at once, using a single target velocity for all of them.</summary>
+	virtual void GetCostBatch(const Vector2D* velocities, size_t n, float* out, Agent* agent, const WorldBase* world) const override;
+
 	/// <summary>Computes the gradient of the cost, in a way that is specific for force-based functions.</summary>
 	/// <remarks>In the case of ForceBasedFunction, the gradient points towards the target velocity 
 	/// (the velocity that the agent would reach by using the method's force), with a magnitude that will always lead to this target velocity.</remarks>
@@ -89,8 +92,18 @@ protected:
 	/// <param name="world">The world in which the simulation takes place.</param>
 	/// <returns>A 2D vector indicating the force that the agent experiences according to a specific model.</returns>
 	virtual Vector2D ComputeForce(Agent* agent, const WorldBase* world) const = 0;
+
+	/// <summary>Computes the force for the given agent via ComputeForce(), and stores it in the agent's scratch area.</summary>
+	void PrepareForAgent(Agent* agent, const WorldBase* world, CostFunctionScratch& scratch) const override;
 	
 private:
+	/// <summary>Returns the result of ComputeForce() for the given agent in the current simulation step.</summary>
+	/// <remarks>The force does not depend on the velocity being evaluated, so it is computed only once per step, in PrepareForAgent().</remarks>
+	/// <param name="agent">The agent for which a force is requested.</param>
+	/// <param name="world">The world in which the simulation takes place.</param>
+	/// <returns>A 2D vector indicating the force that the agent experiences in the current simulation step.</returns>
+	Vector2D GetForce(Agent* agent, const WorldBase* world) const;
+
 	/// <summary>Computes the velocity that the agent would reach if it uses the result of ComputeForce() for one timestep.</summary>
 	/// <param name="agent">The agent that would use the requested velocity.</param>
 	/// <param name="world">The world in which the simulation takes place.</param>
@@ -35,30 +35,79 @@ using namespace std;
 float Karamouzas::GetCost(const Vector2D& velocity, Agent* agent, const WorldBase * world) const
 {
 	const auto& prefVelocity = agent->getPreferredVelocity();
-	const auto& currentVelocity = agent->getVelocity();
 	const auto& speed = velocity.magnitude();
-	const float maxSpeed = agent->getMaximumSpeed();
 	const auto& neighbors = agent->getNeighbors();
-
-	float TTC_preferred = ComputeTimeToFirstCollision(agent->getPosition(), prefVelocity, agent->getRadius(), neighbors, range_, true);
+	const auto& ranges = GetPreparedScratch(agent, world).values;
 
 	// This collision-avoidance method has a dynamic angular range, so ignore velocities that are outside it
-	if (angle(velocity, prefVelocity) > getMaxDeviationAngle(agent, TTC_preferred))
+	if (angle(velocity, prefVelocity) > ranges[MAX_DEVIATION_ANGLE])
 		return MaxFloat;
 
 	// same for speed
-	if (speed < getMinSpeed(agent, TTC_preferred) || speed > getMaxSpeed(agent, TTC_preferred))
+	if (speed < ranges[MIN_SPEED] || speed > ranges[MAX_SPEED])
 		return MaxFloat;
 
 	// compute time to collision at this candidate velocity
 	float TTC = ComputeTimeToFirstCollision(agent->getPosition(), velocity, agent->getRadius(), neighbors, range_, true);
 
+	return getWeightedCost(velocity, speed, TTC, agent);
+}
+
+/// <summary>Per-thread buffers for the velocities that GetCostBatch() evaluates, so that it does not allocate memory once they are large enough.</summary>
+static thread_local vector<Vector2D> allowedVelocities;
+static thread_local vector<size_t> allowedIndices;
+static thread_local vector<float> TTCs;
+
+void Karamouzas::GetCostBatch(const Vector2D* velocities, size_t n, float* out, Agent* agent, const WorldBase * world) const
+{
+	const auto& prefVelocity = agent->getPreferredVelocity();
+	const auto& neighbors = agent->getNeighbors();
+	const auto& ranges = GetPreparedScratch(agent, world).values;
+
+	// ignore velocities that are outside the allowed angular and speed range
+	allowedVelocities.clear();
+	allowedIndices.clear();
+	for (size_t i = 0; i < n; ++i)
+	{
+		out[i] = MaxFloat;
+		const float speed = velocities[i].magnitude();
+		if (angle(velocities[i], prefVelocity) > ranges[MAX_DEVIATION_ANGLE] || speed < ranges[MIN_SPEED] || speed > ranges[MAX_SPEED])
+			continue;
+		allowedVelocities.push_back(velocities[i]);
+		allowedIndices.push_back(i);
+	}
+
+	// compute time to collision for all remaining velocities at once
+	TTCs.resize(allowedVelocities.size());
+	ComputeTimeToFirstCollisionBatch(agent->getPosition(), allowedVelocities.data(), allowedVelocities.size(), agent->getRadius(), 
+		neighbors, range_, true, TTCs.data());
+
+	for (size_t j = 0; j < allowedVelocities.size(); ++j)
+		out[allowedIndices[j]] = getWeightedCost(allowedVelocities[j], allowedVelocities[j].magnitude(), TTCs[j], agent);
+}
+
+void Karamouzas::PrepareForAgent(Agent* agent, const WorldBase* world, CostFunctionScratch& scratch) const
+{
+	// the allowed angular and speed range depends only on the time to collision at the preferred velocity
+	float TTC_preferred = ComputeTimeToFirstCollision(agent->getPosition(), agent->getPreferredVelocity(), agent->getRadius(), agent->getNeighbors(), range_, true);
+
+	scratch.values.resize(NR_PREPARED_VALUES);
+	scratch.values[MAX_DEVIATION_ANGLE] = getMaxDeviationAngle(agent, TTC_preferred);
+	scratch.values[MIN_SPEED] = getMinSpeed(agent, TTC_preferred);
+	scratch.values[MAX_SPEED] = getMaxSpeed(agent, TTC_preferred);
+}
+
+float Karamouzas::getWeightedCost(const Vector2D& velocity, const float speed, const float ttc, const Agent* agent) const
+{
+	const auto& prefVelocity = agent->getPreferredVelocity();
+	const float maxSpeed = agent->getMaximumSpeed();
+
 	// the cost is a weighted sum of factors:
 
 	float A = alpha * (1 - cosAngle(velocity, prefVelocity) / 2.0f);
-	float B = beta * abs(speed - currentVelocity.magnitude()) / maxSpeed;
+	float B = beta * abs(speed - agent->getVelocity().magnitude()) / maxSpeed;
 	float C = gamma * (velocity - prefVelocity).magnitude() / (2 * maxSpeed);
-	float D = delta * std::max(0.0f, t_max - TTC) / t_max;
+	float D = delta * std::max(0.0f, t_max - ttc) / t_max;
 
 	return A + B + C + D;
 }
@@ -69,18 +69,26 @@ private:
 	const float d_mid = (float)(PI / 6.0f);
 	const float d_max = (float)(PI / 2.0f);
 
+	/// <summary>The entries that PrepareForAgent() stores in an agent's scratch area: the allowed range of velocities, based on the time to collision at the preferred velocity.</summary>
+	enum PreparedValue { MAX_DEVIATION_ANGLE, MIN_SPEED, MAX_SPEED, NR_PREPARED_VALUES };
+
 public:
 	Karamouzas() : CostFunction() {}
 	virtual ~Karamouzas() {}
 	const static std::string GetName() { return "Karamouzas"; }
 
 	virtual float GetCost(const Vector2D& velocity, Agent* agent, const WorldBase * world) const override;
+	virtual void GetCostBatch(const Vector2D* velocities, size_t n, float* out, Agent* agent, const WorldBase * world) const override;
 	void parseParameters(const CostFunctionParameters & params) override;
 
+protected:
+	void PrepareForAgent(Agent* agent, const WorldBase* world, CostFunctionScratch& scratch) const override;
+
 private:
 	float getMaxDeviationAngle(const Agent* agent, const float ttc) const;
 	float getMinSpeed(const Agent* agent, const float ttc) const;
 	float getMaxSpeed(const Agent* agent, const float ttc) const;
+	float getWeightedCost(const Vector2D& velocity, const float speed, const float ttc, const Agent* agent) const;
 };
 
 #endif //LIB_KARAMOUZAS_H
@@ -29,6 +29,7 @@
 #include <CostFunctions/Moussaid.h>
 #include <core/worldBase.h>
 #include <core/agent.h>
+#include <algorithm>
 
 using namespace std;
 
@@ -40,6 +41,73 @@ float Moussaid::getDistanceToCollisionAtPreferredSpeed(const Vector2D& direction
 	// compute the time to collision at this velocity
 	float ttc = ComputeTimeToFirstCollision(agent->getPosition(), velocityWithPrefSpeed, agent->getRadius(), agent->getNeighbors(), range_, false);
 
+	return toDistanceToCollision(ttc, prefSpeed);
+}
+
+float Moussaid::GetCost(const Vector2D& velocity, Agent* agent, const WorldBase * world) const
+{
+	// compute the distance to collision at maximum speed
+	const auto& dir = velocity.getnormalized();
+	float DC = getDistanceToCollisionAtPreferredSpeed(dir, agent);
+
+	return getCostForDistanceToCollision(velocity, dir, DC, agent);
+}
+
+/// <summary>Per-thread buffers for grouping the velocities in GetCostBatch() by direction, 
+/// so that it does not allocate memory once they are large enough.</summary>
+static thread_local vector<Vector2D> directions;
+static thread_local vector<size_t> order;
+static thread_local vector<Vector2D> groupVelocities;
+static thread_local vector<size_t> groupOfVelocity;
+static thread_local vector<float> DCs;
+
+void Moussaid::GetCostBatch(const Vector2D* velocities, size_t n, float* out, Agent* agent, const WorldBase * world) const
+{
+	// The distance to collision only depends on the direction of a velocity, 
+	// so compute it only once for all velocities that have exactly the same direction
+	// (e.g. the samples on the same ray of a velocity sampler).
+	// (Equal directions are ordered by index, like a stable sort would, but without the temporary memory of std::stable_sort.)
+	directions.resize(n);
+	order.resize(n);
+	for (size_t i = 0; i < n; ++i)
+	{
+		directions[i] = velocities[i].getnormalized();
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [](size_t a, size_t b) 
+	{ 
+		if (directions[a].x != directions[b].x)
+			return directions[a].x < directions[b].x;
+		if (directions[a].y != directions[b].y)
+			return directions[a].y < directions[b].y;
+		return a < b;
+	});
+
+	// group the sorted directions
+	const float prefSpeed = agent->getPreferredSpeed();
+	groupVelocities.clear();
+	groupOfVelocity.resize(n);
+	for (size_t k = 0; k < n; ++k)
+	{
+		const size_t i = order[k];
+		if (k == 0 || !(directions[i] == directions[order[k - 1]]))
+			groupVelocities.push_back(directions[i] * prefSpeed);
+		groupOfVelocity[i] = groupVelocities.size() - 1;
+	}
+
+	// compute the distance to collision for all groups at once
+	DCs.resize(groupVelocities.size());
+	ComputeTimeToFirstCollisionBatch(agent->getPosition(), groupVelocities.data(), groupVelocities.size(), agent->getRadius(),
+		agent->getNeighbors(), range_, false, DCs.data());
+	for (float& DC : DCs)
+		DC = toDistanceToCollision(DC, prefSpeed);
+
+	for (size_t i = 0; i < n; ++i)
+		out[i] = getCostForDistanceToCollision(velocities[i], directions[i], DCs[groupOfVelocity[i]], agent);
+}
+
+float Moussaid::toDistanceToCollision(const float ttc, const float prefSpeed) const
+{
 	// convert to the distance to collision, clamped to a maximum distance
 	float distanceToCollision = (ttc == MaxFloat ? MaxFloat : ttc * prefSpeed);
 	if (distanceToCollision > d_max)
@@ -48,17 +116,13 @@ float Moussaid::getDistanceToCollisionAtPreferredSpeed(const Vector2D& direction
 	return distanceToCollision;
 }
 
-float Moussaid::GetCost(const Vector2D& velocity, Agent* agent, const WorldBase * world) const
+float Moussaid::getCostForDistanceToCollision(const Vector2D& velocity, const Vector2D& direction, const float DC, const Agent* agent) const
 {
 	const float speed = velocity.magnitude(); 
 	const float prefSpeed = agent->getPreferredSpeed();
 
-	// compute the distance to collision at maximum speed
-	const auto& dir = velocity.getnormalized();
-	float DC = getDistanceToCollisionAtPreferredSpeed(dir, agent);
-
 	// compute the cost for this direction, assuming maximum speed
-	float K = d_max * d_max + DC * DC - 2 * d_max * DC*cosAngle(dir, agent->getPreferredVelocity());
+	float K = d_max * d_max + DC * DC - 2 * d_max * DC*cosAngle(direction, agent->getPreferredVelocity());
 	K += 1;
 
 	// compute the optimal speed for this direction
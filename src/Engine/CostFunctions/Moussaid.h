@@ -60,10 +60,18 @@ public:
 	const static std::string GetName() { return "Moussaid"; }
 
 	virtual float GetCost(const Vector2D& velocity, Agent* agent, const WorldBase * world) const override;
+
+	/// <summary>Computes the costs of many velocities at once.</summary>
+	/// <remarks>The distance to collision depends only on the direction of a velocity, 
+	/// so this method computes it only once per direction (i.e. once per angle sample instead of once per velocity sample).</remarks>
+	virtual void GetCostBatch(const Vector2D* velocities, size_t n, float* out, Agent* agent, const WorldBase * world) const override;
+
 	void parseParameters(const CostFunctionParameters & params) override;
 
 private:
 	float getDistanceToCollisionAtPreferredSpeed(const Vector2D& direction, const Agent* agent) const;
+	float toDistanceToCollision(const float ttc, const float prefSpeed) const;
+	float getCostForDistanceToCollision(const Vector2D& velocity, const Vector2D& direction, const float DC, const Agent* agent) const;
 };
 
 #endif //LIB_MOUSSAID_H
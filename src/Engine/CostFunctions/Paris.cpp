@@ -97,7 +97,7 @@ Paris::NeighborAvoidanceRange Paris::ComputeNeighborAvoidanceRange(const Vector2
 {
 	const auto& agentPos = agent->getPosition();
 	const auto& neighborPos = neighbor.GetPosition();
-	const float radius1 = agent->getRadius(), radius2 = neighbor.realAgent->getRadius();
+	const float radius1 = agent->getRadius(), radius2 = neighbor.GetRadius();
 
 	// Find the point where the trajectories of 'agent' and 'neighbor' intersect
 	Vector2D X;
@@ -41,7 +41,7 @@ Vector2D PowerLaw::ComputeAgentInteractionForce(const Agent* agent, const Phanto
 	// Some constants are different, but it all cancels out in the end.
 	// We use the a/b/c/d definitions from the Power Law paper here, because they are used in the gradient as well.
 
-	float R = other.realAgent->getRadius() + agent->getRadius();
+	float R = other.GetRadius() + agent->getRadius();
 	const Vector2D& x = agent->getPosition() - other.GetPosition();
 	const Vector2D& v = agent->getVelocity() - other.GetVelocity();
 	float a = v.dot(v);
@@ -50,6 +50,32 @@ float RVO::GetCost(const Vector2D& velocity, Agent* agent, const WorldBase * wor
 	return w / minTTC + vDiff.magnitude();
 }
 
+/// <summary>Per-thread buffers for the reciprocal velocities in GetCostBatch() and their times to collision, 
+/// so that it does not allocate memory once they are large enough.</summary>
+static thread_local vector<Vector2D> RVOVelocities;
+static thread_local vector<float> minTTCs;
+
+void RVO::GetCostBatch(const Vector2D* velocities, size_t n, float* out, Agent* agent, const WorldBase * world) const
+{
+	// compute the "reciprocal" velocity for each candidate
+	RVOVelocities.resize(n);
+	for (size_t i = 0; i < n; ++i)
+		RVOVelocities[i] = 2 * velocities[i] - agent->getVelocity();
+
+	// compute the smallest time to collision for all of them at once
+	minTTCs.resize(n);
+	ComputeTimeToFirstCollisionBatch(agent->getPosition(), RVOVelocities.data(), n, agent->getRadius(), agent->getNeighbors(), range_, true, minTTCs.data());
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		// disallow high speeds
+		if (velocities[i].magnitude() > agent->getMaximumSpeed())
+			out[i] = MaxFloat;
+		else
+			out[i] = w / minTTCs[i] + (agent->getPreferredVelocity() - velocities[i]).magnitude();
+	}
+}
+
 void RVO::parseParameters(const CostFunctionParameters & params)
 {
 	CostFunction::parseParameters(params);
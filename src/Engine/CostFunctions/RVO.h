@@ -65,6 +65,7 @@ public:
 	const static std::string GetName() { return "RVO"; }
 
 	virtual float GetCost(const Vector2D& velocity, Agent* agent, const WorldBase * world) const override;
+	virtual void GetCostBatch(const Vector2D* velocities, size_t n, float* out, Agent* agent, const WorldBase * world) const override;
 
 	void parseParameters(const CostFunctionParameters & params) override;
 };
@@ -40,12 +40,12 @@ void SPH::ComputeDensityData(const Agent* agent, const float dt, SPH::DensityDat
 	// - add neighboring agents
 	for (const auto& neighbor : neighbors.first)
 	{
-		if (!UseObstacleParticles_Density && neighbor.realAgent->isSPHObstacleParticle())
+		if (!UseObstacleParticles_Density && agent->getNeighborAgent(neighbor)->isSPHObstacleParticle())
 			continue;
 
 		float diff = rangeSquared - neighbor.GetDistanceSquared();
 		if (diff > 0)
-			result.density += neighbor.realAgent->getMass() * POLY_6 * powf(diff, 3.0f);
+			result.density += agent->getNeighborAgent(neighbor)->getMass() * POLY_6 * powf(diff, 3.0f);
 	}
 
 	// - add the agent itself
@@ -85,14 +85,14 @@ void SPH::ComputeDensityData(const Agent* agent, const float dt, SPH::DensityDat
 Vector2D SPH::ComputeAgentInteractionForce(const Agent* agent, const PhantomAgent& other) const
 {
 	const DensityData& data_i = agent->getSPHDensityData();
-	const DensityData& data_j = other.realAgent->getSPHDensityData();
+	const DensityData& data_j = agent->getNeighborAgent(other)->getSPHDensityData();
 	float mass_i = agent->getMass();
-	float mass_j = other.realAgent->getMass();
+	float mass_j = agent->getNeighborAgent(other)->getMass();
 
 	Vector2D result(0, 0);
 
 	// if we've chosen to ignore obstacle particles, and this neighbor is an obstacle particle, ignore it
-	if (!UseObstacleParticles_PressureForce && other.realAgent->isSPHObstacleParticle())
+	if (!UseObstacleParticles_PressureForce && agent->getNeighborAgent(other)->isSPHObstacleParticle())
 		return result;
 
 	// if the neighboring agent is too far away, ignore it (this shouldn't happen; distant agents have already been filtered out)
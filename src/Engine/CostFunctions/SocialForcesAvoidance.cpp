@@ -51,13 +51,13 @@ Vector2D SocialForcesAvoidance::ComputeAgentInteractionForce(const Agent* agent,
 
 	// if the agents are already colliding right now, don't apply any force; we'll do this via contact forces instead
 	// --> Disabled for now because it makes the model non-smooth.
-	//if (magR <= agent->getRadius() + other.realAgent->getRadius())
+	//if (magR <= agent->getRadius() + agent->getNeighborAgent(other)->getRadius())
 	//	return Vector2D(0, 0);
 
 	// velocity of the other agent
 	// --- 1995 version: use current and preferred velocity of B
 	//float vb = other.GetVelocity().magnitude();
-	//const Vector2D& Eb = other.realAgent->getPreferredVelocity().getnormalized();
+	//const Vector2D& Eb = agent->getNeighborAgent(other)->getPreferredVelocity().getnormalized();
 	//float magV = vb * dt;
 	//const Vector2D& V = Eb * magV;
 	// --- 2013 version: use the relative velocity
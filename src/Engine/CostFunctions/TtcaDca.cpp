@@ -106,7 +106,7 @@ float TtcaDca::GetCost(const Vector2D& velocity, Agent* agent, const WorldBase *
 		// computing ttc and dca
 		const auto& ttca_dca = ComputeTimeAndDistanceToClosestApproach(
 			Position, velocity, Radius,
-			neighborPos, neighbor.GetVelocity(), neighbor.realAgent->getRadius());
+			neighborPos, neighbor.GetVelocity(), neighbor.GetRadius());
 
 		// ignore TTCAs in the past
 		// --> disabled because it makes the cost function non-smooth
@@ -116,7 +116,7 @@ float TtcaDca::GetCost(const Vector2D& velocity, Agent* agent, const WorldBase *
 		// The original method does this per pixel; we do it per obstacle.
 		// To simulate the "number of pixels" for this obstacle, scale by the distance
 
-		float distance = relPos.magnitude() - Radius - neighbor.realAgent->getRadius();
+		float distance = relPos.magnitude() - Radius - neighbor.GetRadius();
 		float scale = 1 / (distance*distance); //simulate num of pixels of an agent in screen
 		ObstacleCostScale += scale;
 
@@ -135,6 +135,64 @@ float TtcaDca::GetCost(const Vector2D& velocity, Agent* agent, const WorldBase *
 	return ObstacleCost + MovementCost;
 }
 
+/// <summary>A per-thread buffer for the obstacle costs of all velocities in GetCostBatch(), so that it does not allocate memory once it is large enough.</summary>
+static thread_local vector<float> ObstacleCosts;
+
+void TtcaDca::GetCostBatch(const Vector2D* velocities, size_t n, float* out, Agent* agent, const WorldBase * world) const
+{
+	const float Radius = agent->getRadius();
+	const Vector2D& Position = agent->getPosition();
+	const float rangeSquared = range_ * range_;
+
+	// --- collision avoidance
+	// Which neighbors are considered (and how they are scaled) does not depend on the candidate velocity, 
+	// so we loop over the neighbors only once, and over the velocities in the inner loop.
+
+	ObstacleCosts.assign(n, 0);
+	float ObstacleCostScale = 0;
+
+	const auto& neighbors = agent->getNeighbors();
+
+	// for each agent of the neighbourhood
+	for (const auto& neighbor : neighbors.first)
+	{
+		const auto& neighborPos = neighbor.GetPosition();
+		if (neighbor.GetDistanceSquared() >= rangeSquared)
+			continue;
+
+		// ignore neighbors that are behind the agent; the original Dutra method uses rendering, and agents always face forward
+		const Vector2D& relPos = neighborPos - Position;
+		if (angle(relPos, agent->getVelocity()) > viewingAngleHalf_)
+			continue;
+
+		// simulate the "number of pixels" for this obstacle, as in GetCost()
+		float distance = relPos.magnitude() - Radius - neighbor.GetRadius();
+		float scale = 1 / (distance*distance);
+		ObstacleCostScale += scale;
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			const auto& ttca_dca = ComputeTimeAndDistanceToClosestApproach(
+				Position, velocities[i], Radius,
+				neighborPos, neighbor.GetVelocity(), neighbor.GetRadius());
+
+			float cost = costForTtcaDca(ttca_dca.first, ttca_dca.second) * scale;
+			ObstacleCosts[i] += cost;
+		}
+	}
+
+	// --- total
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		float ObstacleCost = ObstacleCosts[i];
+		if (ObstacleCostScale > 0)
+			ObstacleCost /= ObstacleCostScale;
+
+		out[i] = ObstacleCost + getMovementCost(velocities[i], agent);
+	}
+}
+
 Vector2D TtcaDca::GetGradient(const Vector2D& velocity, Agent* agent, const WorldBase * world) const
 {
 	const float Radius = agent->getRadius();
@@ -169,7 +227,7 @@ Vector2D TtcaDca::GetGradient(const Vector2D& velocity, Agent* agent, const Worl
 		// The standard TTCA definition works with these dp and dv immediately.
 		// We make some corrections to account for the radii of agents:
 		float dpMag = dp_center.magnitude();
-		const Vector2D& dp = dp_center / dpMag * (dpMag - Radius - neighbor.realAgent->getRadius());
+		const Vector2D& dp = dp_center / dpMag * (dpMag - Radius - neighbor.GetRadius());
 		Vector2D dpNormal(-dp_center.y, dp_center.x);
 		const Vector2D dv = dv_center + dpNormal * dpNormal.dot(dv_center);
 		float dvSqrMagnitude = dv.sqrMagnitude();
@@ -84,6 +84,7 @@ public:
 	const static std::string GetName() { return "TtcaDca"; }
 
 	virtual float GetCost(const Vector2D& velocity, Agent* agent, const WorldBase * world) const;
+	virtual void GetCostBatch(const Vector2D* velocities, size_t n, float* out, Agent* agent, const WorldBase * world) const override;
 	virtual Vector2D GetGradient(const Vector2D& velocity, Agent* agent, const WorldBase * world) const;
 
 	void parseParameters(const CostFunctionParameters & params) override;
@@ -0,0 +1,225 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#include <core/AgentGrid.h>
+#include <algorithm>
+#include <cmath>
+
+AgentGrid::AgentGrid(float cellSize) 
+	: desiredCellSize_(cellSize), cellSize_(cellSize), origin_(0, 0), nrColumns_(0), nrRows_(0)
+{
+}
+
+void AgentGrid::Update(const std::vector<Agent*>& agents, const std::vector<Entry>& ghosts)
+{
+	const size_t nrAgents = agents.size();
+	const size_t n = nrAgents + ghosts.size();
+	const Vector2D noOffset(0, 0);
+	const auto& getEntry = [&](size_t i) { return i < nrAgents ? Entry{ agents[i], noOffset } : ghosts[i - nrAgents]; };
+
+	// remove the grid entries of list positions that no longer contain the same agent (or the same ghost)
+	// (this happens when agents are added or removed in the simulation, or when agents get or lose ghost copies)
+	for (size_t i = 0; i < entries_.size(); ++i)
+	{
+		if (agentCells_[i] < 0)
+			continue;
+		if (i < n)
+		{
+			const Entry& entry = getEntry(i);
+			if (entries_[i].agent == entry.agent && entries_[i].offset == entry.offset)
+				continue;
+		}
+		removeFromCell(agentCells_[i], i);
+		agentCells_[i] = -1;
+	}
+
+	// store the new entries and positions
+	entries_.resize(n);
+	positions_.resize(n);
+	agentCells_.resize(n, -1);
+	bool allInsideGrid = true;
+	for (size_t i = 0; i < n; ++i)
+	{
+		entries_[i] = getEntry(i);
+		positions_[i] = entries_[i].agent->getPosition() + entries_[i].offset;
+		if (!isInsideGrid(positions_[i]))
+			allInsideGrid = false;
+	}
+
+	// if some agents have left the grid, choose a new grid area
+	if (!allInsideGrid || cells_.empty())
+	{
+		rebuild();
+		return;
+	}
+
+	// otherwise, only move the agents that have entered another cell
+	for (size_t i = 0; i < n; ++i)
+	{
+		const int cell = getCellIndex(positions_[i]);
+		if (cell != agentCells_[i])
+		{
+			if (agentCells_[i] >= 0)
+				removeFromCell(agentCells_[i], i);
+			cells_[cell].push_back(i);
+			agentCells_[i] = cell;
+		}
+	}
+}
+
+void AgentGrid::rebuild()
+{
+	// compute the bounding box of all agents
+	float minX = std::numeric_limits<float>::max(), minY = minX;
+	float maxX = std::numeric_limits<float>::lowest(), maxY = maxX;
+	for (const Vector2D& pos : positions_)
+	{
+		// positions that are not finite (e.g. due to a diverging simulation) will end up in a border cell
+		if (!std::isfinite(pos.x) || !std::isfinite(pos.y))
+			continue;
+		minX = std::min(minX, pos.x); maxX = std::max(maxX, pos.x);
+		minY = std::min(minY, pos.y); maxY = std::max(maxY, pos.y);
+	}
+	if (minX > maxX)
+		minX = maxX = minY = maxY = 0;
+
+	// add a margin, so that the grid does not need to be rebuilt as soon as the crowd expands a bit
+	const float marginX = 0.25f * (maxX - minX) + 2 * desiredCellSize_;
+	const float marginY = 0.25f * (maxY - minY) + 2 * desiredCellSize_;
+	minX -= marginX; maxX += marginX;
+	minY -= marginY; maxY += marginY;
+
+	// if the agents are spread out over a very large area, use larger cells to bound the memory usage
+	const double maxNrCells = std::max<double>(1024.0, 4.0 * positions_.size());
+	const double desiredNrCells = std::ceil((maxX - minX) / desiredCellSize_) * std::ceil((maxY - minY) / desiredCellSize_);
+	cellSize_ = desiredNrCells > maxNrCells
+		? (float)(desiredCellSize_ * std::sqrt(desiredNrCells / maxNrCells))
+		: desiredCellSize_;
+
+	origin_ = Vector2D(minX, minY);
+	nrColumns_ = std::max(1, (int)std::ceil((maxX - minX) / cellSize_));
+	nrRows_ = std::max(1, (int)std::ceil((maxY - minY) / cellSize_));
+
+	// put all agents in the grid again
+	cells_.clear();
+	cells_.resize((size_t)nrColumns_ * nrRows_);
+	for (size_t i = 0; i < positions_.size(); ++i)
+	{
+		agentCells_[i] = getCellIndex(positions_[i]);
+		cells_[agentCells_[i]].push_back(i);
+	}
+}
+
+bool AgentGrid::isInsideGrid(const Vector2D& position) const
+{
+	// positions that are not finite are always considered to be inside the grid, to prevent unnecessary rebuilds
+	if (!std::isfinite(position.x) || !std::isfinite(position.y))
+		return true;
+
+	return position.x >= origin_.x && position.x < origin_.x + nrColumns_ * cellSize_
+		&& position.y >= origin_.y && position.y < origin_.y + nrRows_ * cellSize_;
+}
+
+int AgentGrid::getColumn(float x) const
+{
+	const float column = (x - origin_.x) / cellSize_;
+	if (!(column >= 0))
+		return 0;
+	if (column >= nrColumns_)
+		return nrColumns_ - 1;
+	return (int)column;
+}
+
+int AgentGrid::getRow(float y) const
+{
+	const float row = (y - origin_.y) / cellSize_;
+	if (!(row >= 0))
+		return 0;
+	if (row >= nrRows_)
+		return nrRows_ - 1;
+	return (int)row;
+}
+
+void AgentGrid::removeFromCell(int cell, size_t agentIndex)
+{
+	auto& cellContents = cells_[cell];
+	auto it = std::find(cellContents.begin(), cellContents.end(), agentIndex);
+	if (it != cellContents.end())
+	{
+		*it = cellContents.back();
+		cellContents.pop_back();
+	}
+}
+
+/// <summary>A per-thread buffer for the agents found by a query, so that queries do not have to allocate memory.</summary>
+static thread_local std::vector<std::pair<size_t, double>> indicesAndDistances;
+
+void AgentGrid::FindAllAgentsInRange(const Vector2D& position, const float radius, const Agent* agentToIgnore, std::vector<Entry>& result) const
+{
+	result.clear();
+	if (cells_.empty())
+		return;
+
+	// determine the range of cells that overlap with the bounding box of the query circle
+	const int minColumn = getColumn(position.x - radius), maxColumn = getColumn(position.x + radius);
+	const int minRow = getRow(position.y - radius), maxRow = getRow(position.y + radius);
+
+	// collect all agents within range, along with their squared distances
+	// (computed in double precision, so that the results match those of AgentKDTree)
+	const double radiusSquared = (double)radius * radius;
+	indicesAndDistances.clear();
+	for (int row = minRow; row <= maxRow; ++row)
+	{
+		for (int column = minColumn; column <= maxColumn; ++column)
+		{
+			for (size_t agentIndex : cells_[row * nrColumns_ + column])
+			{
+				if (entries_[agentIndex].agent == agentToIgnore)
+					continue;
+
+				const double dx = (double)position.x - positions_[agentIndex].x;
+				const double dy = (double)position.y - positions_[agentIndex].y;
+				const double distSqr = dx * dx + dy * dy;
+				if (distSqr < radiusSquared)
+					indicesAndDistances.push_back({ agentIndex, distSqr });
+			}
+		}
+	}
+
+	// sort the results by distance
+	std::sort(indicesAndDistances.begin(), indicesAndDistances.end(), 
+		[](const std::pair<size_t, double>& a, const std::pair<size_t, double>& b)
+	{
+		return a.second < b.second || (a.second == b.second && a.first < b.first);
+	});
+
+	// convert the result to a list of entries
+	result.resize(indicesAndDistances.size());
+	for (size_t i = 0; i < indicesAndDistances.size(); ++i)
+		result[i] = entries_[indicesAndDistances[i].first];
+}
@@ -0,0 +1,107 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#ifndef LIB_AGENTGRID_H
+#define LIB_AGENTGRID_H
+
+#include <core/SpatialIndex.h>
+
+/// <summary>A uniform grid (or "cell list") of agent positions, which can be used for nearest-neighbor queries.</summary>
+/// <remarks>In contrast to AgentKDTree, this grid is not rebuilt in every frame: 
+/// in each call to Update(), only the agents that have moved to another cell (or that have been added or removed) are re-binned.
+/// The grid covers the bounding box of all agents (plus a margin), and it grows automatically when agents leave this area.
+/// This structure works best when the crowd density is bounded and the cell size is close to the typical query radius.</remarks>
+class AgentGrid : public SpatialIndex
+{
+private:
+	/// <summary>The desired width and height (in meters) of a single grid cell.</summary>
+	float desiredCellSize_;
+	/// <summary>The actual width and height (in meters) of a single grid cell. 
+	/// This may be larger than the desired cell size if the agents are spread out over a very large area.</summary>
+	float cellSize_;
+
+	/// <summary>The position of the bottom-left corner of the grid.</summary>
+	Vector2D origin_;
+	/// <summary>The number of cells in the x direction.</summary>
+	int nrColumns_;
+	/// <summary>The number of cells in the y direction.</summary>
+	int nrRows_;
+
+	/// <summary>For each grid cell, the indices of all entries (in entries_) that lie in this cell.</summary>
+	std::vector<std::vector<size_t>> cells_;
+
+	/// <summary>The agents and ghost copies of agents that were last sent to Update(): first all agents, then all ghosts.</summary>
+	std::vector<Entry> entries_;
+	/// <summary>For each entry in entries_, its (translated) position at the time of the last Update().</summary>
+	std::vector<Vector2D> positions_;
+	/// <summary>For each entry in entries_, the index of the grid cell in which it is stored, or -1 if it is not stored yet.</summary>
+	std::vector<int> agentCells_;
+
+public:
+	/// <summary>Creates an empty AgentGrid with the given cell size. Call Update() to fill it with agents.</summary>
+	/// <param name="cellSize">The desired width and height (in meters) of a single grid cell.</param>
+	AgentGrid(float cellSize);
+
+	/// <summary>Updates this AgentGrid for a given list of agents, using the *current* position of these agents.</summary>
+	/// <remarks>Only agents that have changed cells since the last update are moved in the grid.
+	/// If any agent lies outside the current grid area, the grid is rebuilt with a larger area.</remarks>
+	/// <param name="agents">A list of agents.</param>
+	/// <param name="ghosts">A list of ghost copies of agents, which are stored at the agent's position plus the entry's offset.</param>
+	void Update(const std::vector<Agent*>& agents, const std::vector<Entry>& ghosts) override;
+	using SpatialIndex::Update;
+
+	/// <summary>Computes a list of all agents (and ghost copies of agents) that lie within a given radius of a given position.</summary>
+	/// <param name="position">A query position.</param>
+	/// <param name="radius">A query radius.</param>
+	/// <param name="agentToIgnore">A pointer to the Agent object that should be excluded from the results (including its ghost copies).
+	/// This is most likely the agent for which the query is being performed.
+	/// Use nullptr to not exclude any agents.</param>
+	/// <param name="result">[out] Will store all entries that lie within "radius" meters of "position", sorted by increasing distance, 
+	/// excluding the agent denoted by "agentToIgnore" (if it exists).</param>
+	void FindAllAgentsInRange(const Vector2D& position, const float radius, const Agent* agentToIgnore, std::vector<Entry>& result) const override;
+
+private:
+	/// <summary>Chooses a new grid area based on the current agent positions, and puts all agents in the grid again.</summary>
+	void rebuild();
+
+	/// <summary>Checks and returns whether a given position lies inside the area covered by the grid.</summary>
+	bool isInsideGrid(const Vector2D& position) const;
+
+	/// <summary>Computes the column of the grid cell that contains a given x-coordinate, clamped to the grid boundaries.</summary>
+	int getColumn(float x) const;
+	/// <summary>Computes the row of the grid cell that contains a given y-coordinate, clamped to the grid boundaries.</summary>
+	int getRow(float y) const;
+	/// <summary>Computes the index of the grid cell that contains a given position, clamped to the grid boundaries.</summary>
+	/// <remarks>Because of clamping, agents outside the grid are stored in the nearest border cell, which keeps all queries correct.</remarks>
+	inline int getCellIndex(const Vector2D& position) const { return getRow(position.y) * nrColumns_ + getColumn(position.x); }
+
+	/// <summary>Removes the entry with a given list index from a given grid cell.</summary>
+	void removeFromCell(int cell, size_t agentIndex);
+};
+
+#endif //LIB_AGENTGRID_H
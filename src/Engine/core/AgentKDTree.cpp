@@ -28,47 +28,58 @@
 
 #include <core/AgentKDTree.h>
 
-AgentKDTree::AgentKDTree(const std::vector<Agent*>& agents) : pointCloud(agents)
+AgentKDTree::AgentKDTree() : kdTree(nullptr)
 {
-	kdTree = new NanoflannKDTree(2, pointCloud);
-	kdTree->buildIndex();
 }
 
 AgentKDTree::~AgentKDTree()
 {
-	delete kdTree;
+	if (kdTree != nullptr)
+		delete kdTree;
 }
 
-std::vector<size_t> AgentKDTree::FindAllAgentsInRange(const Vector2D& position, const float radius, const Agent* agentToIgnore) const
+void AgentKDTree::Update(const std::vector<Agent*>& agents, const std::vector<Entry>& ghosts)
 {
+	pointCloud.Fill(agents, ghosts);
+
+	// rebuild the same tree object, so that its memory is reused
+	if (kdTree == nullptr)
+		kdTree = new NanoflannKDTree(2, pointCloud);
+	kdTree->buildIndex();
+}
+
+/// <summary>A per-thread buffer for the results of nanoflann, so that queries do not have to allocate memory.</summary>
+static thread_local std::vector<std::pair<size_t, double>> result_indicesAndDistances;
+
+void AgentKDTree::FindAllAgentsInRange(const Vector2D& position, const float radius, const Agent* agentToIgnore, std::vector<Entry>& result) const
+{
+	result.clear();
+	if (kdTree == nullptr)
+		return;
+
 	// do a radius search in the kd-tree
 	double q[2] = { position.x, position.y };
-	std::vector<std::pair<size_t, double>> result_indicesAndDistances;
 	nanoflann::SearchParams params; params.sorted = true;
 	// note: nanoflann uses squared distances, so we search with radius*radius
 	auto nrResults = kdTree->radiusSearch(q, radius*radius, result_indicesAndDistances, params);
 
-	// convert the result to a list of agent IDs, possibly ignoring a certain agent
-	std::vector<size_t> result(nrResults); size_t index = 0;
+	// convert the result to a list of entries, possibly ignoring a certain agent
+	result.resize(nrResults); size_t index = 0;
 	for (size_t i = 0; i < nrResults; ++i)
 	{
-		const size_t pointCloudIndex = result_indicesAndDistances[i].first;
-		const size_t agentID = pointCloud.agentPositions[pointCloudIndex].first;
-		if (agentToIgnore != nullptr && agentID == agentToIgnore->getID())
+		const Entry& entry = pointCloud.agentPositions[result_indicesAndDistances[i].first].first;
+		if (entry.agent == agentToIgnore)
 			continue;
-		result[index] = agentID;
+		result[index] = entry;
 		++index;
 	}
-	if (index < nrResults) 
-		result.pop_back();
-
-	return result;
+	result.resize(index);
 }
 
-std::vector<size_t> AgentKDTree::FindKNearestAgents(const Vector2D& position, const size_t k, const Agent* agentToIgnore) const
+std::vector<const Agent*> AgentKDTree::FindKNearestAgents(const Vector2D& position, const size_t k, const Agent* agentToIgnore) const
 {
-	std::vector<size_t> result;
-	if (k == 0)
+	std::vector<const Agent*> result;
+	if (k == 0 || kdTree == nullptr)
 		return result;
 		
 	// when we want to ignore a certain agent, actually look for 1 agent more; we'll filter out the desired agent later
@@ -83,14 +94,13 @@ std::vector<size_t> AgentKDTree::FindKNearestAgents(const Vector2D& position, co
 	std::vector<std::pair<size_t, double>> result_indicesAndDistances;
 	auto nrResults = kdTree->knnSearch(q, kSearch, &result_indices[0], &result_distances[0]);
 
-	// convert the result to a list of agent IDs, possibly ignoring a certain agent
+	// convert the result to a list of agent pointers, possibly ignoring a certain agent
 	for (size_t i = 0; i < nrResults; ++i)
 	{
-		const size_t pointCloudIndex = result_indices[i];
-		const size_t agentID = pointCloud.agentPositions[pointCloudIndex].first;
-		if (agentToIgnore != nullptr && agentID == agentToIgnore->getID())
+		const Agent* agent = pointCloud.agentPositions[result_indices[i]].first.agent;
+		if (agent == agentToIgnore)
 			continue;
-		result.push_back(agentID);
+		result.push_back(agent);
 
 		// if we've reached k results now (which may be the case if agentToIgnore is not part of the result), ignore the farthest neighbor
 		if (result.size() == k)
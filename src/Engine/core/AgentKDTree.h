@@ -30,26 +30,29 @@
 #define LIB_AGENTKDTREE_H
 
 #include <vector>
-#include <core/agent.h>
+#include <core/SpatialIndex.h>
 #include <3rd-party/nanoflann/nanoflann.hpp>
 
 /// <summary>A 2-dimensional KD-tree of agent positions (using the *nanoflann* library), which can be used for nearest-neighbor queries.</summary>
 /// <remarks>Note: The KD-tree does not automatically change over time as the agents move.
-/// Therefore, the simulation must create a new AgentKDTree in each frame.</remarks>
-class AgentKDTree
+/// Therefore, each call to Update() rebuilds the entire tree.</remarks>
+class AgentKDTree : public SpatialIndex
 {
 private:
 
 	/// <summary>A point-cloud wrapper for agent positions, required for the *nanoflann* library.</summary>
 	struct AgentPointCloud
 	{
-		std::vector<std::pair<size_t, Vector2D>> agentPositions;
+		std::vector<std::pair<Entry, Vector2D>> agentPositions;
 
-		AgentPointCloud(const std::vector<Agent*>& agents)
+		void Fill(const std::vector<Agent*>& agents, const std::vector<Entry>& ghosts)
 		{
-			agentPositions.resize(agents.size());
+			const Vector2D noOffset(0, 0);
+			agentPositions.resize(agents.size() + ghosts.size());
 			for (size_t i = 0; i < agents.size(); ++i)
-				agentPositions[i] = std::pair<size_t, Vector2D>(agents[i]->getID(), agents[i]->getPosition());
+				agentPositions[i] = { { agents[i], noOffset }, agents[i]->getPosition() };
+			for (size_t i = 0; i < ghosts.size(); ++i)
+				agentPositions[agents.size() + i] = { ghosts[i], ghosts[i].agent->getPosition() + ghosts[i].offset };
 		}
 
 		// Must return the number of data points
@@ -79,22 +82,27 @@ private:
 	NanoflannKDTree* kdTree;
 
 public:
-	/// <summary>Creates an AgentKDTree for a given list of agents, using the *current* position of these agents.</summary>
-	/// <param name="agents">A list of agents.</param>
-	AgentKDTree(const std::vector<Agent*>& agents);
+	/// <summary>Creates an empty AgentKDTree. Call Update() to fill it with agents.</summary>
+	AgentKDTree();
 
 	/// <summary>Cleans up this AgentKDTree for removal.</summary>
 	~AgentKDTree();
 
-	/// <summary>Computes and returns the IDs of all agents that lie within a given radius of a given position.</summary>
+	/// <summary>Rebuilds this AgentKDTree for a given list of agents, using the *current* position of these agents.</summary>
+	/// <param name="agents">A list of agents.</param>
+	/// <param name="ghosts">A list of ghost copies of agents, which are stored at the agent's position plus the entry's offset.</param>
+	void Update(const std::vector<Agent*>& agents, const std::vector<Entry>& ghosts) override;
+	using SpatialIndex::Update;
+
+	/// <summary>Computes a list of all agents (and ghost copies of agents) that lie within a given radius of a given position.</summary>
 	/// <param name="position">A query position.</param>
 	/// <param name="radius">A query radius.</param>
-	/// <param name="agentToIgnore">A pointer to the Agent object that should be excluded from the results.
+	/// <param name="agentToIgnore">A pointer to the Agent object that should be excluded from the results (including its ghost copies).
 	/// This is most likely the agent for which the query is being performed.
 	/// Use nullptr to not exclude any agents.</param>
-	/// <returns>A list of IDs of agents that lie within "radius" meters of "position", 
-	/// excluding the ID of the agent denoted by "agentToIgnore" (if it exists).</returns>
-	std::vector<size_t> FindAllAgentsInRange(const Vector2D& position, const float radius, const Agent* agentToIgnore) const;
+	/// <param name="result">[out] Will store all entries that lie within "radius" meters of "position", sorted by increasing distance, 
+	/// excluding the agent denoted by "agentToIgnore" (if it exists).</param>
+	void FindAllAgentsInRange(const Vector2D& position, const float radius, const Agent* agentToIgnore, std::vector<Entry>& result) const override;
 
 	/// <summary>Computes and returns the *k* nearest agents to a given position.</summary>
 	/// <param name="position">A query position.</param>
@@ -102,10 +110,10 @@ public:
 	/// <param name="agentToIgnore">A pointer to the Agent object that should be excluded from the results.
 	/// This is most likely the agent for which the query is being performed.
 	/// Use nullptr to not exclude any agents.</param>
-	/// <returns>A list of IDs of the "k" agents that are closest to "position", 
-	/// excluding the ID of the agent denoted by "agentToIgnore" (if it exists). 
+	/// <returns>A list of pointers to the "k" agents that are closest to "position", 
+	/// excluding the agent denoted by "agentToIgnore" (if it exists). 
 	/// Note: The list may have less than "k" entries if there are not enough agents in the world.</returns>
-	std::vector<size_t> FindKNearestAgents(const Vector2D& position, const size_t k, const Agent* agentToIgnore) const;
+	std::vector<const Agent*> FindKNearestAgents(const Vector2D& position, const size_t k, const Agent* agentToIgnore) const;
 };
 
 #endif //LIB_AGENTKDTREE_H
\ No newline at end of file
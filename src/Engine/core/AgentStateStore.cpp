@@ -0,0 +1,127 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#include <core/AgentStateStore.h>
+#include <core/agent.h>
+#include <core/ThreadPool.h>
+
+void AgentStateStore::push_back(Agent* agent, const Vector2D& position, const Vector2D& velocity, const Vector2D& acceleration,
+	const Vector2D& preferredVelocity, const Vector2D& goal, float radius)
+{
+	agent->states_ = this;
+	agent->stateSlot_ = agents_.size();
+
+	agents_.push_back(agent);
+	positions_.push_back(position);
+	velocities_.push_back(velocity);
+	accelerations_.push_back(acceleration);
+	preferredVelocities_.push_back(preferredVelocity);
+	goals_.push_back(goal);
+	radii_.push_back(radius);
+}
+
+void AgentStateStore::Add(Agent* agent)
+{
+	const Vector2D zero(0, 0);
+	push_back(agent, zero, zero, zero, zero, zero, 0);
+}
+
+void AgentStateStore::Reserve(size_t capacity)
+{
+	agents_.reserve(capacity);
+	positions_.reserve(capacity);
+	velocities_.reserve(capacity);
+	accelerations_.reserve(capacity);
+	preferredVelocities_.reserve(capacity);
+	goals_.reserve(capacity);
+	radii_.reserve(capacity);
+}
+
+void AgentStateStore::Remove(size_t slot)
+{
+	// move the last slot into the slot that has now become free
+	const size_t last = agents_.size() - 1;
+	if (slot != last)
+	{
+		agents_[slot] = agents_[last];
+		positions_[slot] = positions_[last];
+		velocities_[slot] = velocities_[last];
+		accelerations_[slot] = accelerations_[last];
+		preferredVelocities_[slot] = preferredVelocities_[last];
+		goals_[slot] = goals_[last];
+		radii_[slot] = radii_[last];
+
+		agents_[slot]->stateSlot_ = slot;
+	}
+
+	agents_.pop_back();
+	positions_.pop_back();
+	velocities_.pop_back();
+	accelerations_.pop_back();
+	preferredVelocities_.pop_back();
+	goals_.pop_back();
+	radii_.pop_back();
+}
+
+void AgentStateStore::MoveTo(size_t slot, AgentStateStore& target)
+{
+	target.push_back(agents_[slot], positions_[slot], velocities_[slot], accelerations_[slot],
+		preferredVelocities_[slot], goals_[slot], radii_[slot]);
+	Remove(slot);
+}
+
+void AgentStateStore::Reorder(const std::vector<size_t>& order, ThreadPool& threadPool)
+{
+	const size_t n = agents_.size();
+	std::vector<Agent*> agents(n);
+	std::vector<Vector2D> positions(n), velocities(n), accelerations(n), preferredVelocities(n), goals(n);
+	std::vector<float> radii(n);
+
+	// copy the data of each slot to its new position
+	threadPool.ParallelFor(n, [&](size_t i)
+	{
+		const size_t slot = order[i];
+		agents[i] = agents_[slot];
+		positions[i] = positions_[slot];
+		velocities[i] = velocities_[slot];
+		accelerations[i] = accelerations_[slot];
+		preferredVelocities[i] = preferredVelocities_[slot];
+		goals[i] = goals_[slot];
+		radii[i] = radii_[slot];
+
+		agents[i]->stateSlot_ = i;
+	});
+
+	agents_.swap(agents);
+	positions_.swap(positions);
+	velocities_.swap(velocities);
+	accelerations_.swap(accelerations);
+	preferredVelocities_.swap(preferredVelocities);
+	goals_.swap(goals);
+	radii_.swap(radii);
+}
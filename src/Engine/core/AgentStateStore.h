@@ -0,0 +1,101 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#ifndef LIB_AGENTSTATESTORE_H
+#define LIB_AGENTSTATESTORE_H
+
+#include <vector>
+#include <tools/vector2D.h>
+
+class Agent;
+class ThreadPool;
+
+/// <summary>A structure-of-arrays container for the agent data that is used in every simulation step.</summary>
+/// <remarks>Each Agent refers to one slot of an AgentStateStore, and its getters and setters read and write this slot.
+/// Because all positions (and all velocities, etc.) are stored next to each other, 
+/// loops over all agents in the simulation can read and write contiguous memory.
+/// When a slot is removed, the last slot is moved into its place, and the Agent of that slot is updated accordingly.
+/// In this way, WorldBase can keep the slots of its active agents in the same order as its list of agents.
+/// Note: References returned by the getters of Agent (e.g. Agent::getPosition()) become invalid when agents are added to or removed from the store, 
+/// or when the store is reordered.</remarks>
+class AgentStateStore
+{
+private:
+	/// <summary>For each slot, the agent that uses it.</summary>
+	std::vector<Agent*> agents_;
+
+	std::vector<Vector2D> positions_;
+	std::vector<Vector2D> velocities_;
+	std::vector<Vector2D> accelerations_;
+	std::vector<Vector2D> preferredVelocities_;
+	std::vector<Vector2D> goals_;
+	std::vector<float> radii_;
+
+	friend Agent;
+
+public:
+	/// <summary>Returns the number of slots in this store.</summary>
+	inline size_t Size() const { return agents_.size(); }
+
+	/// <summary>Returns the positions of all agents in this store, ordered by slot.</summary>
+	inline const std::vector<Vector2D>& GetPositions() const { return positions_; }
+	/// <summary>Returns the velocities of all agents in this store, ordered by slot.</summary>
+	inline const std::vector<Vector2D>& GetVelocities() const { return velocities_; }
+	/// <summary>Returns the radii of all agents in this store, ordered by slot.</summary>
+	inline const std::vector<float>& GetRadii() const { return radii_; }
+
+	/// <summary>Creates a new slot for the given agent at the end of this store, with all values set to zero.</summary>
+	/// <param name="agent">The agent that will use the new slot.</param>
+	void Add(Agent* agent);
+
+	/// <summary>Reserves memory for the given number of slots, so that adding many agents does not cause repeated reallocations.</summary>
+	/// <param name="capacity">The total number of slots to reserve memory for.</param>
+	void Reserve(size_t capacity);
+
+	/// <summary>Removes the slot with the given index from this store, by moving the last slot into its place.</summary>
+	/// <param name="slot">The index of the slot to remove.</param>
+	void Remove(size_t slot);
+
+	/// <summary>Moves the data of a slot to the end of another store, and removes the slot from this store.</summary>
+	/// <param name="slot">The index of the slot to move.</param>
+	/// <param name="target">The store that should receive the data.</param>
+	void MoveTo(size_t slot, AgentStateStore& target);
+
+	/// <summary>Changes the order of all slots in this store, and updates the Agent of each slot accordingly.</summary>
+	/// <param name="order">For each new slot, the index of the (old) slot whose data it should receive. 
+	/// This must be a permutation of all slot indices.</param>
+	/// <param name="threadPool">The threads to use for moving the data.</param>
+	void Reorder(const std::vector<size_t>& order, ThreadPool& threadPool);
+
+private:
+	/// <summary>Adds a slot with the given values to the end of this store.</summary>
+	void push_back(Agent* agent, const Vector2D& position, const Vector2D& velocity, const Vector2D& acceleration,
+		const Vector2D& preferredVelocity, const Vector2D& goal, float radius);
+};
+
+#endif //LIB_AGENTSTATESTORE_H
@@ -0,0 +1,327 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#include <core/BinaryScenario.h>
+#include <core/agent.h>
+#include <3rd-party/tinyxml/tinyxml2.h>
+
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <clocale>
+#include <limits>
+#include <filesystem>
+
+static const char magic[8] = { 'U', 'M', 'A', 'N', 'S', 'B', 'I', 'N' };
+
+bool BinaryScenario::IsBinaryFile(const std::string& filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	char fileMagic[sizeof(magic)];
+	return file.read(fileMagic, sizeof(fileMagic)) && memcmp(fileMagic, magic, sizeof(magic)) == 0;
+}
+
+const BinaryScenario::Header* BinaryScenario::GetHeader(const MemoryMappedFile& file)
+{
+	if (file.GetData() == nullptr || file.GetSize() < sizeof(Header) || memcmp(file.GetData(), magic, sizeof(magic)) != 0)
+	{
+		std::cerr << "Error: The file is not a binary scenario file." << std::endl;
+		return nullptr;
+	}
+
+	const Header* header = (const Header*)file.GetData();
+	if (header->version != Version)
+	{
+		std::cerr << "Error: The binary scenario file has version " << header->version << ", but only version " << Version << " is supported." << std::endl;
+		return nullptr;
+	}
+	if (header->byteOrderMark != ByteOrderMark)
+	{
+		std::cerr << "Error: The binary scenario file was written on a machine with a different byte order." << std::endl;
+		return nullptr;
+	}
+
+	// check that all sections lie inside the file, and that binary sections are aligned
+	const auto& isValid = [&file](const Section& section, size_t elementSize, size_t alignment)
+	{
+		return section.offset % alignment == 0
+			&& section.offset <= file.GetSize()
+			&& section.count <= (file.GetSize() - section.offset) / elementSize;
+	};
+
+	if (!isValid(header->world, 1, 1) || !isValid(header->policies, 1, 1) || !isValid(header->generator, 1, 1)
+		|| !isValid(header->agents, sizeof(AgentRecord), alignof(AgentRecord))
+		|| !isValid(header->obstacleSizes, sizeof(uint32_t), alignof(uint32_t))
+		|| !isValid(header->obstaclePoints, 2 * sizeof(float), alignof(float)))
+	{
+		std::cerr << "Error: The binary scenario file is damaged or incomplete." << std::endl;
+		return nullptr;
+	}
+
+	return header;
+}
+
+#pragma region [Conversion from XML]
+
+/// <summary>Returns the XML element that a block refers to: either the block itself, or the main element of the external file named in its "file" attribute.</summary>
+static const tinyxml2::XMLElement* resolveBlock(const tinyxml2::XMLElement* block, const char* blockName, const std::string& fileFolder, tinyxml2::XMLDocument& externalDoc)
+{
+	const char* externalFilename = block->Attribute("file");
+	if (externalFilename == nullptr)
+		return block;
+
+	externalDoc.LoadFile((fileFolder + externalFilename).data());
+	const tinyxml2::XMLElement* externalBlock = externalDoc.ErrorID() == 0 ? externalDoc.FirstChildElement(blockName) : nullptr;
+	if (externalBlock == nullptr)
+		std::cerr << "Could not load or parse " << blockName << " XML file at " << (fileFolder + externalFilename) << "." << std::endl;
+	return externalBlock;
+}
+
+/// <summary>Converts an XML element to text; if deep is false, the element's children are left out.</summary>
+static std::string elementToText(const tinyxml2::XMLElement* element, bool deep)
+{
+	tinyxml2::XMLDocument doc;
+	doc.InsertEndChild(deep ? element->DeepClone(&doc) : element->ShallowClone(&doc));
+
+	tinyxml2::XMLPrinter printer(nullptr, true);
+	doc.Print(&printer);
+	return printer.CStr();
+}
+
+/// <summary>Converts an Agent element to an AgentRecord, using the same defaults as CrowdSimulator.</summary>
+static bool agentElementToRecord(const tinyxml2::XMLElement* agentElement, BinaryScenario::AgentRecord& record)
+{
+	int agentID = -1;
+	agentElement->QueryIntAttribute("id", &agentID);
+
+	Agent::Settings settings;
+	agentElement->QueryFloatAttribute("rad", &settings.radius_);
+	agentElement->QueryFloatAttribute("pref_speed", &settings.preferred_speed_);
+	agentElement->QueryFloatAttribute("max_speed", &settings.max_speed_);
+	agentElement->QueryFloatAttribute("max_acceleration", &settings.max_acceleration_);
+	agentElement->QueryFloatAttribute("mass", &settings.mass_);
+	agentElement->QueryBoolAttribute("remove_at_goal", &settings.remove_at_goal_);
+
+	auto* colorElement = agentElement->FirstChildElement("color");
+	if (colorElement)
+	{
+		int r = -1, g = -1, b = -1;
+		colorElement->QueryIntAttribute("r", &r);
+		colorElement->QueryIntAttribute("g", &g);
+		colorElement->QueryIntAttribute("b", &b);
+		settings.color_ = Color((unsigned short)r, (unsigned short)g, (unsigned short)b);
+	}
+
+	auto* positionElement = agentElement->FirstChildElement("pos");
+	auto* policyElement = agentElement->FirstChildElement("Policy");
+	if (!positionElement || !policyElement)
+	{
+		std::cerr << "Error: Agent " << agentID << " needs a position element and a policy element." << std::endl;
+		return false;
+	}
+
+	memset(&record, 0, sizeof(record));
+	record.id = agentID >= 0 ? (uint64_t)agentID : std::numeric_limits<uint64_t>::max();
+	positionElement->QueryFloatAttribute("x", &record.position[0]);
+	positionElement->QueryFloatAttribute("y", &record.position[1]);
+
+	// an agent without a goal stays where it is
+	record.goal[0] = record.position[0];
+	record.goal[1] = record.position[1];
+	auto* goalElement = agentElement->FirstChildElement("goal");
+	if (goalElement)
+	{
+		goalElement->QueryFloatAttribute("x", &record.goal[0]);
+		goalElement->QueryFloatAttribute("y", &record.goal[1]);
+	}
+
+	record.radius = settings.radius_;
+	record.preferredSpeed = settings.preferred_speed_;
+	record.maxSpeed = settings.max_speed_;
+	record.maxAcceleration = settings.max_acceleration_;
+	record.mass = settings.mass_;
+	agentElement->QueryFloatAttribute("start_time", &record.startTime);
+	policyElement->QueryIntAttribute("id", &record.policyID);
+	record.color[0] = settings.color_.r;
+	record.color[1] = settings.color_.g;
+	record.color[2] = settings.color_.b;
+	record.removeAtGoal = settings.remove_at_goal_ ? 1 : 0;
+	return true;
+}
+
+/// <summary>Appends a section to a binary file, padded to a multiple of 8 bytes, and returns its location.</summary>
+static BinaryScenario::Section writeSection(std::ofstream& file, const void* data, size_t count, size_t elementSize)
+{
+	BinaryScenario::Section section;
+	section.offset = (uint64_t)file.tellp();
+	section.count = count;
+
+	file.write((const char*)data, count * elementSize);
+	const char zeros[8] = { 0 };
+	file.write(zeros, (8 - (count * elementSize) % 8) % 8);
+	return section;
+}
+
+bool BinaryScenario::ConvertFromXML(const std::string& xmlFilename, const std::string& binaryFilename)
+{
+	std::setlocale(LC_NUMERIC, "en_US.UTF-8");
+
+	tinyxml2::XMLDocument doc;
+	doc.LoadFile(xmlFilename.data());
+	if (doc.ErrorID() != 0)
+	{
+		std::cerr << "Error: Could not load or parse XML file at " << xmlFilename << std::endl;
+		return false;
+	}
+
+	const std::string& fileFolder = std::filesystem::path(xmlFilename).remove_filename().string();
+
+	// follow a "main" config file to the config file that it refers to
+	const tinyxml2::XMLElement* simConfigPathElement = doc.FirstChildElement("configPath");
+	if (simConfigPathElement != nullptr)
+		return ConvertFromXML(fileFolder + simConfigPathElement->Attribute("path"), binaryFilename);
+
+	const tinyxml2::XMLElement* simulationElement = doc.FirstChildElement("Simulation");
+	const tinyxml2::XMLElement* worldElement = simulationElement ? simulationElement->FirstChildElement("World") : nullptr;
+	if (worldElement == nullptr)
+	{
+		std::cerr << "Error: No main Simulation element with a World element in the XML file" << std::endl;
+		return false;
+	}
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, magic, sizeof(magic));
+	header.version = Version;
+	header.byteOrderMark = ByteOrderMark;
+	header.deltaTime = -1;
+	header.endTime = -1;
+	simulationElement->QueryFloatAttribute("delta_time", &header.deltaTime);
+	simulationElement->QueryFloatAttribute("end_time", &header.endTime);
+	header.outputStepInterval = 1;
+	header.outputTimeInterval = 0;
+	simulationElement->QueryIntAttribute("output_step_interval", &header.outputStepInterval);
+	simulationElement->QueryFloatAttribute("output_time_interval", &header.outputTimeInterval);
+
+	// --- Collect the XML parts: the world without its obstacles, the policies, and the agent generator
+
+	const std::string& worldText = elementToText(worldElement, false);
+
+	std::string policiesText;
+	const tinyxml2::XMLElement* policiesElement = simulationElement->FirstChildElement("Policies");
+	if (policiesElement != nullptr)
+	{
+		tinyxml2::XMLDocument externalDoc;
+		policiesElement = resolveBlock(policiesElement, "Policies", fileFolder, externalDoc);
+		if (policiesElement == nullptr)
+			return false;
+		policiesText = elementToText(policiesElement, true);
+	}
+
+	// --- Collect the agents
+
+	std::string generatorText;
+	std::vector<AgentRecord> agents;
+	const tinyxml2::XMLElement* agentsElement = simulationElement->FirstChildElement("Agents");
+	tinyxml2::XMLDocument externalAgentsDoc;
+	if (agentsElement != nullptr)
+	{
+		agentsElement = resolveBlock(agentsElement, "Agents", fileFolder, externalAgentsDoc);
+		if (agentsElement == nullptr)
+			return false;
+
+		if (agentsElement->Attribute("generator") != nullptr)
+			generatorText = elementToText(agentsElement, false);
+
+		for (const tinyxml2::XMLElement* element = agentsElement->FirstChildElement(); element != nullptr; element = element->NextSiblingElement("Agent"))
+		{
+			AgentRecord record;
+			if (!agentElementToRecord(element, record))
+				return false;
+			agents.push_back(record);
+		}
+	}
+
+	// --- Collect the obstacles
+
+	std::vector<uint32_t> obstacleSizes;
+	std::vector<float> obstaclePoints;
+	const tinyxml2::XMLElement* obstaclesElement = worldElement->FirstChildElement("Obstacles");
+	tinyxml2::XMLDocument externalObstaclesDoc;
+	if (obstaclesElement != nullptr)
+	{
+		obstaclesElement = resolveBlock(obstaclesElement, "Obstacles", fileFolder, externalObstaclesDoc);
+		if (obstaclesElement == nullptr)
+			return false;
+
+		for (const tinyxml2::XMLElement* element = obstaclesElement->FirstChildElement(); element != nullptr; element = element->NextSiblingElement("Obstacle"))
+		{
+			uint32_t nrPoints = 0;
+			for (const tinyxml2::XMLElement* pointElement = element->FirstChildElement("Point"); pointElement != nullptr; pointElement = pointElement->NextSiblingElement("Point"))
+			{
+				float x = 0, y = 0;
+				pointElement->QueryFloatAttribute("x", &x);
+				pointElement->QueryFloatAttribute("y", &y);
+				obstaclePoints.push_back(x);
+				obstaclePoints.push_back(y);
+				++nrPoints;
+			}
+			obstacleSizes.push_back(nrPoints);
+		}
+	}
+
+	// --- Write the file: a placeholder header first, then all sections, then the final header
+
+	std::ofstream file(binaryFilename, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << "Error: Could not open " << binaryFilename << " for writing." << std::endl;
+		return false;
+	}
+
+	file.write((const char*)&header, sizeof(header));
+	header.world = writeSection(file, worldText.data(), worldText.size(), 1);
+	header.policies = writeSection(file, policiesText.data(), policiesText.size(), 1);
+	header.generator = writeSection(file, generatorText.data(), generatorText.size(), 1);
+	header.agents = writeSection(file, agents.data(), agents.size(), sizeof(AgentRecord));
+	header.obstacleSizes = writeSection(file, obstacleSizes.data(), obstacleSizes.size(), sizeof(uint32_t));
+	header.obstaclePoints = writeSection(file, obstaclePoints.data(), obstaclePoints.size() / 2, 2 * sizeof(float));
+
+	file.seekp(0);
+	file.write((const char*)&header, sizeof(header));
+
+	if (!file)
+	{
+		std::cerr << "Error: Could not write " << binaryFilename << "." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+#pragma endregion
@@ -0,0 +1,123 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#ifndef LIB_BINARY_SCENARIO_H
+#define LIB_BINARY_SCENARIO_H
+
+#include <string>
+#include <cstdint>
+#include <tools/MemoryMappedFile.h>
+
+/// <summary>Describes a compact binary format for simulation scenarios, and converts XML scenario files to this format.</summary>
+/// <remarks>XML remains the format for writing scenarios by hand; the binary format is meant for quickly loading large scenarios.
+/// A binary file starts with a Header, followed by sections that the header refers to:
+/// <list type="bullet">
+/// <item>the World element (without obstacles), the Policies element, and an optional Agents element with a generator, all as XML text;</item>
+/// <item>one AgentRecord per agent;</item>
+/// <item>the number of points of each obstacle (as 32-bit integers), followed by all obstacle points (as pairs of floats).</item>
+/// </list>
+/// Policies are kept as XML text because each cost function reads its own parameters from XML; these blocks are small anyway.
+/// Binary sections start at multiples of 8 bytes, so that a memory-mapped file can be read without copying.
+/// All numbers use the byte order of the machine that wrote the file; the header contains a marker to detect a mismatch.
+/// CrowdSimulator::FromConfigFile() recognizes binary files automatically.</remarks>
+class BinaryScenario
+{
+public:
+	/// <summary>The version of the format written by this code.</summary>
+	static const uint32_t Version = 2;
+	/// <summary>The value of Header::byteOrderMark in files written on a machine with the same byte order.</summary>
+	static const uint32_t ByteOrderMark = 0x01020304;
+
+	/// <summary>The location and number of elements of a section in a binary file.</summary>
+	struct Section
+	{
+		/// <summary>The position of the section, in bytes from the start of the file.</summary>
+		uint64_t offset;
+		/// <summary>The number of elements in the section (i.e. the number of characters for a section with XML text).</summary>
+		uint64_t count;
+	};
+
+	/// <summary>The header at the start of a binary scenario file.</summary>
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t byteOrderMark;
+		float deltaTime;
+		float endTime;
+		int32_t outputStepInterval;
+		float outputTimeInterval;
+		Section world;
+		Section policies;
+		Section generator;
+		Section agents;
+		Section obstacleSizes;
+		Section obstaclePoints;
+	};
+
+	/// <summary>The data of a single agent in a binary scenario file.</summary>
+	struct AgentRecord
+	{
+		/// <summary>The desired ID of the agent, or the maximum uint64_t value to let the world choose an ID.</summary>
+		uint64_t id;
+		float position[2];
+		float goal[2];
+		float radius;
+		float preferredSpeed;
+		float maxSpeed;
+		float maxAcceleration;
+		float mass;
+		float startTime;
+		int32_t policyID;
+		uint16_t color[3];
+		uint8_t removeAtGoal;
+		uint8_t padding[5];
+	};
+
+	/// <summary>Checks whether a file starts with the signature of a binary scenario file.</summary>
+	/// <param name="filename">The name of the file to check.</param>
+	/// <returns>true if the file exists and looks like a binary scenario file; false otherwise.</returns>
+	static bool IsBinaryFile(const std::string& filename);
+
+	/// <summary>Checks whether a mapped file is a valid binary scenario file, and returns its header.</summary>
+	/// <param name="file">A file that has been mapped into memory.</param>
+	/// <returns>A pointer to the header inside the mapped file, or nullptr if the file is not a valid binary scenario file.
+	/// In the latter case, an error message is printed.</returns>
+	static const Header* GetHeader(const MemoryMappedFile& file);
+
+	/// <summary>Converts an XML scenario file (including all files it refers to) to a single binary scenario file.</summary>
+	/// <param name="xmlFilename">The name of the XML file to convert.</param>
+	/// <param name="binaryFilename">The name of the binary file to write.</param>
+	/// <returns>true if the conversion succeeded; false otherwise. In the latter case, an error message is printed.</returns>
+	static bool ConvertFromXML(const std::string& xmlFilename, const std::string& binaryFilename);
+};
+
+static_assert(sizeof(BinaryScenario::Header) == 128, "The binary scenario header should not contain implicit padding");
+static_assert(sizeof(BinaryScenario::AgentRecord) == 64, "The binary agent record should not contain implicit padding");
+
+#endif //LIB_BINARY_SCENARIO_H
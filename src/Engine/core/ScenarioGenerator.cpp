@@ -0,0 +1,197 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#include <core/ScenarioGenerator.h>
+#include <core/worldBase.h>
+#include <random>
+
+bool ScenarioGenerator::LayoutFromString(const std::string& name, Layout& result)
+{
+	if (name == "circle")
+		result = CIRCLE;
+	else if (name == "crossing_flows")
+		result = CROSSING_FLOWS;
+	else if (name == "bidirectional_corridor")
+		result = BIDIRECTIONAL_CORRIDOR;
+	else if (name == "random_dense")
+		result = RANDOM_DENSE;
+	else
+		return false;
+	return true;
+}
+
+bool ScenarioGenerator::Generate(WorldBase* world, const Settings& settings)
+{
+	if (settings.agentSettings.policy_ == nullptr)
+	{
+		std::cerr << "Error: Generated agents need a policy." << std::endl;
+		return false;
+	}
+	if (settings.layout == RANDOM_DENSE && settings.density <= 0)
+	{
+		std::cerr << "Error: The density of generated agents must be positive." << std::endl;
+		return false;
+	}
+
+	const float spacing = settings.spacing > 0 ? settings.spacing : 2 * settings.agentSettings.radius_ + 0.2f;
+
+	// compute all start and goal positions relative to the center of the layout
+	std::vector<Vector2D> positions, goals;
+	std::vector<std::vector<Vector2D>> obstacles;
+	positions.reserve(settings.count);
+	goals.reserve(settings.count);
+
+	switch (settings.layout)
+	{
+	case CIRCLE:
+		generateCircle(settings, spacing, positions, goals);
+		break;
+	case CROSSING_FLOWS:
+		generateCrossingFlows(settings, spacing, positions, goals);
+		break;
+	case BIDIRECTIONAL_CORRIDOR:
+		generateBidirectionalCorridor(settings, spacing, positions, goals, obstacles);
+		break;
+	case RANDOM_DENSE:
+		generateRandomDense(settings, positions, goals);
+		break;
+	}
+
+	// add the agents to the world
+	world->ReserveAgents(positions.size());
+	for (size_t i = 0; i < positions.size(); ++i)
+	{
+		Agent* agent = world->AddAgent(settings.center + positions[i], settings.agentSettings);
+		agent->setGoal(settings.center + goals[i]);
+	}
+
+	// add the obstacles to the world
+	for (auto& obstacle : obstacles)
+	{
+		for (Vector2D& point : obstacle)
+			point += settings.center;
+		world->AddObstacle(obstacle);
+	}
+
+	return true;
+}
+
+void ScenarioGenerator::generateCircle(const Settings& settings, float spacing, std::vector<Vector2D>& positions, std::vector<Vector2D>& goals)
+{
+	// choose the radius of the circle such that neighboring agents are separated by the given spacing
+	const float circleRadius = std::max(spacing, (float)(settings.count * spacing / (2 * PI)));
+
+	for (size_t i = 0; i < settings.count; ++i)
+	{
+		const double angle = 2 * PI * i / settings.count;
+		const Vector2D position((float)cos(angle) * circleRadius, (float)sin(angle) * circleRadius);
+		positions.push_back(position);
+		goals.push_back(-position);
+	}
+}
+
+void ScenarioGenerator::generateCrossingFlows(const Settings& settings, float spacing, std::vector<Vector2D>& positions, std::vector<Vector2D>& goals)
+{
+	// each flow is a square block of agents; 
+	// the first block lies to the left of the center and walks to the right,
+	// the second block lies below the center and walks upwards
+	const size_t nrAgentsPerFlow[2] = { settings.count / 2, settings.count - settings.count / 2 };
+	const size_t nrColumns = std::max((size_t)1, (size_t)ceil(sqrt((double)nrAgentsPerFlow[1])));
+	const float blockSize = (nrColumns - 1) * spacing;
+	const float gap = blockSize / 2 + spacing;
+
+	for (int flow = 0; flow < 2; ++flow)
+	{
+		for (size_t i = 0; i < nrAgentsPerFlow[flow]; ++i)
+		{
+			// a: the coordinate along the walking direction; b: the coordinate perpendicular to it
+			const float a = -gap - (i / nrColumns) * spacing;
+			const float b = -blockSize / 2 + (i % nrColumns) * spacing;
+			const Vector2D position = (flow == 0 ? Vector2D(a, b) : Vector2D(b, a));
+			positions.push_back(position);
+			goals.push_back(flow == 0 ? Vector2D(-a, b) : Vector2D(b, -a));
+		}
+	}
+}
+
+void ScenarioGenerator::generateBidirectionalCorridor(const Settings& settings, float spacing, std::vector<Vector2D>& positions, std::vector<Vector2D>& goals,
+	std::vector<std::vector<Vector2D>>& obstacles)
+{
+	// the corridor is horizontal; 
+	// the first group starts on the left and walks to the right, the second group does the opposite
+	const float width = std::max(settings.corridorWidth, spacing);
+	const size_t nrRows = std::max((size_t)1, (size_t)(width / spacing));
+	const float firstRowY = -(nrRows - 1) * spacing / 2;
+
+	const size_t nrAgentsPerGroup[2] = { settings.count / 2, settings.count - settings.count / 2 };
+	for (int group = 0; group < 2; ++group)
+	{
+		const float direction = (group == 0 ? -1.0f : 1.0f);
+		for (size_t i = 0; i < nrAgentsPerGroup[group]; ++i)
+		{
+			const Vector2D position(direction * (1 + i / nrRows) * spacing, firstRowY + (i % nrRows) * spacing);
+			positions.push_back(position);
+			goals.push_back(Vector2D(-position.x, position.y));
+		}
+	}
+
+	// add walls along the corridor, slightly longer than the area occupied by the agents
+	const float halfLength = (2 + nrAgentsPerGroup[1] / nrRows) * spacing + 5;
+	const float wallThickness = 0.5f;
+	for (float side : { -1.0f, 1.0f })
+	{
+		const float inner = side * width / 2, outer = side * (width / 2 + wallThickness);
+		obstacles.push_back({ Vector2D(-halfLength, inner), Vector2D(halfLength, inner), Vector2D(halfLength, outer), Vector2D(-halfLength, outer) });
+	}
+}
+
+void ScenarioGenerator::generateRandomDense(const Settings& settings, std::vector<Vector2D>& positions, std::vector<Vector2D>& goals)
+{
+	// divide a square into one cell per agent, and place each agent randomly in its own cell, 
+	// such that agents do not overlap if the density allows it
+	const size_t nrColumns = std::max((size_t)1, (size_t)ceil(sqrt((double)settings.count)));
+	const float cellSize = 1 / sqrt(settings.density);
+	const float squareSize = nrColumns * cellSize;
+	const float maxOffset = std::max(0.0f, cellSize / 2 - settings.agentSettings.radius_);
+
+	std::mt19937 RNGengine(settings.seed);
+	std::uniform_real_distribution<float> offsetDistribution(-maxOffset, maxOffset);
+	std::uniform_real_distribution<float> goalDistribution(-squareSize / 2, squareSize / 2);
+
+	for (size_t i = 0; i < settings.count; ++i)
+	{
+		const Vector2D cellCenter(-squareSize / 2 + (i % nrColumns + 0.5f) * cellSize, -squareSize / 2 + (i / nrColumns + 0.5f) * cellSize);
+		const float offsetX = offsetDistribution(RNGengine);
+		const float offsetY = offsetDistribution(RNGengine);
+		positions.push_back(cellCenter + Vector2D(offsetX, offsetY));
+
+		const float goalX = goalDistribution(RNGengine);
+		const float goalY = goalDistribution(RNGengine);
+		goals.push_back(Vector2D(goalX, goalY));
+	}
+}
@@ -0,0 +1,101 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#ifndef LIB_SCENARIO_GENERATOR_H
+#define LIB_SCENARIO_GENERATOR_H
+
+#include <vector>
+#include <string>
+#include <core/agent.h>
+
+class WorldBase;
+
+/// <summary>Creates large groups of agents directly in a world, according to one of several predefined layouts.
+/// This is much faster than describing each agent separately in an XML file, which makes it suitable for stress tests with many agents.</summary>
+/// <remarks>In a scenario file, a generator can be used via the attributes of the Agents element, e.g. 
+/// <c>&lt;Agents generator="circle" count="100000" policy="0" /&gt;</c>. See CrowdSimulator::FromConfigFile() for all attributes.
+/// All layouts are deterministic: the same settings always result in the same agents.</remarks>
+class ScenarioGenerator
+{
+public:
+	/// <summary>The possible layouts of generated agents.</summary>
+	enum Layout
+	{
+		/// <summary>Agents are placed on a circle, and each agent walks to the opposite side of the circle.</summary>
+		CIRCLE,
+		/// <summary>Two square groups of agents cross each other at a right angle.</summary>
+		CROSSING_FLOWS,
+		/// <summary>Two groups of agents start at opposite ends of a corridor with walls, and walk towards each other's starting area.</summary>
+		BIDIRECTIONAL_CORRIDOR,
+		/// <summary>Agents are placed randomly in a square with a given density, and each agent walks to a random position in the same square.</summary>
+		RANDOM_DENSE
+	};
+
+	/// <summary>Describes a group of agents to generate.</summary>
+	struct Settings
+	{
+		/// <summary>The layout of the agents.</summary>
+		Layout layout = CIRCLE;
+		/// <summary>The number of agents to generate.</summary>
+		size_t count = 0;
+		/// <summary>The settings (including the policy) that all generated agents will use.</summary>
+		Agent::Settings agentSettings;
+		/// <summary>The center of the layout.</summary>
+		Vector2D center = Vector2D(0, 0);
+		/// <summary>The distance between neighboring agents in the initial layout (in meters).
+		/// If this is zero or negative, the generator uses twice the agent radius plus 0.2 meters.</summary>
+		float spacing = -1;
+		/// <summary>The width of the corridor in the BIDIRECTIONAL_CORRIDOR layout (in meters).</summary>
+		float corridorWidth = 10;
+		/// <summary>The number of agents per square meter in the RANDOM_DENSE layout.</summary>
+		float density = 1;
+		/// <summary>The seed for random-number generation in the RANDOM_DENSE layout.</summary>
+		unsigned int seed = 0;
+	};
+
+	/// <summary>Converts a layout name (e.g. "crossing_flows") to a Layout value.</summary>
+	/// <param name="name">The name of a layout.</param>
+	/// <param name="result">[out] Will store the layout with the given name, if it exists.</param>
+	/// <returns>true if the name refers to an existing layout; false otherwise.</returns>
+	static bool LayoutFromString(const std::string& name, Layout& result);
+
+	/// <summary>Adds a group of generated agents (and possibly obstacles) to a world.</summary>
+	/// <param name="world">The world to which the agents should be added.</param>
+	/// <param name="settings">The settings that describe which agents to generate.</param>
+	/// <returns>true if the agents were added; false if the settings were invalid, e.g. because no policy was given.</returns>
+	static bool Generate(WorldBase* world, const Settings& settings);
+
+private:
+	static void generateCircle(const Settings& settings, float spacing, std::vector<Vector2D>& positions, std::vector<Vector2D>& goals);
+	static void generateCrossingFlows(const Settings& settings, float spacing, std::vector<Vector2D>& positions, std::vector<Vector2D>& goals);
+	static void generateBidirectionalCorridor(const Settings& settings, float spacing, std::vector<Vector2D>& positions, std::vector<Vector2D>& goals,
+		std::vector<std::vector<Vector2D>>& obstacles);
+	static void generateRandomDense(const Settings& settings, std::vector<Vector2D>& positions, std::vector<Vector2D>& goals);
+};
+
+#endif //LIB_SCENARIO_GENERATOR_H
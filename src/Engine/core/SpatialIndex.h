@@ -0,0 +1,85 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#ifndef LIB_SPATIALINDEX_H
+#define LIB_SPATIALINDEX_H
+
+#include <vector>
+#include <string>
+#include <core/agent.h>
+
+/// <summary>An abstract class describing a spatial data structure of agent positions, which can be used for nearest-neighbor queries.</summary>
+/// <remarks>A WorldBase object owns exactly one SpatialIndex. At the start of each simulation frame, the world calls Update() 
+/// with the current list of agents, after which any number of (parallel) queries can be performed until the next call to Update().
+/// Besides the agents themselves, the index can contain "ghost" copies of agents at translated positions; 
+/// a WorldToric uses these to find neighbors across its boundaries with a single query.
+/// Subclasses may choose to rebuild their data from scratch in each Update() (like AgentKDTree), or to update it incrementally (like AgentGrid).</remarks>
+class SpatialIndex
+{
+public:
+	/// <summary>An enum containing the types of spatial index that can be used in a world.</summary>
+	enum Type { UNKNOWN_SPATIAL_INDEX_TYPE, KD_TREE, UNIFORM_GRID };
+	static Type StringToSpatialIndexType(const std::string& type);
+
+	/// <summary>An agent in a SpatialIndex, possibly translated by an offset.</summary>
+	struct Entry
+	{
+		/// <summary>A pointer to the agent.</summary>
+		const Agent* agent;
+		/// <summary>The amount by which the agent's position is translated in the index. 
+		/// This is zero for the agent itself, and non-zero for a ghost copy of the agent.</summary>
+		Vector2D offset;
+	};
+
+	/// <summary>Cleans up this SpatialIndex for removal.</summary>
+	virtual ~SpatialIndex() {}
+
+	/// <summary>Brings this SpatialIndex up-to-date with the *current* positions of a given list of agents.</summary>
+	/// <remarks>This method is not thread-safe, and it should not be called while queries are being performed.</remarks>
+	/// <param name="agents">The list of all agents that are currently in the simulation.</param>
+	/// <param name="ghosts">A list of ghost copies of agents, which should be stored at the agent's position plus the entry's offset.</param>
+	virtual void Update(const std::vector<Agent*>& agents, const std::vector<Entry>& ghosts) = 0;
+
+	/// <summary>Brings this SpatialIndex up-to-date with the *current* positions of a given list of agents, without any ghost copies.</summary>
+	/// <param name="agents">The list of all agents that are currently in the simulation.</param>
+	void Update(const std::vector<Agent*>& agents) { Update(agents, std::vector<Entry>()); }
+
+	/// <summary>Computes a list of all agents (and ghost copies of agents) that lie within a given radius of a given position.</summary>
+	/// <remarks>Implementations of this method must be thread-safe, so that multiple agents can perform queries in parallel.
+	/// The results contain pointers to the agents themselves, so the caller does not need to look up agents by their IDs.</remarks>
+	/// <param name="position">A query position.</param>
+	/// <param name="radius">A query radius.</param>
+	/// <param name="agentToIgnore">A pointer to the Agent object that should be excluded from the results (including its ghost copies).
+	/// This is most likely the agent for which the query is being performed.
+	/// Use nullptr to not exclude any agents.</param>
+	/// <param name="result">[out] Will store all entries that lie within "radius" meters of "position", sorted by increasing distance, 
+	/// excluding the agent denoted by "agentToIgnore" (if it exists).</param>
+	virtual void FindAllAgentsInRange(const Vector2D& position, const float radius, const Agent* agentToIgnore, std::vector<Entry>& result) const = 0;
+};
+
+#endif //LIB_SPATIALINDEX_H
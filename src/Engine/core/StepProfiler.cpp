@@ -0,0 +1,318 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#include <core/StepProfiler.h>
+#include <core/costFunction.h>
+#include <core/ThreadPool.h>
+#include <algorithm>
+#include <iomanip>
+
+/// <summary>The number of cost-function timers that are currently active on this thread.</summary>
+static thread_local int nrActiveCostFunctionTimers = 0;
+
+std::string StepProfiler::PhaseToString(Phase phase)
+{
+	switch (phase)
+	{
+	case INSERTION: return "insertion";
+	case SPATIAL_INDEX: return "spatial index";
+	case NEIGHBOR_SEARCH: return "neighbor search";
+	case SPH_DENSITY: return "SPH density";
+	case ACCELERATION: return "acceleration";
+	case CONTACT_FORCES: return "contact forces";
+	case INTEGRATION: return "integration";
+	case REMOVAL: return "removal";
+	default: return "unknown";
+	}
+}
+
+StepProfiler::StepProfiler()
+{
+	Reset();
+}
+
+void StepProfiler::Reset()
+{
+	threadData_.clear();
+	threadData_.resize(1);
+	std::fill(phaseMilliseconds_, phaseMilliseconds_ + NR_PHASES, 0.0);
+	std::fill(fusedInto_, fusedInto_ + NR_PHASES, NR_PHASES);
+	nrSteps_ = 0;
+	currentPhase_ = NR_PHASES;
+}
+
+#pragma region [Recording]
+
+void StepProfiler::StartPhase(Phase phase, int nrThreads)
+{
+	const auto& now = HelperFunctions::GetCurrentTime();
+
+	if (currentPhase_ == NR_PHASES)
+	{
+		// a new step begins; make sure that all threads can store their data
+		if (threadData_.size() < (size_t)nrThreads)
+			threadData_.resize(nrThreads);
+	}
+	else
+		phaseMilliseconds_[currentPhase_] += HelperFunctions::GetIntervalMilliseconds(phaseStartTime_, now);
+
+	currentPhase_ = phase;
+	phaseStartTime_ = now;
+}
+
+void StepProfiler::EndStep()
+{
+	if (currentPhase_ == NR_PHASES)
+		return;
+
+	phaseMilliseconds_[currentPhase_] += HelperFunctions::GetIntervalMilliseconds(phaseStartTime_, HelperFunctions::GetCurrentTime());
+	currentPhase_ = NR_PHASES;
+	++nrSteps_;
+}
+
+void StepProfiler::SetFusedPhase(Phase phase, Phase leadingPhase)
+{
+	fusedInto_[phase] = leadingPhase;
+}
+
+StepProfiler::ThreadData* StepProfiler::getThreadData()
+{
+	const size_t thread = (size_t)ThreadPool::GetCurrentThreadIndex();
+	return thread < threadData_.size() ? &threadData_[thread] : nullptr;
+}
+
+void StepProfiler::AddThreadTime(Phase phase, double milliseconds)
+{
+	ThreadData* data = getThreadData();
+	if (data != nullptr)
+		data->phaseMilliseconds[phase] += milliseconds;
+}
+
+void StepProfiler::AddNeighborQuery(size_t nrNeighborsFound)
+{
+	ThreadData* data = getThreadData();
+	if (data != nullptr)
+	{
+		++data->nrNeighborQueries;
+		data->nrNeighborsFound += nrNeighborsFound;
+	}
+}
+
+void StepProfiler::AddCostFunctionCall(const CostFunction* costFunction, double milliseconds, size_t nrCostEvaluations)
+{
+	ThreadData* data = getThreadData();
+	if (data == nullptr)
+		return;
+
+	data->nrCostEvaluations += nrCostEvaluations;
+
+	auto& statistics = data->costFunctions[costFunction];
+	statistics.milliseconds += milliseconds;
+	++statistics.nrCalls;
+	statistics.nrCostEvaluations += nrCostEvaluations;
+}
+
+void StepProfiler::SetCostFunctionLabel(const CostFunction* costFunction, const std::string& label)
+{
+	costFunctionLabels_[costFunction] = label;
+}
+
+StepProfiler::ThreadTimer::ThreadTimer(StepProfiler* profiler, Phase phase) : profiler_(profiler), phase_(phase)
+{
+	if (profiler_ != nullptr)
+		startTime_ = HelperFunctions::GetCurrentTime();
+}
+
+StepProfiler::ThreadTimer::~ThreadTimer()
+{
+	if (profiler_ != nullptr)
+		profiler_->AddThreadTime(phase_, HelperFunctions::GetIntervalMilliseconds(startTime_, HelperFunctions::GetCurrentTime()));
+}
+
+StepProfiler::CostFunctionTimer::CostFunctionTimer(StepProfiler* profiler, const CostFunction* costFunction, size_t nrCostEvaluations)
+	: profiler_(profiler), costFunction_(costFunction), nrCostEvaluations_(nrCostEvaluations), isOutermost_(false)
+{
+	if (profiler_ == nullptr)
+		return;
+
+	isOutermost_ = (nrActiveCostFunctionTimers == 0);
+	++nrActiveCostFunctionTimers;
+	if (isOutermost_)
+		startTime_ = HelperFunctions::GetCurrentTime();
+}
+
+StepProfiler::CostFunctionTimer::~CostFunctionTimer()
+{
+	if (profiler_ == nullptr)
+		return;
+
+	--nrActiveCostFunctionTimers;
+	const double milliseconds = isOutermost_ ? HelperFunctions::GetIntervalMilliseconds(startTime_, HelperFunctions::GetCurrentTime()) : 0;
+	profiler_->AddCostFunctionCall(costFunction_, milliseconds, nrCostEvaluations_);
+}
+
+#pragma endregion
+
+#pragma region [Results]
+
+double StepProfiler::GetTotalMilliseconds() const
+{
+	double total = 0;
+	for (int phase = 0; phase < NR_PHASES; ++phase)
+		total += phaseMilliseconds_[phase];
+	return total;
+}
+
+double StepProfiler::GetThreadMilliseconds(Phase phase, size_t thread) const
+{
+	return thread < threadData_.size() ? threadData_[thread].phaseMilliseconds[phase] : 0;
+}
+
+size_t StepProfiler::GetNumberOfNeighborQueries() const
+{
+	size_t total = 0;
+	for (const ThreadData& data : threadData_)
+		total += data.nrNeighborQueries;
+	return total;
+}
+
+size_t StepProfiler::GetNumberOfNeighborsFound() const
+{
+	size_t total = 0;
+	for (const ThreadData& data : threadData_)
+		total += data.nrNeighborsFound;
+	return total;
+}
+
+size_t StepProfiler::GetNumberOfCostEvaluations() const
+{
+	size_t total = 0;
+	for (const ThreadData& data : threadData_)
+		total += data.nrCostEvaluations;
+	return total;
+}
+
+std::vector<StepProfiler::CostFunctionStatistics> StepProfiler::GetCostFunctionStatistics() const
+{
+	// combine the data of all threads
+	std::unordered_map<const CostFunction*, CostFunctionStatistics> combined;
+	for (const ThreadData& data : threadData_)
+	{
+		for (const auto& entry : data.costFunctions)
+		{
+			auto& statistics = combined[entry.first];
+			statistics.milliseconds += entry.second.milliseconds;
+			statistics.nrCalls += entry.second.nrCalls;
+			statistics.nrCostEvaluations += entry.second.nrCostEvaluations;
+		}
+	}
+
+	std::vector<CostFunctionStatistics> result;
+	result.reserve(combined.size());
+	for (auto& entry : combined)
+	{
+		// use the registered label, or the type of the cost function
+		const auto& label = costFunctionLabels_.find(entry.first);
+		entry.second.label = (label != costFunctionLabels_.end() ? label->second : entry.first->GetTypeName());
+		result.push_back(entry.second);
+	}
+
+	std::sort(result.begin(), result.end(), [](const CostFunctionStatistics& a, const CostFunctionStatistics& b)
+	{
+		return a.milliseconds > b.milliseconds || (a.milliseconds == b.milliseconds && a.label < b.label);
+	});
+
+	return result;
+}
+
+void StepProfiler::WriteReport(std::ostream& stream) const
+{
+	const double total = GetTotalMilliseconds();
+	const size_t nrThreads = threadData_.size();
+
+	stream << std::fixed << std::setprecision(2);
+	stream << "Profile of " << nrSteps_ << " simulation steps (" << nrThreads << (nrThreads == 1 ? " thread)" : " threads)") << std::endl << std::endl;
+
+	// - time per phase, and the working time of each thread in that phase
+	stream << std::left << std::setw(18) << "Phase" << std::right << std::setw(12) << "Time (ms)" << std::setw(9) << "Share";
+	for (size_t thread = 0; thread < nrThreads; ++thread)
+		stream << std::setw(12) << ("Thread " + std::to_string(thread));
+	stream << std::endl;
+
+	//   (a phase that runs in the same loop as the phase above it is shown as part of that phase, without a wall-clock time of its own)
+	bool hasFusedPhases = false;
+	for (int phase = 0; phase < NR_PHASES; ++phase)
+	{
+		if (fusedInto_[phase] != NR_PHASES)
+		{
+			hasFusedPhases = true;
+			stream << std::left << std::setw(18) << (" + " + PhaseToString((Phase)phase)) << std::right
+				<< std::setw(12) << "-" << std::setw(9) << "-";
+		}
+		else
+		{
+			stream << std::left << std::setw(18) << PhaseToString((Phase)phase) << std::right
+				<< std::setw(12) << phaseMilliseconds_[phase]
+				<< std::setw(8) << (total > 0 ? 100 * phaseMilliseconds_[phase] / total : 0) << "%";
+		}
+		for (size_t thread = 0; thread < nrThreads; ++thread)
+			stream << std::setw(12) << threadData_[thread].phaseMilliseconds[phase];
+		stream << std::endl;
+	}
+	stream << std::left << std::setw(18) << "total" << std::right << std::setw(12) << total << std::endl;
+	if (hasFusedPhases)
+		stream << "(Phases marked with + run in the same parallel loop as the phase above them; its time includes theirs.)" << std::endl;
+	stream << std::endl;
+
+	// - counters
+	const size_t nrQueries = GetNumberOfNeighborQueries();
+	const size_t nrNeighbors = GetNumberOfNeighborsFound();
+	stream << "Neighbor queries: " << nrQueries << " (" << nrNeighbors << " agents found, " 
+		<< (nrQueries > 0 ? (double)nrNeighbors / nrQueries : 0) << " per query)" << std::endl;
+	stream << "Cost evaluations: " << GetNumberOfCostEvaluations() << std::endl << std::endl;
+
+	// - time per cost function
+	const auto& costFunctions = GetCostFunctionStatistics();
+	if (!costFunctions.empty())
+	{
+		stream << "Cost functions (time summed over all threads):" << std::endl;
+		stream << std::left << std::setw(40) << "Cost function" << std::right 
+			<< std::setw(12) << "Time (ms)" << std::setw(12) << "Calls" << std::setw(14) << "Evaluations" << std::endl;
+		for (const auto& statistics : costFunctions)
+		{
+			stream << std::left << std::setw(40) << statistics.label << std::right
+				<< std::setw(12) << statistics.milliseconds 
+				<< std::setw(12) << statistics.nrCalls 
+				<< std::setw(14) << statistics.nrCostEvaluations << std::endl;
+		}
+	}
+
+	stream << std::defaultfloat;
+}
+
+#pragma endregion
@@ -0,0 +1,249 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#ifndef LIB_STEP_PROFILER_H
+#define LIB_STEP_PROFILER_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <iostream>
+#include <tools/HelperFunctions.h>
+
+class CostFunction;
+
+/// <summary>Collects timing information and counters about the simulation steps of a WorldBase.</summary>
+/// <remarks>A WorldBase only uses a StepProfiler if profiling has been enabled (see WorldBase::SetProfilingEnabled()).
+/// The profiler measures the wall-clock time of each phase of WorldBase::DoStep(), 
+/// the time that each thread spends working in each phase (to reveal load imbalance),
+/// the time spent in each cost function (summed over all threads), 
+/// and the number of neighbor queries, neighbors found, and cost evaluations.
+/// Some phases run in the same parallel loop (e.g. neighbor search and SPH density); 
+/// their wall-clock time is counted for the first phase of that loop, but their thread times are measured separately.
+/// The report shows such phases as part of the row of the first phase.
+/// All results are accumulated until Reset() is called.</remarks>
+class StepProfiler
+{
+public:
+	/// <summary>The phases of a simulation step, in the order in which WorldBase::DoStep() performs them.</summary>
+	enum Phase
+	{
+		/// <summary>Inserting agents that were scheduled for the current time.</summary>
+		INSERTION,
+		/// <summary>Rebuilding the spatial index of agents and the hierarchy of obstacle edges (and sorting the agents by position, if enabled).</summary>
+		SPATIAL_INDEX,
+		/// <summary>Computing the neighbors of each agent.</summary>
+		NEIGHBOR_SEARCH,
+		/// <summary>Computing the SPH density of each agent.</summary>
+		SPH_DENSITY,
+		/// <summary>Computing the acceleration of each agent via its policy.</summary>
+		ACCELERATION,
+		/// <summary>Computing the contact forces of each agent.</summary>
+		CONTACT_FORCES,
+		/// <summary>Updating the velocity and position of each agent.</summary>
+		INTEGRATION,
+		/// <summary>Removing agents that have reached their goal.</summary>
+		REMOVAL,
+		NR_PHASES
+	};
+
+	/// <summary>Returns a readable name for the given phase.</summary>
+	static std::string PhaseToString(Phase phase);
+
+	/// <summary>Timing information about a single cost function.</summary>
+	struct CostFunctionStatistics
+	{
+		/// <summary>A readable description of the cost function.</summary>
+		std::string label;
+		/// <summary>The total time (in milliseconds) spent in this cost function, summed over all threads.</summary>
+		double milliseconds = 0;
+		/// <summary>The number of times that the cost function has been called by a policy.</summary>
+		size_t nrCalls = 0;
+		/// <summary>The number of velocities whose cost has been requested from the cost function.</summary>
+		size_t nrCostEvaluations = 0;
+	};
+
+	/// <summary>Measures the time that the current thread spends in a phase, from construction until destruction.</summary>
+	/// <remarks>Does nothing if the given profiler is nullptr.</remarks>
+	class ThreadTimer
+	{
+	private:
+		StepProfiler* profiler_;
+		Phase phase_;
+		HelperFunctions::Timestamp startTime_;
+	public:
+		ThreadTimer(StepProfiler* profiler, Phase phase);
+		~ThreadTimer();
+	};
+
+	/// <summary>Measures the time of a single call to a cost function, from construction until destruction.</summary>
+	/// <remarks>Does nothing if the given profiler is nullptr. 
+	/// If a cost function calls another cost function (or itself) while a timer is active on the same thread, 
+	/// only the outermost timer records time, so that no time is counted twice.</remarks>
+	class CostFunctionTimer
+	{
+	private:
+		StepProfiler* profiler_;
+		const CostFunction* costFunction_;
+		size_t nrCostEvaluations_;
+		bool isOutermost_;
+		HelperFunctions::Timestamp startTime_;
+	public:
+		/// <param name="profiler">The profiler to send the results to, or nullptr.</param>
+		/// <param name="costFunction">The cost function that is being called.</param>
+		/// <param name="nrCostEvaluations">The number of velocities that the call evaluates (0 for e.g. gradients).</param>
+		CostFunctionTimer(StepProfiler* profiler, const CostFunction* costFunction, size_t nrCostEvaluations);
+		~CostFunctionTimer();
+	};
+
+private:
+	/// <summary>The data that a single thread collects. Each thread writes only to its own instance.</summary>
+	struct alignas(64) ThreadData
+	{
+		double phaseMilliseconds[NR_PHASES] = {};
+		size_t nrNeighborQueries = 0;
+		size_t nrNeighborsFound = 0;
+		size_t nrCostEvaluations = 0;
+		std::unordered_map<const CostFunction*, CostFunctionStatistics> costFunctions;
+	};
+
+	/// <summary>The data of each thread, indexed by the thread index of the world's ThreadPool (see ThreadPool::GetCurrentThreadIndex()).</summary>
+	std::vector<ThreadData> threadData_;
+
+	/// <summary>The wall-clock time (in milliseconds) spent in each phase.</summary>
+	double phaseMilliseconds_[NR_PHASES];
+	/// <summary>For each phase, the phase whose wall-clock time includes it (see SetFusedPhase()), or NR_PHASES if it is measured by itself.</summary>
+	Phase fusedInto_[NR_PHASES];
+	/// <summary>The number of simulation steps that have been profiled.</summary>
+	size_t nrSteps_;
+
+	/// <summary>The phase that is currently being measured, or NR_PHASES if no step is in progress.</summary>
+	Phase currentPhase_;
+	/// <summary>The time at which the current phase started.</summary>
+	HelperFunctions::Timestamp phaseStartTime_;
+
+	/// <summary>Readable descriptions of cost functions, to be used in reports.</summary>
+	std::unordered_map<const CostFunction*, std::string> costFunctionLabels_;
+
+public:
+	/// <summary>Creates a StepProfiler with all measurements set to zero.</summary>
+	StepProfiler();
+
+	/// <summary>Sets all measurements back to zero.</summary>
+	void Reset();
+
+#pragma region [Recording]
+	/// @name Recording
+	/// Methods that are called by the simulation to record measurements.
+	/// @{
+
+	/// <summary>Marks the start of a phase of the current simulation step, and the end of the previous phase (if any).</summary>
+	/// <remarks>This method should only be called from outside parallel regions.</remarks>
+	/// <param name="phase">The phase that starts. StepProfiler::INSERTION marks the start of a new step.</param>
+	/// <param name="nrThreads">The number of threads that the simulation uses; at the start of a step, the profiler makes sure that all of them can store their data.</param>
+	void StartPhase(Phase phase, int nrThreads);
+
+	/// <summary>Marks the end of the current simulation step.</summary>
+	/// <remarks>This method should only be called from outside parallel regions.</remarks>
+	void EndStep();
+
+	/// <summary>Marks a phase as running in the same parallel loop as another phase, which receives the wall-clock time of the loop.</summary>
+	/// <remarks>This method should only be called from outside parallel regions.</remarks>
+	/// <param name="phase">A phase that does not receive wall-clock time of its own.</param>
+	/// <param name="leadingPhase">The first phase of the loop, whose wall-clock time includes that of the given phase.</param>
+	void SetFusedPhase(Phase phase, Phase leadingPhase);
+
+	/// <summary>Adds time that the current thread has spent working in a phase.</summary>
+	void AddThreadTime(Phase phase, double milliseconds);
+
+	/// <summary>Registers a query in the spatial index of agents, performed by the current thread.</summary>
+	/// <param name="nrNeighborsFound">The number of agents that the query has returned.</param>
+	void AddNeighborQuery(size_t nrNeighborsFound);
+
+	/// <summary>Adds the results of a call to a cost function, performed by the current thread.</summary>
+	void AddCostFunctionCall(const CostFunction* costFunction, double milliseconds, size_t nrCostEvaluations);
+
+	/// <summary>Sets the description of a cost function that will be used in reports.</summary>
+	/// <remarks>This method should only be called from outside parallel regions.</remarks>
+	void SetCostFunctionLabel(const CostFunction* costFunction, const std::string& label);
+
+	/// @}
+#pragma endregion
+
+#pragma region [Results]
+	/// @name Results
+	/// Methods that return the measurements so far.
+	/// @{
+
+	/// <summary>Returns the number of simulation steps that have been profiled.</summary>
+	inline size_t GetNumberOfSteps() const { return nrSteps_; }
+
+	/// <summary>Returns the total wall-clock time (in milliseconds) spent in the given phase.</summary>
+	/// <remarks>For a phase that runs in the same loop as another phase (see GetLeadingPhase()), this is 0, 
+	/// because the time of the loop is counted for the other phase.</remarks>
+	inline double GetPhaseMilliseconds(Phase phase) const { return phaseMilliseconds_[phase]; }
+
+	/// <summary>Returns the phase whose wall-clock time includes that of the given phase.</summary>
+	/// <returns>The first phase of the parallel loop in which the given phase runs, or the given phase itself if it runs in a loop of its own.</returns>
+	inline Phase GetLeadingPhase(Phase phase) const { return fusedInto_[phase] == NR_PHASES ? phase : fusedInto_[phase]; }
+
+	/// <summary>Returns the total wall-clock time (in milliseconds) of all profiled simulation steps.</summary>
+	double GetTotalMilliseconds() const;
+
+	/// <summary>Returns the number of threads for which data has been recorded.</summary>
+	inline size_t GetNumberOfThreads() const { return threadData_.size(); }
+
+	/// <summary>Returns the time (in milliseconds) that a specific thread has spent working in the given phase.</summary>
+	/// <remarks>This time is only measured for the parts of a phase that run in parallel over all agents. 
+	/// The difference between the threads shows how well the work is balanced.</remarks>
+	double GetThreadMilliseconds(Phase phase, size_t thread) const;
+
+	/// <summary>Returns the total number of queries in the spatial index of agents.</summary>
+	size_t GetNumberOfNeighborQueries() const;
+
+	/// <summary>Returns the total number of agents returned by all queries in the spatial index of agents.</summary>
+	size_t GetNumberOfNeighborsFound() const;
+
+	/// <summary>Returns the total number of velocities whose cost has been requested from any cost function.</summary>
+	size_t GetNumberOfCostEvaluations() const;
+
+	/// <summary>Returns timing information for each cost function that has been used, sorted by decreasing time.</summary>
+	std::vector<CostFunctionStatistics> GetCostFunctionStatistics() const;
+
+	/// <summary>Writes a readable summary of all measurements to the given stream.</summary>
+	void WriteReport(std::ostream& stream) const;
+
+	/// @}
+#pragma endregion
+
+private:
+	/// <summary>Returns the data of the calling thread, or nullptr if that thread has no data (yet).</summary>
+	ThreadData* getThreadData();
+};
+
+#endif //LIB_STEP_PROFILER_H
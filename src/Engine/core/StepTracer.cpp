@@ -0,0 +1,165 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#include <core/StepTracer.h>
+#include <core/ThreadPool.h>
+#include <iomanip>
+
+StepTracer::StepTracer()
+{
+	threadData_.resize(1);
+
+	for (int phase = 0; phase < StepProfiler::NR_PHASES; ++phase)
+		names_.push_back(StepProfiler::PhaseToString((StepProfiler::Phase)phase));
+	names_.push_back("step");
+	names_.push_back("write output");
+	names_.push_back("flush output");
+
+	startTime_ = HelperFunctions::GetCurrentTime();
+}
+
+void StepTracer::SetPolicyName(const Policy* policy, const std::string& name)
+{
+	policyNameIDs_[policy] = (int)names_.size();
+	names_.push_back(name);
+}
+
+void StepTracer::PrepareThreads(int nrThreads)
+{
+	if (threadData_.size() < (size_t)nrThreads)
+		threadData_.resize(nrThreads);
+}
+
+StepTracer::ThreadData* StepTracer::getThreadData()
+{
+	const size_t thread = (size_t)ThreadPool::GetCurrentThreadIndex();
+	return thread < threadData_.size() ? &threadData_[thread] : nullptr;
+}
+
+double StepTracer::getCurrentTime() const
+{
+	return 1000.0 * HelperFunctions::GetIntervalMilliseconds(startTime_, HelperFunctions::GetCurrentTime());
+}
+
+void StepTracer::BeginEvent(int nameID)
+{
+	ThreadData* data = getThreadData();
+	if (data == nullptr)
+		return;
+
+	const double now = getCurrentTime();
+	data->openEvents.push_back(data->events.size());
+	data->events.push_back({ nameID, now, now });
+}
+
+void StepTracer::EndEvent()
+{
+	ThreadData* data = getThreadData();
+	if (data == nullptr || data->openEvents.empty())
+		return;
+
+	data->events[data->openEvents.back()].end = getCurrentTime();
+	data->openEvents.pop_back();
+}
+
+void StepTracer::SwitchPolicyRun(const Policy* policy)
+{
+	ThreadData* data = getThreadData();
+	if (data == nullptr || (data->currentPolicy == policy && policy != nullptr))
+		return;
+
+	EndPolicyRun();
+
+	const auto& nameID = policyNameIDs_.find(policy);
+	BeginEvent(nameID != policyNameIDs_.end() ? nameID->second : StepProfiler::ACCELERATION);
+	data->currentPolicy = policy;
+}
+
+void StepTracer::EndPolicyRun()
+{
+	ThreadData* data = getThreadData();
+	if (data == nullptr || data->currentPolicy == nullptr)
+		return;
+
+	EndEvent();
+	data->currentPolicy = nullptr;
+}
+
+StepTracer::Scope::Scope(StepTracer* tracer, int nameID) : tracer_(tracer)
+{
+	if (tracer_ != nullptr)
+		tracer_->BeginEvent(nameID);
+}
+
+StepTracer::Scope::~Scope()
+{
+	if (tracer_ != nullptr)
+		tracer_->EndEvent();
+}
+
+/// <summary>Writes a string as a JSON string literal.</summary>
+static void writeJSONString(std::ostream& stream, const std::string& str)
+{
+	stream << '"';
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+			stream << '\\';
+		stream << c;
+	}
+	stream << '"';
+}
+
+void StepTracer::WriteJSON(std::ostream& stream) const
+{
+	stream << std::fixed << std::setprecision(3);
+	stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+
+	bool first = true;
+	for (size_t thread = 0; thread < threadData_.size(); ++thread)
+	{
+		// give each thread a readable name
+		if (!first)
+			stream << "," << std::endl;
+		first = false;
+		stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread 
+			<< ",\"args\":{\"name\":\"Thread " << thread << "\"}}";
+
+		// write all events of this thread as "complete" events
+		for (const Event& event : threadData_[thread].events)
+		{
+			stream << "," << std::endl << "{\"name\":";
+			writeJSONString(stream, names_[event.nameID]);
+			stream << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+				<< ",\"ts\":" << event.begin << ",\"dur\":" << (event.end - event.begin) << "}";
+		}
+	}
+
+	stream << std::endl << "]}" << std::endl;
+	stream << std::defaultfloat;
+}
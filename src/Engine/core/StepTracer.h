@@ -0,0 +1,147 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#ifndef LIB_STEP_TRACER_H
+#define LIB_STEP_TRACER_H
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <iostream>
+#include <core/StepProfiler.h>
+#include <tools/HelperFunctions.h>
+
+class Policy;
+
+/// <summary>Records a timeline of the simulation, per thread, and writes it as a Chrome trace (JSON) file.</summary>
+/// <remarks>A WorldBase only uses a StepTracer if tracing has been enabled (see WorldBase::SetTracingEnabled()).
+/// The main thread records one event per phase of each simulation step (see StepProfiler::Phase) and for writing output; 
+/// phases that run in the same parallel loop share one event, named after the first of them.
+/// Inside each parallel loop over agents, each thread records one event for each chunk of agents that it handles, 
+/// and for each phase that the loop runs (see WorldBase::forAllAgentsFused());
+/// during the acceleration phase, this chunk is further split into runs of agents that use the same policy.
+/// The gaps between the chunks of subsequent loops show how long threads wait for each other.
+/// 
+/// The resulting file can be opened in chrome://tracing or in the Perfetto UI (https://ui.perfetto.dev).
+/// All events are kept in memory until WriteJSON() is called.</remarks>
+class StepTracer
+{
+public:
+	/// <summary>The IDs of the event names that exist in every trace. Each StepProfiler::Phase is also a valid name ID.</summary>
+	enum NameID
+	{
+		/// <summary>A complete simulation step.</summary>
+		STEP = StepProfiler::NR_PHASES,
+		/// <summary>Storing the trajectory data of a simulation step.</summary>
+		WRITE_OUTPUT,
+		/// <summary>Writing all trajectory data to files.</summary>
+		FLUSH_OUTPUT,
+		NR_FIXED_NAMES
+	};
+
+	/// <summary>Records an event on the current thread, from construction until destruction.</summary>
+	/// <remarks>Does nothing if the given tracer is nullptr.</remarks>
+	class Scope
+	{
+	private:
+		StepTracer* tracer_;
+	public:
+		Scope(StepTracer* tracer, int nameID);
+		~Scope();
+	};
+
+private:
+	/// <summary>A single event in the timeline.</summary>
+	struct Event
+	{
+		int nameID;
+		/// <summary>The start and end of the event, in microseconds since the tracer was created.</summary>
+		double begin, end;
+	};
+
+	/// <summary>The data that a single thread collects. Each thread writes only to its own instance.</summary>
+	struct alignas(64) ThreadData
+	{
+		std::vector<Event> events;
+		/// <summary>The indices (in the events list) of the events that have started but not yet ended.</summary>
+		std::vector<size_t> openEvents;
+		/// <summary>The policy of the current run of agents, or nullptr if no run is open.</summary>
+		const Policy* currentPolicy = nullptr;
+	};
+
+	/// <summary>The data of each thread, indexed by the thread index of the world's ThreadPool (see ThreadPool::GetCurrentThreadIndex()).</summary>
+	std::vector<ThreadData> threadData_;
+
+	/// <summary>The names of all events, indexed by name ID.</summary>
+	std::vector<std::string> names_;
+
+	/// <summary>For each registered policy, the name ID of its runs in the acceleration phase.</summary>
+	std::unordered_map<const Policy*, int> policyNameIDs_;
+
+	/// <summary>The moment at which this tracer was created; all times are relative to it.</summary>
+	HelperFunctions::Timestamp startTime_;
+
+public:
+	/// <summary>Creates an empty StepTracer.</summary>
+	StepTracer();
+
+	/// <summary>Gives a readable name to the runs of agents that use a given policy.</summary>
+	/// <remarks>This method should only be called from outside parallel regions. 
+	/// Runs of agents whose policy has no name are shown as the acceleration phase itself.</remarks>
+	void SetPolicyName(const Policy* policy, const std::string& name);
+
+	/// <summary>Makes sure that all threads can record events. Call this before each parallel region.</summary>
+	/// <param name="nrThreads">The number of threads that the simulation uses.</param>
+	void PrepareThreads(int nrThreads);
+
+	/// <summary>Starts an event on the current thread. Events on the same thread should be nested properly.</summary>
+	/// <param name="nameID">The name ID of the event, e.g. a StepProfiler::Phase or a value of NameID.</param>
+	void BeginEvent(int nameID);
+
+	/// <summary>Ends the most recently started event on the current thread.</summary>
+	void EndEvent();
+
+	/// <summary>Lets the current thread start a new run of agents if the given policy differs from that of the current run.</summary>
+	/// <remarks>The last run is closed by EndPolicyRun(), which should be called before the enclosing event ends.</remarks>
+	void SwitchPolicyRun(const Policy* policy);
+
+	/// <summary>Ends the current run of agents on the current thread, if any.</summary>
+	void EndPolicyRun();
+
+	/// <summary>Writes all events in the Chrome trace format (JSON) to the given stream.</summary>
+	void WriteJSON(std::ostream& stream) const;
+
+private:
+	/// <summary>Returns the data of the calling thread, or nullptr if that thread has no data (yet).</summary>
+	ThreadData* getThreadData();
+
+	/// <summary>Returns the number of microseconds since this tracer was created.</summary>
+	double getCurrentTime() const;
+};
+
+#endif //LIB_STEP_TRACER_H
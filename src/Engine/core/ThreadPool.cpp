@@ -0,0 +1,246 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#include <core/ThreadPool.h>
+#include <algorithm>
+
+#ifdef UMANS_USE_OPENMP_SCHEDULER
+#include <omp.h>
+#endif
+
+/// <summary>The pool whose loop the current thread is running, if any.</summary>
+static thread_local const ThreadPool* currentPool = nullptr;
+/// <summary>The index of the current thread in the loop that it is running.</summary>
+static thread_local int currentThreadIndex = 0;
+
+/// <summary>The number of chunks into which the range of each thread is split.
+/// More chunks give a better balance at the end of a loop, at the cost of more synchronization.</summary>
+static const size_t NR_CHUNKS_PER_THREAD = 32;
+
+ThreadPool::ThreadPool(int nrThreads)
+	: nrThreads_(0), ranges_(nullptr), grainSize_(1), loopFunction_(nullptr), loopData_(nullptr), 
+	loopCounter_(0), nrBusyThreads_(0), stopping_(false)
+{
+	SetNumberOfThreads(nrThreads);
+}
+
+ThreadPool::~ThreadPool()
+{
+	stopThreads();
+	delete[] ranges_;
+}
+
+void ThreadPool::SetNumberOfThreads(int nrThreads)
+{
+	nrThreads = std::max(nrThreads, 1);
+	if (nrThreads == nrThreads_)
+		return;
+
+	stopThreads();
+	delete[] ranges_;
+
+	nrThreads_ = nrThreads;
+	ranges_ = new WorkRange[nrThreads_];
+	startThreads();
+}
+
+int ThreadPool::GetCurrentThreadIndex()
+{
+	return currentThreadIndex;
+}
+
+#pragma region [Background threads]
+
+void ThreadPool::startThreads()
+{
+#ifndef UMANS_USE_OPENMP_SCHEDULER
+	stopping_ = false;
+	for (int thread = 1; thread < nrThreads_; ++thread)
+		threads_.emplace_back(&ThreadPool::run, this, thread, loopCounter_);
+#endif
+}
+
+void ThreadPool::stopThreads()
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		stopping_ = true;
+	}
+	loopStarted_.notify_all();
+
+	for (auto& thread : threads_)
+		thread.join();
+	threads_.clear();
+}
+
+void ThreadPool::run(int thread, size_t loopCounter)
+{
+	std::unique_lock<std::mutex> lock(mtx_);
+	while (true)
+	{
+		loopStarted_.wait(lock, [this, loopCounter]() { return stopping_ || loopCounter_ != loopCounter; });
+		if (stopping_)
+			return;
+
+		loopCounter = loopCounter_;
+		const ThreadFunction function = loopFunction_;
+		const void* data = loopData_;
+
+		lock.unlock();
+		runThread(thread, function, data);
+		lock.lock();
+
+		if (--nrBusyThreads_ == 0)
+			loopFinished_.notify_one();
+	}
+}
+
+#pragma endregion
+
+#pragma region [Loops]
+
+void ThreadPool::runLoop(size_t n, ThreadFunction function, const void* data)
+{
+	if (n == 0)
+		return;
+
+	// run a nested loop sequentially, on the thread that started it
+	if (currentPool == this)
+	{
+		Chunks chunks(nullptr, currentThreadIndex, 0, n);
+		function(data, chunks);
+		return;
+	}
+
+	// run the loop sequentially (as thread 0) if there is only one thread or one index
+	if (nrThreads_ == 1 || n == 1)
+	{
+		const ThreadPool* previousPool = currentPool;
+		const int previousThreadIndex = currentThreadIndex;
+		currentPool = this;
+		currentThreadIndex = 0;
+
+		Chunks chunks(nullptr, 0, 0, n);
+		function(data, chunks);
+
+		currentPool = previousPool;
+		currentThreadIndex = previousThreadIndex;
+		return;
+	}
+
+	// divide the indices evenly over all threads
+	grainSize_ = std::max(n / (nrThreads_ * NR_CHUNKS_PER_THREAD), (size_t)1);
+	for (int thread = 0; thread < nrThreads_; ++thread)
+	{
+		ranges_[thread].begin = n * thread / nrThreads_;
+		ranges_[thread].end = n * (thread + 1) / nrThreads_;
+	}
+
+#ifdef UMANS_USE_OPENMP_SCHEDULER
+#pragma omp parallel num_threads(nrThreads_)
+	runThread(omp_get_thread_num(), function, data);
+#else
+	// wake up the background threads, and do the work of thread 0 on this thread
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		loopFunction_ = function;
+		loopData_ = data;
+		nrBusyThreads_ = nrThreads_ - 1;
+		++loopCounter_;
+	}
+	loopStarted_.notify_all();
+
+	runThread(0, function, data);
+
+	std::unique_lock<std::mutex> lock(mtx_);
+	loopFinished_.wait(lock, [this]() { return nrBusyThreads_ == 0; });
+#endif
+}
+
+void ThreadPool::runThread(int thread, ThreadFunction function, const void* data)
+{
+	const ThreadPool* previousPool = currentPool;
+	const int previousThreadIndex = currentThreadIndex;
+	currentPool = this;
+	currentThreadIndex = thread;
+
+	Chunks chunks(this, thread);
+	function(data, chunks);
+
+	currentPool = previousPool;
+	currentThreadIndex = previousThreadIndex;
+}
+
+bool ThreadPool::nextChunk(int thread, size_t& begin, size_t& end)
+{
+	WorkRange& own = ranges_[thread];
+
+	// take a chunk from the front of this thread's own range
+	{
+		std::lock_guard<std::mutex> lock(own.mtx);
+		if (own.begin < own.end)
+		{
+			begin = own.begin;
+			end = std::min(begin + grainSize_, own.end);
+			own.begin = end;
+			return true;
+		}
+	}
+
+	// steal the back half of the range of another thread
+	for (int i = 1; i < nrThreads_; ++i)
+	{
+		WorkRange& victim = ranges_[(thread + i) % nrThreads_];
+		size_t stolenBegin, stolenEnd;
+		{
+			std::lock_guard<std::mutex> lock(victim.mtx);
+			const size_t remaining = victim.end - victim.begin;
+			if (remaining == 0)
+				continue;
+
+			stolenEnd = victim.end;
+			stolenBegin = remaining <= grainSize_ ? victim.begin : victim.end - remaining / 2;
+			victim.end = stolenBegin;
+		}
+
+		// handle the first chunk now, and make the rest this thread's own range
+		begin = stolenBegin;
+		end = std::min(begin + grainSize_, stolenEnd);
+		if (end < stolenEnd)
+		{
+			std::lock_guard<std::mutex> lock(own.mtx);
+			own.begin = end;
+			own.end = stolenEnd;
+		}
+		return true;
+	}
+
+	return false;
+}
+
+#pragma endregion
@@ -0,0 +1,190 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#ifndef LIB_THREAD_POOL_H
+#define LIB_THREAD_POOL_H
+
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+/// <summary>A persistent pool of threads that runs parallel loops with work stealing.</summary>
+/// <remarks>Each WorldBase owns its own ThreadPool, so the number of threads is a property of a simulation, 
+/// and not a process-wide setting like omp_set_num_threads().
+/// The thread that starts a loop takes part in it as thread 0; the other threads wait in the background until the next loop.
+/// 
+/// At the start of a loop, the range of indices is split evenly over all threads. 
+/// Each thread takes small chunks from the front of its own range; a thread that runs out of work 
+/// steals the back half of the remaining range of another thread. 
+/// This balances loops in which the cost per index varies a lot, e.g. because agents have very different numbers of neighbors.
+/// 
+/// If UMANS_USE_OPENMP_SCHEDULER is defined, the loops are run in an OpenMP parallel region (with a per-loop number of threads) 
+/// instead of the pool's own threads. The chunks and work stealing are the same in both cases.
+/// 
+/// Loops should be started from one thread at a time. A loop that is started from inside a loop of the same pool runs sequentially.</remarks>
+class ThreadPool
+{
+public:
+	class Chunks;
+
+private:
+	/// <summary>The remaining range of indices of one thread, in the current loop.</summary>
+	struct alignas(64) WorkRange
+	{
+		std::mutex mtx;
+		size_t begin = 0;
+		size_t end = 0;
+	};
+
+	/// <summary>A function that runs the body of a loop on one thread, with a pointer to the loop's data.</summary>
+	typedef void (*ThreadFunction)(const void* data, Chunks& chunks);
+
+	int nrThreads_;
+	/// <summary>The remaining range of each thread, in an array of nrThreads_ elements.</summary>
+	WorkRange* ranges_;
+	/// <summary>The number of indices that a thread takes from its own range at once.</summary>
+	size_t grainSize_;
+
+	/// <summary>The background threads (with indices 1 to nrThreads_-1). Unused if UMANS_USE_OPENMP_SCHEDULER is defined.</summary>
+	std::vector<std::thread> threads_;
+	std::mutex mtx_;
+	/// <summary>Notified when a new loop starts, or when the threads should stop.</summary>
+	std::condition_variable loopStarted_;
+	/// <summary>Notified when the last background thread has finished its part of a loop.</summary>
+	std::condition_variable loopFinished_;
+
+	/// <summary>The function and data of the current loop.</summary>
+	ThreadFunction loopFunction_;
+	const void* loopData_;
+	/// <summary>Increases by one for each loop, so that the background threads can see that a new loop has started.</summary>
+	size_t loopCounter_;
+	/// <summary>The number of background threads that are still working on the current loop.</summary>
+	int nrBusyThreads_;
+	/// <summary>Whether or not the background threads should stop.</summary>
+	bool stopping_;
+
+	/// <summary>Starts the background threads.</summary>
+	void startThreads();
+	/// <summary>Stops the background threads and waits until they have finished.</summary>
+	void stopThreads();
+	/// <summary>The main loop of a background thread.</summary>
+	/// <param name="thread">The index of this thread.</param>
+	/// <param name="loopCounter">The value of loopCounter_ when the thread was created.</param>
+	void run(int thread, size_t loopCounter);
+
+	/// <summary>Runs a loop over n indices on all threads.</summary>
+	void runLoop(size_t n, ThreadFunction function, const void* data);
+	/// <summary>Runs the part of the current loop that belongs to the given thread.</summary>
+	void runThread(int thread, ThreadFunction function, const void* data);
+
+	/// <summary>Gives the next chunk of indices to a thread, either from its own range or stolen from another thread.</summary>
+	/// <returns>true if a chunk was found; false if the loop has no more work.</returns>
+	bool nextChunk(int thread, size_t& begin, size_t& end);
+
+public:
+	/// <summary>The chunks of indices that one thread handles in a loop.</summary>
+	/// <remarks>If the loop runs sequentially, there is no pool, and all indices are given as a single chunk.</remarks>
+	class Chunks
+	{
+	private:
+		ThreadPool* pool_;
+		int thread_;
+		size_t sequentialBegin_;
+		size_t sequentialEnd_;
+	public:
+		Chunks(ThreadPool* pool, int thread, size_t sequentialBegin = 0, size_t sequentialEnd = 0) 
+			: pool_(pool), thread_(thread), sequentialBegin_(sequentialBegin), sequentialEnd_(sequentialEnd) {}
+
+		/// <summary>Gets the next chunk of indices that this thread should handle.</summary>
+		/// <param name="begin">Will store the first index of the chunk.</param>
+		/// <param name="end">Will store the index after the last index of the chunk.</param>
+		/// <returns>true if a chunk was found; false if the loop has no more work.</returns>
+		inline bool Next(size_t& begin, size_t& end)
+		{
+			if (pool_ != nullptr)
+				return pool_->nextChunk(thread_, begin, end);
+			if (sequentialBegin_ >= sequentialEnd_)
+				return false;
+			begin = sequentialBegin_;
+			end = sequentialEnd_;
+			sequentialBegin_ = sequentialEnd_;
+			return true;
+		}
+
+		/// <summary>Returns the index of the thread that handles these chunks, between 0 and the number of threads.</summary>
+		inline int GetThread() const { return thread_; }
+	};
+
+	/// <summary>Creates a ThreadPool with the given number of threads.</summary>
+	/// <param name="nrThreads">The number of threads, including the thread that will start the loops.</param>
+	ThreadPool(int nrThreads = 1);
+
+	/// <summary>Stops all threads and destroys this ThreadPool.</summary>
+	~ThreadPool();
+
+	/// <summary>Changes the number of threads of this pool.</summary>
+	/// <remarks>This should not be called during a loop. Values smaller than 1 are treated as 1.</remarks>
+	/// <param name="nrThreads">The number of threads, including the thread that will start the loops.</param>
+	void SetNumberOfThreads(int nrThreads);
+
+	/// <summary>Returns the number of threads of this pool, including the thread that starts the loops.</summary>
+	inline int GetNumberOfThreads() const { return nrThreads_; }
+
+	/// <summary>Returns the index of the calling thread in the loop that it is currently running, or 0 outside of loops.</summary>
+	/// <remarks>This can be used to store per-thread data in an array with one element per thread.</remarks>
+	static int GetCurrentThreadIndex();
+
+	/// <summary>Runs a function once on each thread of this pool, to handle the indices 0 to n-1 in chunks.</summary>
+	/// <remarks>Use this instead of ParallelFor() if each thread needs to do some work before or after its part of the loop.</remarks>
+	/// <param name="n">The number of indices in the loop.</param>
+	/// <param name="function">A function that takes a ThreadPool::Chunks& as its argument, 
+	/// and that should handle all chunks that it gets via Chunks::Next().</param>
+	template <typename Function>
+	void ParallelForEachThread(size_t n, const Function& function)
+	{
+		runLoop(n, [](const void* data, Chunks& chunks) { (*static_cast<const Function*>(data))(chunks); }, &function);
+	}
+
+	/// <summary>Calls a function for the indices 0 to n-1, in parallel.</summary>
+	/// <param name="n">The number of indices in the loop.</param>
+	/// <param name="function">A function that takes a size_t index as its argument.</param>
+	template <typename Function>
+	void ParallelFor(size_t n, const Function& function)
+	{
+		ParallelForEachThread(n, [&function](Chunks& chunks)
+		{
+			size_t begin, end;
+			while (chunks.Next(begin, end))
+				for (size_t i = begin; i < end; ++i)
+					function(i);
+		});
+	}
+};
+
+#endif //LIB_THREAD_POOL_H
@@ -30,20 +30,24 @@
 #include "tools/vector2D.h"
 #include <core/agent.h>
 #include <core/worldBase.h>
+#include <algorithm>
+#include <cassert>
 
-Agent::Agent(size_t id, const Agent::Settings& settings) :
+Agent::Agent(size_t id, const Agent::Settings& settings, AgentStateStore* states) :
 	id_(id), settings_(settings),
-	position_(0, 0),
-	velocity_(0, 0),
-	acceleration_(0, 0),
 	contact_forces_(0, 0),
-	preferred_velocity_(0, 0),
-	goal_(0, 0),
 	viewing_direction_(0, 0),
 	next_acceleration_(0, 0),
 	next_contact_forces_(0, 0),
+	neighborsRange_(0),
+	useStepNeighbors_(false),
+	candidatesRange_(0),
     density_(), density_progressive_()
 {
+	// claim a slot in the state store; all values in this slot start at zero, except the radius
+	states->Add(this);
+	states_->radii_[stateSlot_] = settings_.radius_;
+
 	// set the seed for random-number generation
 	RNGengine_.seed((unsigned int)id);
 
@@ -53,60 +57,218 @@ Agent::Agent(size_t id, const Agent::Settings& settings) :
 
 #pragma region [Simulation-loop methods]
 
-void Agent::ComputeNeighbors(WorldBase* world, Policy* policy)
+NeighborView Agent::getNeighbors() const
+{
+	return useStepNeighbors_ ? NeighborView(stepNeighbors_) : neighbors_;
+}
+
+const Agent* Agent::getNeighborAgent(const PhantomAgent& neighbor) const
+{
+	assert(neighbor.GetIndex() < states_->agents_.size());
+	return states_->agents_[neighbor.GetIndex()];
+}
+
+void Agent::ComputeNeighbors(WorldBase* world, NeighborList& result)
 {
-	
 	// get the query radius
-    float range = policy->getInteractionRange();
+	neighborsRange_ = getPolicy()->getInteractionRange();
+
+	// perform the query; the world will store the result
+	world->ComputeNeighbors(getPosition(), neighborsRange_, this, result);
+	useStepNeighbors_ = false;
+}
+
+void Agent::ComputeNeighborCandidates(WorldBase* world, float skin, NeighborList& buffer)
+{
+	candidatesRange_ = getPolicy()->getInteractionRange();
+	candidatesPosition_ = getPosition();
+
+	// perform the query with the enlarged radius, and store the agents without their (soon outdated) positions and velocities
+	buffer.first.clear();
+	buffer.second.clear();
+	world->ComputeNeighbors(candidatesPosition_, candidatesRange_ + skin, this, buffer);
+	neighborCandidates_.resize(buffer.first.size());
+	for (size_t i = 0; i < buffer.first.size(); ++i)
+	{
+		const PhantomAgent& neighbor = buffer.first[i];
+		neighborCandidates_[i] = { neighbor.GetIndex(), neighbor.GetPosition() - states_->positions_[neighbor.GetIndex()] };
+	}
+	obstacleCandidates_.assign(buffer.second.begin(), buffer.second.end());
+}
+
+void Agent::ComputeNeighborsFromCandidates(NeighborList& result)
+{
+	neighborsRange_ = getPolicy()->getInteractionRange();
+	const float rangeSquared = neighborsRange_ * neighborsRange_;
+	const Vector2D& position = getPosition();
+
+	// select the candidates that are in range now, sorted by increasing distance (like the results of a SpatialIndex);
+	// the candidates were sorted in a previous step and have hardly moved since, so an insertion sort is fast here.
+	// The data of the candidates is read directly from the (contiguous) store, instead of via the Agent objects.
+	auto& agents = result.first;
+	const size_t agentsBegin = agents.size();
+	for (const NeighborCandidate& candidate : neighborCandidates_)
+	{
+		PhantomAgent neighbor(candidate.index, states_->positions_[candidate.index] + candidate.positionOffset, 
+			states_->velocities_[candidate.index], states_->radii_[candidate.index], position);
+		if (neighbor.GetDistanceSquared() >= rangeSquared)
+			continue;
+
+		agents.push_back(neighbor);
+		for (size_t i = agents.size() - 1; i > agentsBegin && agents[i - 1].GetDistanceSquared() > agents[i].GetDistanceSquared(); --i)
+			std::swap(agents[i - 1], agents[i]);
+	}
+
+	auto& obstacles = result.second;
+	for (const LineSegment2D& segment : obstacleCandidates_)
+		if (distanceToLineSquared(position, segment.first, segment.second, true) <= rangeSquared)
+			obstacles.push_back(segment);
+
+	useStepNeighbors_ = false;
+}
 
-    // perform the query and store the result
-	neighbors_ = world->ComputeNeighbors(position_, range, this);
+bool Agent::NeedsNewNeighborCandidates(float skin) const
+{
+	const float maxDisplacement = 0.5f * skin;
+	return distanceSquared(getPosition(), candidatesPosition_) > maxDisplacement * maxDisplacement
+		|| getPolicy()->getInteractionRange() > candidatesRange_;
+}
+
+void Agent::selectNeighborsInRange(float range)
+{
+	// if the range covers the full query, no filtering is needed
+	if (range >= neighborsRange_)
+	{
+		useStepNeighbors_ = false;
+		return;
+	}
+
+	// otherwise, copy the neighbors that the query would have returned for this range
+	const float rangeSquared = range * range;
+
+	stepNeighbors_.first.clear();
+	for (const PhantomAgent& neighbor : neighbors_.first)
+	{
+		if (neighbor.GetDistanceSquared() < rangeSquared)
+			stepNeighbors_.first.push_back(neighbor);
+	}
+
+	stepNeighbors_.second.clear();
+	for (const LineSegment2D& obstacle : neighbors_.second)
+	{
+		if (distanceToLineSquared(getPosition(), obstacle.first, obstacle.second, true) <= rangeSquared)
+			stepNeighbors_.second.push_back(obstacle);
+	}
+
+	useStepNeighbors_ = true;
 }
 
 void Agent::ComputePreferredVelocity()
 {
 	if (hasReachedGoal())
-		preferred_velocity_ = Vector2D(0, 0);
+		preferredVelocity() = Vector2D(0, 0);
 
 	else
-		preferred_velocity_ = (goal_ - position_).getnormalized() * getPreferredSpeed();
+		preferredVelocity() = (getGoal() - getPosition()).getnormalized() * getPreferredSpeed();
 }
 
 void Agent::ComputeAcceleration(WorldBase* world) {
+    ComputePreferredVelocity();
+
     if (getPolicy()->getHaveSteps()) {
         next_acceleration_ = Vector2D(0, 0);
         for (auto* step : getPolicy()->getSteps()) {
-            ComputeNeighbors(world, step);
-            ComputePreferredVelocity();
+            selectNeighborsInRange(step->getInteractionRange());
             next_acceleration_ += step->ComputeAcceleration(this, world);
-		}
+        }
     } else {
-        ComputeNeighbors(world, getPolicy());
-        ComputePreferredVelocity();
+        selectNeighborsInRange(getPolicy()->getInteractionRange());
         next_acceleration_ = getPolicy()->ComputeAcceleration(this, world);
     }
 }
 
-void Agent::ComputeContactForces(WorldBase* world) {
-    if (getPolicy()->getHaveSteps()) {
+void Agent::ComputeContactForces(WorldBase* world, Vector2D* reactionForces) {
+    const bool includeAgents = (reactionForces == nullptr);
+
+    // if the forces with agents are computed per pair, the policy only has to handle the obstacles
+    if (!includeAgents && neighbors_.second.empty()) {
+        next_contact_forces_ = Vector2D(0, 0);
+    } else if (getPolicy()->getHaveSteps()) {
         next_contact_forces_ = Vector2D(0, 0);
         for (auto* step : getPolicy()->getSteps()) {
-            ComputeNeighbors(world, step);
-            ComputePreferredVelocity();
-            next_contact_forces_ += step->ComputeContactForces(this, world);
-		}
+            selectNeighborsInRange(step->getInteractionRange());
+            next_contact_forces_ += step->ComputeContactForces(this, world, includeAgents);
+        }
     } else {
-        ComputeNeighbors(world, getPolicy());
-        ComputePreferredVelocity();
-        next_contact_forces_ = getPolicy()->ComputeContactForces(this, world);
+        selectNeighborsInRange(getPolicy()->getInteractionRange());
+        next_contact_forces_ = getPolicy()->ComputeContactForces(this, world, includeAgents);
     }
+
+    // add the forces with neighboring agents, computed once per pair of agents
+    if (!includeAgents)
+        addContactForcesPerPair(reactionForces);
+}
+
+void Agent::addContactForcesPerPair(Vector2D* reactionForces)
+{
+	const size_t index = getIndex();
+	const Vector2D& position = getPosition();
+	const float radius = getRadius();
+
+	for (const PhantomAgent& neighbor : neighbors_.first)
+	{
+		// skip the neighbors that do not collide with this agent, using the precomputed distance
+		const float distanceSquared = neighbor.GetDistanceSquared();
+		const float contactDistance = radius + neighbor.GetRadius();
+		if (distanceSquared >= contactDistance * contactDistance)
+			continue;
+
+		// if the neighbor also has this agent as a neighbor, the agent with the lowest index handles this pair
+		const size_t otherIndex = neighbor.GetIndex();
+		const Agent* other = getNeighborAgent(neighbor);
+		const bool isMutualNeighbor = otherIndex != index && distanceSquared < other->neighborsRange_ * other->neighborsRange_;
+		if (isMutualNeighbor && otherIndex < index)
+			continue;
+
+		const auto& diff = position - neighbor.GetPosition();
+		const float intersectionDistance = contactDistance - diff.magnitude();
+		if (intersectionDistance > 0)
+		{
+			const Vector2D& force = diff.getnormalized() * intersectionDistance;
+			const float scale = getContactForceScale(distanceSquared);
+			next_contact_forces_ += force * scale;
+
+			// the neighbor experiences the opposite force, scaled by its own policy (which is often the same as this agent's policy)
+			if (isMutualNeighbor)
+			{
+				const bool sameScale = other->getPolicy() == getPolicy() && other->neighborsRange_ == neighborsRange_;
+				reactionForces[otherIndex] -= force * (sameScale ? scale : other->getContactForceScale(distanceSquared));
+			}
+		}
+	}
+}
+
+float Agent::getContactForceScale(float distanceSquared) const
+{
+	// a policy (or each of its steps) only applies contact forces to the neighbors within its own range; see selectNeighborsInRange()
+	if (!getPolicy()->getHaveSteps())
+		return std::max(getPolicy()->getContactForceScale(), 0.0f);
+
+	float scale = 0;
+	for (const auto* step : getPolicy()->getSteps())
+	{
+		const float range = step->getInteractionRange();
+		if (step->getContactForceScale() > 0 && (range >= neighborsRange_ || distanceSquared < range * range))
+			scale += step->getContactForceScale();
+	}
+	return scale;
 }
 
 void Agent::updateViewingDirection()
 {
 	// update the viewing direction:
 	// weighted average of the preferred and actual velocity
-	const auto& vDiff = (2 * velocity_ + preferred_velocity_) / 3;
+	const auto& vDiff = (2 * getVelocity() + getPreferredVelocity()) / 3;
 	if (vDiff.sqrMagnitude() > 0.01)
 		viewing_direction_ = vDiff.getnormalized();
 }
@@ -115,18 +277,21 @@ void Agent::UpdateVelocityAndPosition(WorldBase* world)
 {
 	const float dt = world->GetDeltaTime();
 
+	Vector2D& velocity = this->velocity();
+	Vector2D& acceleration = this->acceleration();
+
 	// clamp the acceleration
-	acceleration_ = clampVector(next_acceleration_, getMaximumAcceleration());
+	acceleration = clampVector(next_acceleration_, getMaximumAcceleration());
 
 	// integrate the velocity; clamp to a maximum speed
-	velocity_ = clampVector(velocity_ + (acceleration_*dt), getMaximumSpeed());
+	velocity = clampVector(velocity + (acceleration*dt), getMaximumSpeed());
 
 	// add contact forces
 	contact_forces_ = next_contact_forces_;
-	velocity_ += contact_forces_ / settings_.mass_ * dt;
+	velocity += contact_forces_ / settings_.mass_ * dt;
 
 	// update the position
-	position_ += velocity_ * dt;
+	position() += velocity * dt;
 
 	updateViewingDirection();
 }
@@ -137,7 +302,7 @@ void Agent::UpdateVelocityAndPosition(WorldBase* world)
 
 bool Agent::hasReachedGoal() const
 {
-	return (goal_ - position_).sqrMagnitude() <= getRadius() * getRadius();
+	return (getGoal() - getPosition()).sqrMagnitude() <= getRadius() * getRadius();
 }
 
 #pragma endregion
@@ -146,22 +311,22 @@ bool Agent::hasReachedGoal() const
 
 void Agent::setPosition(const Vector2D &position)
 {
-	position_ = position;
+	this->position() = position;
 }
 
 void Agent::setVelocity_ExternalApplication(const Vector2D &velocity, const Vector2D &viewingDirection)
 {
-	velocity_ = velocity;
+	this->velocity() = velocity;
 	viewing_direction_ = viewingDirection;
 }
 
 void Agent::setGoal(const Vector2D &goal)
 {
-	goal_ = goal;
+	this->goal() = goal;
 
 	// look straight towards the goal
-	if (goal_ != position_)
-		viewing_direction_ = (goal_ - position_).getnormalized();
+	if (goal != getPosition())
+		viewing_direction_ = (goal - getPosition()).getnormalized();
 }
 
 void Agent::setPolicy(Policy* policy)
@@ -177,6 +342,24 @@ float Agent::ComputeRandomNumber(float min, float max)
 	return distribution(RNGengine_);
 }
 
+CostFunctionScratch& Agent::GetCostFunctionScratch(const CostFunction* costFunction)
+{
+	// an agent typically uses only a few cost functions, so a linear search is fastest
+	for (auto& scratch : costFunctionScratch_)
+		if (scratch.costFunction == costFunction)
+			return scratch;
+
+	costFunctionScratch_.emplace_back();
+	costFunctionScratch_.back().costFunction = costFunction;
+	return costFunctionScratch_.back();
+}
+
+void Agent::ResetCostFunctionScratch()
+{
+	for (auto& scratch : costFunctionScratch_)
+		scratch.stepNumber = CostFunctionScratch::NotPrepared;
+}
+
 bool Agent::isSPHObstacleParticle() const {
     return false;
 }
@@ -32,6 +32,7 @@
 #include <tools/vector2D.h>
 #include <tools/Color.h>
 #include <core/policy.h>
+#include <core/AgentStateStore.h>
 #include <3rd-party/ORCA/ORCALine.h>
 #include <random>
 #include <CostFunctions/SPH.h>
@@ -74,25 +75,50 @@ private:
 	size_t id_;
 	Agent::Settings settings_;
 
-	Vector2D position_;
-	Vector2D velocity_;
-	Vector2D acceleration_;
-	Vector2D contact_forces_;
+	/// <summary>The store that contains this agent's position, velocity, acceleration, preferred velocity, goal, and radius.</summary>
+	AgentStateStore* states_;
+	/// <summary>The index of this agent's slot in states_.</summary>
+	size_t stateSlot_;
+	friend AgentStateStore;
 
-	Vector2D preferred_velocity_;
-	Vector2D goal_; 
+	Vector2D contact_forces_;
 	Vector2D viewing_direction_;
 	
 	Vector2D next_acceleration_;
 	Vector2D next_contact_forces_;
 
-	NeighborList neighbors_;
+	/// <summary>The result of this agent's last nearest-neighbor query, using the full interaction range of its Policy.
+	/// The neighbors themselves are stored in the neighbor buffer of the world, together with those of all other agents.</summary>
+	NeighborView neighbors_;
+	/// <summary>The search radius that was used to compute neighbors_.</summary>
+	float neighborsRange_;
+	/// <summary>The subset of neighbors_ that lies within the range of the PolicyStep that is currently being evaluated.</summary>
+	NeighborList stepNeighbors_;
+	/// <summary>Whether getNeighbors() should currently return stepNeighbors_ instead of neighbors_.</summary>
+	bool useStepNeighbors_;
+
+	/// <summary>A neighboring agent that was found with an enlarged search radius, for use in later simulation steps.</summary>
+	struct NeighborCandidate
+	{
+		/// <summary>The index of the neighboring agent, i.e. its slot in the store of per-step agent data.</summary>
+		uint32_t index;
+		/// <summary>The amount by which the agent's position should be offset, e.g. to account for wrap-around in a toric world.</summary>
+		Vector2D positionOffset;
+	};
+	/// <summary>The agents and obstacles found by the last query with an enlarged search radius (a Verlet neighbor list), 
+	/// from which the neighbors of this agent are selected as long as the world does not perform a new query.</summary>
+	std::vector<NeighborCandidate> neighborCandidates_;
+	std::vector<LineSegment2D> obstacleCandidates_;
+	/// <summary>The position of this agent when neighborCandidates_ was computed.</summary>
+	Vector2D candidatesPosition_;
+	/// <summary>The interaction range of this agent's Policy when neighborCandidates_ was computed.</summary>
+	float candidatesRange_;
 
     // TODO: 吴越洋1030添加
     SPH::DensityData density_, density_progressive_;
 
 	// Private constructor; only the world should create agents
-	Agent(size_t id, const Agent::Settings& settings);
+	Agent(size_t id, const Agent::Settings& settings, AgentStateStore* states);
 	friend WorldBase;
 
 	// Random-number generation
@@ -100,10 +126,34 @@ private:
 
 	ORCALibrary::Solution orcaSolution_;
 
+	/// <summary>The scratch areas of all cost functions that this agent has used so far, one entry per function.</summary>
+	std::vector<CostFunctionScratch> costFunctionScratch_;
+
 private:
 
 	void updateViewingDirection();
 
+	// Mutable access to the data in this agent's slot of states_
+	inline Vector2D& position() { return states_->positions_[stateSlot_]; }
+	inline Vector2D& velocity() { return states_->velocities_[stateSlot_]; }
+	inline Vector2D& acceleration() { return states_->accelerations_[stateSlot_]; }
+	inline Vector2D& preferredVelocity() { return states_->preferredVelocities_[stateSlot_]; }
+	inline Vector2D& goal() { return states_->goals_[stateSlot_]; }
+
+	/// <summary>Lets getNeighbors() return only the neighbors that lie within a given range, 
+	/// without performing a new nearest-neighbor query.</summary>
+	/// <param name="range">The range of the Policy or PolicyStep that is about to use the neighbors.</param>
+	void selectNeighborsInRange(float range);
+
+	/// <summary>Returns the total scaling factor of the contact force between this agent and one of its neighbors, 
+	/// i.e. the sum of the scales of all policy steps that see this neighbor.</summary>
+	/// <param name="distanceSquared">The squared distance to the neighbor.</param>
+	float getContactForceScale(float distanceSquared) const;
+
+	/// <summary>Adds the contact forces with neighboring agents to next_contact_forces_, handling each colliding pair of agents only once.</summary>
+	/// <param name="reactionForces">An array with one element per agent, to which the opposite forces for the neighbors are added.</param>
+	void addContactForcesPerPair(Vector2D* reactionForces);
+
 public:
 
 #pragma region [Simulation-loop methods]
@@ -112,11 +162,36 @@ public:
 	/// @{
 
 	/// <summary>Performs a nearest-neighbor query for this agent, using the search radius specified in its cost functions.</summary>
-	/// <remarks>The search radius is the largest value of the "range" parameter among all cost functions in the agent's Policy.
-	/// The result will be stored in a NeighborList object inside the agent. 
-	/// You can obtain this result via the Agent::GetNeighbors() method.</remarks>
+	/// <remarks>The search radius is the largest value of the "range" parameter among all cost functions in the agent's Policy
+	/// (including the cost functions of all its steps). This is the only query that the agent performs in a simulation frame:
+	/// a PolicyStep with a smaller range will only see the part of the result that lies within its own range.
+	/// The world stores the result in its neighbor buffer, after which you can obtain it via the Agent::getNeighbors() method.</remarks>
 	/// <param name="world">A reference to the world in which the simulation takes place.</param>
-	void ComputeNeighbors(WorldBase* world, Policy* policy);
+	/// <param name="result">[out] The result of the query is appended to this list.</param>
+	void ComputeNeighbors(WorldBase* world, NeighborList& result);
+
+	/// <summary>Performs a nearest-neighbor query for this agent with an enlarged search radius, 
+	/// and stores the result as candidates for the neighbors in the following simulation steps (a Verlet neighbor list).</summary>
+	/// <remarks>As long as the agents have not moved more than half the skin since this query, 
+	/// all neighbors of this agent are among these candidates. Use ComputeNeighborsFromCandidates() to select them.</remarks>
+	/// <param name="world">A reference to the world in which the simulation takes place.</param>
+	/// <param name="skin">The distance by which the search radius is enlarged.</param>
+	/// <param name="buffer">A NeighborList that can be used for storing the result of the query.</param>
+	void ComputeNeighborCandidates(WorldBase* world, float skin, NeighborList& buffer);
+
+	/// <summary>Selects the neighbors of this agent from the candidates of the last call to ComputeNeighborCandidates(), 
+	/// using the agents' current positions and velocities.</summary>
+	/// <remarks>The result is the same as that of ComputeNeighbors(), up to floating-point rounding, 
+	/// as long as NeedsNewNeighborCandidates() returns false for all agents.</remarks>
+	/// <param name="result">[out] The neighbors of this agent are appended to this list.</param>
+	void ComputeNeighborsFromCandidates(NeighborList& result);
+
+	/// <summary>Checks whether the neighbor candidates of this agent may be incomplete, 
+	/// because the agent has moved too far or because the range of its Policy has increased.</summary>
+	/// <param name="skin">The distance by which the search radius was enlarged in ComputeNeighborCandidates().</param>
+	/// <returns>true if the agent has moved more than half the skin since its candidates were computed, 
+	/// or if its Policy has a larger range than at that time; false otherwise.</returns>
+	bool NeedsNewNeighborCandidates(float skin) const;
 
 	/// <summary>Computes a preferred velocity for the agent.</summary>
 	/// <remarks>Because this framework only considers local navigation, 
@@ -130,9 +205,13 @@ public:
 	void ComputeAcceleration(WorldBase* world);
 
 	/// <summary>Computes forces with neighboring agents that are currently colliding with this agent.</summary>
-	/// <remarks>The result will be stored internally in the agent.</remarks>
+	/// <remarks>The result will be stored internally in the agent.
+	/// If reactionForces is given, two agents that are each other's neighbors share the computation of their contact: 
+	/// only the agent with the lowest index computes it, and it adds the opposite force (scaled by the neighbor's own policy) 
+	/// to the element of reactionForces at the neighbor's index. The world adds these forces to the neighbors before they move.</remarks>
 	/// <param name="world">A reference to the world in which the simulation takes place.</param>
-	void ComputeContactForces(WorldBase* world);
+	/// <param name="reactionForces">An array with one element per agent, or nullptr to compute all contacts of this agent by itself.</param>
+	void ComputeContactForces(WorldBase* world, Vector2D* reactionForces = nullptr);
 
 	/// <summary>Updates the velocity and position of this Agent via Euler integration, using the last computed acceleration and contact forces.</summary>
 	/// <param name="world">A reference to the world in which the simulation takes place.</param>
@@ -151,14 +230,17 @@ public:
 
 	/// <summary>Returns the unique ID of this agent.</summary>
 	size_t getID() const { return id_; }
+	/// <summary>Returns the position of this agent in the world's list of agents (see WorldBase::GetAgents()).</summary>
+	/// <remarks>This index changes when other agents are removed, so it should only be used within a single simulation step.</remarks>
+	inline size_t getIndex() const { return stateSlot_; }
 	/// <summary>Returns the agent's current position.</summary>
-	inline const Vector2D& getPosition() const { return position_; }
+	inline const Vector2D& getPosition() const { return states_->positions_[stateSlot_]; }
 	/// <summary>Returns the agent's last used velocity.</summary>
-	inline const Vector2D& getVelocity() const { return velocity_; }
+	inline const Vector2D& getVelocity() const { return states_->velocities_[stateSlot_]; }
 	/// <summary>Returns the agent's last computed preferred velocity.</summary>
-	inline const Vector2D& getPreferredVelocity() const { return preferred_velocity_; }
+	inline const Vector2D& getPreferredVelocity() const { return states_->preferredVelocities_[stateSlot_]; }
 	/// <summary>Returns the radius of the agent's disk representation.</summary>
-	inline float getRadius() const { return settings_.radius_; }
+	inline float getRadius() const { return states_->radii_[stateSlot_]; }
 	/// <summary>Returns the agent's preferred walking speed.</summary>
 	inline float getPreferredSpeed() const { return settings_.preferred_speed_; };
 	/// <summary>Returns the agent's maximum walking speed.</summary>
@@ -174,12 +256,21 @@ public:
 	/// <summary>Returns the agent's visualization color.</summary>
 	inline const Color& getColor() const { return settings_.color_; }
 	/// <summary>Returns the agent's goal position.</summary>
-	inline const Vector2D& getGoal() const { return goal_; }
+	inline const Vector2D& getGoal() const { return states_->goals_[stateSlot_]; }
 	/// <summary>Returns the agent's current viewing direction.</summary>
 	inline const Vector2D& getViewingDirection() const { return viewing_direction_; }
 	/// <summary>Returns the (most recently computed) list of neighbors for this agent.</summary>
-	/// <returns>A non-mutable reference to the list of neighbors that this agent has last computed.</returns>
-	inline const NeighborList& getNeighbors() const { return neighbors_; }
+	/// <returns>A read-only view of the neighbors that this agent has last computed. 
+	/// It remains valid until the neighbors of the next simulation step are computed. 
+	/// Removing an agent from the simulation changes the indices of other agents (see getIndex()), 
+	/// so the world then clears the neighbors of all agents, and this view is empty until the next step.</returns>
+	NeighborView getNeighbors() const;
+	/// <summary>Returns the Agent that one of this agent's neighbors refers to.</summary>
+	/// <remarks>Most neighbor loops only need the data that the PhantomAgent itself stores;
+	/// use this method only for the agent properties that it does not store (e.g. the mass).</remarks>
+	/// <param name="neighbor">One of the neighbors currently returned by getNeighbors().</param>
+	/// <returns>A pointer to the neighboring agent.</returns>
+	const Agent* getNeighborAgent(const PhantomAgent& neighbor) const;
     inline const SPH::DensityData getSPHDensityData() const {
         return density_;
     };
@@ -248,6 +339,21 @@ public:
 
 #pragma endregion
 
+#pragma region [Cost-function scratch]
+
+	/// <summary>Returns this agent's scratch area for a given cost function, creating an empty one if this function has not used it yet.</summary>
+	/// <remarks>Cost functions should normally use CostFunction::GetPreparedScratch() instead, which also fills in the scratch area.</remarks>
+	/// <param name="costFunction">The cost function that owns the requested scratch area.</param>
+	/// <returns>A reference to the scratch area; its stepNumber is CostFunctionScratch::NotPrepared if the scratch area is new.</returns>
+	CostFunctionScratch& GetCostFunctionScratch(const CostFunction* costFunction);
+
+	/// <summary>Marks the scratch areas of all cost functions as outdated, so that they will be prepared again when they are used next.</summary>
+	/// <remarks>Use this after evaluating cost functions outside of a simulation step (e.g. for visualization), 
+	/// so that the next simulation step does not reuse data that was prepared for a different situation.</remarks>
+	void ResetCostFunctionScratch();
+
+#pragma endregion
+
 };
 
 #endif //LIB_AGENT_H
@@ -40,6 +40,13 @@ Vector2D CostFunction::RotateGradientToEuclideanCoordinates(const float GradTh,
 	return R * (Vector2D(sin(GradTh), 1 - cos(GradTh))*speed + Vector2D(0, GradS));
 }
 
+void CostFunction::GetCostBatch(const Vector2D* velocities, size_t n, float* out, Agent* agent, const WorldBase* world) const
+{
+	// Default implementation: compute the cost of each velocity separately
+	for (size_t i = 0; i < n; ++i)
+		out[i] = GetCost(velocities[i], agent, world);
+}
+
 Vector2D CostFunction::GetGradient(const Vector2D& velocity, Agent* agent, const WorldBase* world) const
 {
 	// Default implementation of the gradient: a numerical approximation
@@ -75,6 +82,12 @@ Vector2D CostFunction::GetGlobalMinimum(Agent* agent, const WorldBase* world) co
 	);
 }
 
+/// <summary>Per-thread buffers for the candidate velocities of ApproximateGlobalMinimumBySampling() and their costs, 
+/// so that sampling does not allocate memory once the buffers are large enough.</summary>
+static thread_local std::vector<Vector2D> samplingCandidates;
+static thread_local std::vector<float> samplingTotalCosts;
+static thread_local std::vector<float> samplingCosts;
+
 Vector2D CostFunction::ApproximateGlobalMinimumBySampling(Agent* agent, const WorldBase* world,
 	const SamplingParameters& params, const CostFunctionList& costFunctions)
 {
@@ -103,8 +116,8 @@ Vector2D CostFunction::ApproximateGlobalMinimumBySampling(Agent* agent, const Wo
 
 	// --- Option 1: Random sampling
 
-	Vector2D bestVelocity(0, 0);
-	float bestCost = MaxFloat;
+	auto& candidates = samplingCandidates;
+	candidates.clear();
 
 	if (params.type == SamplingParameters::Type::RANDOM)
 	{
@@ -113,19 +126,7 @@ Vector2D CostFunction::ApproximateGlobalMinimumBySampling(Agent* agent, const Wo
 			// create a random velocity in the cone/circle
 			float randomAngle = agent->ComputeRandomNumber(-maxAngle, maxAngle);
 			float randomLength = agent->ComputeRandomNumber(0, radius);
-			const Vector2D& velocity = base + rotateCounterClockwise(baseDirection, randomAngle) * randomLength;
-
-			// compute the cost for this velocity
-			float totalCost = 0;
-			for (auto& costFunction : costFunctions)
-				totalCost += costFunction.second * costFunction.first->GetCost(velocity, agent, world);
-
-			// check if this cost is better than the minimum so far
-			if (totalCost < bestCost)
-			{
-				bestVelocity = velocity;
-				bestCost = totalCost;
-			}
+			candidates.push_back(base + rotateCounterClockwise(baseDirection, randomAngle) * randomLength);
 		}
 	}
 
@@ -149,19 +150,7 @@ Vector2D CostFunction::ApproximateGlobalMinimumBySampling(Agent* agent, const Wo
 			for (int a = 0; a < params.angleSamples; ++a, candidateAngle += deltaAngle)
 			{
 				// construct the candidate velocity
-				const Vector2D& velocity = base + rotateCounterClockwise(baseDirection, candidateAngle) * candidateLength;
-
-				// compute the cost for this velocity
-				float totalCost = 0;
-				for (auto& costFunction : costFunctions)
-					totalCost += costFunction.second * costFunction.first->GetCost(velocity, agent, world);
-
-				// check if this cost is better than the minimum so far
-				if (totalCost < bestCost)
-				{
-					bestVelocity = velocity;
-					bestCost = totalCost;
-				}
+				candidates.push_back(base + rotateCounterClockwise(baseDirection, candidateAngle) * candidateLength);
 
 				// if we are currently checking the base velocity, we don't have to sample any more angles
 				if (params.includeBaseAsSample && s == 1)
@@ -170,11 +159,50 @@ Vector2D CostFunction::ApproximateGlobalMinimumBySampling(Agent* agent, const Wo
 		}
 	}
 
+	// --- Compute the total cost of all candidates, using one batch per cost function
+
+	const size_t nrCandidates = candidates.size();
+	auto& totalCosts = samplingTotalCosts;
+	auto& costs = samplingCosts;
+	totalCosts.assign(nrCandidates, 0);
+	costs.resize(nrCandidates);
+	for (auto& costFunction : costFunctions)
+	{
+		StepProfiler::CostFunctionTimer timer(world->GetProfiler(), costFunction.first, nrCandidates);
+		costFunction.first->GetCostBatch(candidates.data(), nrCandidates, costs.data(), agent, world);
+		for (size_t i = 0; i < nrCandidates; ++i)
+			totalCosts[i] += costFunction.second * costs[i];
+	}
+
 	// --- Return the velocity with the lowest cost
 
+	Vector2D bestVelocity(0, 0);
+	float bestCost = MaxFloat;
+	for (size_t i = 0; i < nrCandidates; ++i)
+	{
+		if (totalCosts[i] < bestCost)
+		{
+			bestVelocity = candidates[i];
+			bestCost = totalCosts[i];
+		}
+	}
+
 	return bestVelocity;
 }
 
+CostFunctionScratch& CostFunction::GetPreparedScratch(Agent* agent, const WorldBase* world) const
+{
+	// prepare the data only if we have not yet done so in this simulation step
+	auto& scratch = agent->GetCostFunctionScratch(this);
+	if (scratch.stepNumber != world->GetStepNumber())
+	{
+		PrepareForAgent(agent, world, scratch);
+		scratch.stepNumber = world->GetStepNumber();
+	}
+
+	return scratch;
+}
+
 void CostFunction::parseParameters(const CostFunctionParameters & params)
 {
 	params.ReadFloat("range", range_);
@@ -239,7 +267,7 @@ float CostFunction::ComputeTimeToCollision(
 }
 
 float CostFunction::ComputeTimeToFirstCollision(const Vector2D& position, const Vector2D& velocity, const float radius,
-	const NeighborList& neighbors, const float maximumDistance, bool ignoreCurrentCollisions) const
+	const NeighborView& neighbors, const float maximumDistance, bool ignoreCurrentCollisions) const
 {
 	float minTTC = MaxFloat;
 	const float maxDistSquared = maximumDistance * maximumDistance;
@@ -250,7 +278,7 @@ float CostFunction::ComputeTimeToFirstCollision(const Vector2D& position, const
 		if (neighborAgent.GetDistanceSquared() > maxDistSquared)
 			continue;
 
-		float ttc = ComputeTimeToCollision(position, velocity, radius, neighborAgent.GetPosition(), neighborAgent.GetVelocity(), neighborAgent.realAgent->getRadius());
+		float ttc = ComputeTimeToCollision(position, velocity, radius, neighborAgent.GetPosition(), neighborAgent.GetVelocity(), neighborAgent.GetRadius());
 		
 		// ignore current collisions?
 		if (ignoreCurrentCollisions && ttc == 0)
@@ -279,6 +307,82 @@ float CostFunction::ComputeTimeToFirstCollision(const Vector2D& position, const
 	return minTTC;
 }
 
+void CostFunction::ComputeTimeToFirstCollisionBatch(const Vector2D& position, const Vector2D* velocities, size_t n, const float radius,
+	const NeighborView& neighbors, const float maximumDistance, bool ignoreCurrentCollisions, float* result) const
+{
+	for (size_t i = 0; i < n; ++i)
+		result[i] = MaxFloat;
+
+	const float maxDistSquared = maximumDistance * maximumDistance;
+
+	// check neighboring agents
+	for (const auto& neighborAgent : neighbors.first)
+	{
+		if (neighborAgent.GetDistanceSquared() > maxDistSquared)
+			continue;
+
+		// the parts of ComputeTimeToCollision() that do not depend on the velocity
+		const Vector2D PDiff(position - neighborAgent.GetPosition());
+		const float Radii = radius + neighborAgent.GetRadius();
+		const float RadiiSq = Radii * Radii;
+
+		// if there is already a collision now, the time to collision is 0 for all velocities
+		if (PDiff.sqrMagnitude() <= RadiiSq)
+		{
+			if (!ignoreCurrentCollisions)
+			{
+				for (size_t i = 0; i < n; ++i)
+					result[i] = 0;
+			}
+			continue;
+		}
+
+		const float c = PDiff.dot(PDiff) - RadiiSq;
+		const Vector2D& neighborVelocity = neighborAgent.GetVelocity();
+
+		// the parts that do depend on the velocity
+		for (size_t i = 0; i < n; ++i)
+		{
+			const Vector2D VDiff(velocities[i] - neighborVelocity);
+			const float a = VDiff.dot(VDiff);
+			const float b = 2 * PDiff.dot(VDiff);
+
+			float t1 = MaxFloat, t2 = MaxFloat;
+			SolveQuadraticEquation(a, b, c, t1, t2);
+			if (t1 < 0) t1 = MaxFloat;
+			if (t2 < 0) t2 = MaxFloat;
+
+			const float ttc = std::min(t1, t2);
+
+			// ignore current collisions? (the result can still be 0 here, e.g. if both velocities are equal)
+			if (ignoreCurrentCollisions && ttc == 0)
+				continue;
+
+			if (ttc < result[i])
+				result[i] = ttc;
+		}
+	}
+
+	// check neighboring obstacles
+	for (const auto& neighboringObstacle : neighbors.second)
+	{
+		if (distanceToLineSquared(position, neighboringObstacle.first, neighboringObstacle.second, true) > maxDistSquared)
+			continue;
+
+		for (size_t i = 0; i < n; ++i)
+		{
+			float ttc = ComputeTimeToCollision_LineSegment(position, velocities[i], radius, neighboringObstacle);
+
+			// ignore current collisions?
+			if (ignoreCurrentCollisions && ttc == 0)
+				continue;
+
+			if (ttc < result[i])
+				result[i] = ttc;
+		}
+	}
+}
+
 float CostFunction::ComputeTimeToCollision_LineSegment(const Vector2D& position, const Vector2D& velocity, const float radius, const LineSegment2D& lineSegment) const
 {
 	// compute TTC for the first endpoint
@@ -31,6 +31,7 @@
 
 #include <core/costFunctionParameters.h>
 #include <tools/vector2D.h>
+#include <tools/Span.h>
 
 class WorldBase;
 class Agent;
@@ -41,10 +42,31 @@ struct PhantomAgent;
 
 typedef std::vector<PhantomAgent> AgentNeighborList;
 typedef std::vector<LineSegment2D> ObstacleNeighborList;
+/// <summary>The neighboring agents and obstacles found by a nearest-neighbor query. See WorldBase::ComputeNeighbors().</summary>
 typedef std::pair<AgentNeighborList, ObstacleNeighborList> NeighborList;
+/// <summary>A read-only view of neighboring agents and obstacles that are stored elsewhere, e.g. in the neighbor buffer of a WorldBase.</summary>
+/// <remarks>A NeighborList can be converted to a NeighborView. Agent::getNeighbors() returns a NeighborView.</remarks>
+typedef std::pair<Span<PhantomAgent>, Span<LineSegment2D>> NeighborView;
 
 typedef std::vector<std::pair<const CostFunction*, float>> CostFunctionList;
 
+/// <summary>Per-agent data that a CostFunction computes once per simulation step, in CostFunction::PrepareForAgent().</summary>
+/// <remarks>Each agent stores one scratch area per cost function that it uses. 
+/// The meaning of the contents is up to the cost function that owns the scratch area.</remarks>
+struct CostFunctionScratch
+{
+	/// <summary>The cost function that owns this scratch area.</summary>
+	const CostFunction* costFunction = nullptr;
+	/// <summary>A value of stepNumber indicating that the contents have to be computed (again).</summary>
+	static const size_t NotPrepared = (size_t)-1;
+	/// <summary>The simulation step (see WorldBase::GetStepNumber()) in which the contents were computed, or NotPrepared.</summary>
+	size_t stepNumber = NotPrepared;
+	/// <summary>Scalar data stored by the cost function.</summary>
+	std::vector<float> values;
+	/// <summary>Vector data stored by the cost function.</summary>
+	std::vector<Vector2D> vectors;
+};
+
     /// @defgroup costfunctions Cost functions
     /// Implementations of specific cost functions for local navigation.
 
@@ -149,6 +171,11 @@ protected:
 /// <returns>The number of solutions to the equation, i.e. 0, 1, or 2.</returns>
 int SolveQuadraticEquation(float a, float b, float c, float& answer1, float& answer2) const;
 
+private:
+	/// <summary>The name under which this cost function was created by CostFunctionFactory.</summary>
+	std::string typeName_;
+	friend class CostFunctionFactory;
+
 public:
 	CostFunction();
 	virtual ~CostFunction();
@@ -157,6 +184,9 @@ public:
 	/// <remarks>This is the radius of the circle (around the active agent) in which the cost function operates.</remarks>
 	inline float GetRange() const { return range_; }
 
+	/// <summary>Returns the name under which this cost function was created (e.g. "Karamouzas"), or an empty string if it was not created by CostFunctionFactory.</summary>
+	inline const std::string& GetTypeName() const { return typeName_; }
+
 #pragma region [Main operations]
 	/// @name Main operations
 	/// The core operations that each CostFunction should support.
@@ -172,6 +202,18 @@ public:
 	/// <returns>A floating-point cost indicating the (un)attractiveness of the given velocity for the given agent.</param>
 	virtual float GetCost(const Vector2D& velocity, Agent* agent, const WorldBase* world) const = 0;
 
+	/// <summary>Computes the costs of a list of velocities.</summary>
+	/// <remarks>By default, this method simply calls GetCost() for each velocity. 
+	/// Subclasses of CostFunction may override it to share work between the velocities (e.g. anything that only depends on the agent and its neighbors), 
+	/// or to loop over neighbors in the outer loop and over velocities in the inner loop. 
+	/// An override must give the same results as calling GetCost() for each velocity.</remarks>
+	/// <param name="velocities">A pointer to the first of "n" velocities for which the cost is requested.</param>
+	/// <param name="n">The number of velocities.</param>
+	/// <param name="out">[out] A pointer to an array of (at least) "n" numbers, which will store the cost of each velocity.</param>
+	/// <param name="agent">The agent that would use the requested velocities.</param>
+	/// <param name="world">The world in which the simulation takes place.</param>
+	virtual void GetCostBatch(const Vector2D* velocities, size_t n, float* out, Agent* agent, const WorldBase* world) const;
+
 	/// <summary>Computes the gradient of the cost function at a given velocity.</summary>
 	/// <remarks>The gradient is a 2D vector that points in the direction of steepest ascent, i.e. the direction in which the cost increases the most. 
 	/// By default, this method uses sampling to approximate the gradient.
@@ -201,10 +243,38 @@ public:
 	/// @}
 #pragma endregion
 
+#pragma region [Per-agent preparation]
+	/// @name Per-agent preparation
+	/// A hook for computing data that does not depend on the velocity being evaluated.
+	/// @{
+
+	/// <summary>Computes any data that depends only on the agent (and its neighbors), and stores it in the agent's scratch area for this cost function.</summary>
+	/// <remarks>This method is called at most once per agent per simulation step, 
+	/// the first time that GetPreparedScratch() is called for that agent in that step. 
+	/// By default, it does nothing. Override it to compute invariants (e.g. a time to collision at the preferred velocity) 
+	/// that GetCost() and related methods would otherwise recompute for every velocity.</remarks>
+	/// <param name="agent">The agent for which data should be prepared.</param>
+	/// <param name="world">The world in which the simulation takes place.</param>
+	/// <param name="scratch">[out] The agent's scratch area for this cost function. 
+	/// It still contains the data of the previous simulation step, so it can be reused without new allocations.</param>
+	virtual void PrepareForAgent(Agent* /*agent*/, const WorldBase* /*world*/, CostFunctionScratch& /*scratch*/) const {}
+
+	/// <summary>Returns the agent's scratch area for this cost function, calling PrepareForAgent() first if this has not happened yet in the current simulation step.</summary>
+	/// <param name="agent">The agent whose scratch area is requested.</param>
+	/// <param name="world">The world in which the simulation takes place.</param>
+	/// <returns>A reference to the agent's scratch area for this cost function, filled in for the current simulation step.
+	/// The reference is only valid until another cost function requests its scratch area for the same agent, 
+	/// because the agent may then have to make room for it; do not keep it (or references into it) beyond that.</returns>
+	CostFunctionScratch& GetPreparedScratch(Agent* agent, const WorldBase* world) const;
+
+	/// @}
+#pragma endregion
+
 	/// <summary>Uses sampling to approximate the global minimum of a list of cost functions.
 	/// <remarks>This method tries out several candidate velocities (sampled according to 'params'), 
 	/// computes the total cost for each candidate (combining all functions in 'costFunctions'), 
-	/// and returns the velocity with the lowest cost.</remarks>
+	/// and returns the velocity with the lowest cost.
+	/// All candidates are generated first, and each cost function evaluates them in a single call to GetCostBatch().</remarks>
 	/// <param name="agent">The agent for which the optimal velocity is requested.</param>
 	/// <param name="world">The world in which the simulation takes place.</param>
 	/// <param name="params">Parameters for sampling the velocity space.</param>
@@ -254,7 +324,24 @@ protected:
 	/// <seealso cref="ComputeTimeToCollision"/>
 	float ComputeTimeToFirstCollision(
 		const Vector2D& position, const Vector2D& velocity, const float radius,
-		const NeighborList& neighbors, float maximumDistance, bool ignoreCurrentCollisions) const;
+		const NeighborView& neighbors, float maximumDistance, bool ignoreCurrentCollisions) const;
+
+	/// <summary>Computes the expected time to the first collision with a set of neighboring agents and obstacles, for a list of velocities.</summary>
+	/// <remarks>The result for each velocity is the same as that of ComputeTimeToFirstCollision(). 
+	/// However, this method loops over the neighbors only once, and it handles all velocities for each neighbor in a tight inner loop.</remarks>
+	/// <param name="position">The current position of the querying agent.</param>
+	/// <param name="velocities">A pointer to the first of "n" hypothetical velocities of the querying agent.</param>
+	/// <param name="n">The number of velocities.</param>
+	/// <param name="radius">The radius (in meters) of the querying agent.</param>
+	/// <param name="neighbors">A list of neighboring agents and obstacles.</param>
+	/// <param name="maximumDistance">The maximum distance between the query position and a neighboring object.
+	/// Any objects farther away will be ignored.</param>
+	/// <param name="ignoreCurrentCollisions">Whether or not to ignore any collisions that are already happening now.</param>
+	/// <param name="result">[out] A pointer to an array of (at least) "n" numbers, 
+	/// which will store the smallest time to collision (in seconds) for each velocity.</param>
+	void ComputeTimeToFirstCollisionBatch(
+		const Vector2D& position, const Vector2D* velocities, size_t n, const float radius,
+		const NeighborView& neighbors, float maximumDistance, bool ignoreCurrentCollisions, float* result) const;
 
 	/// <summary>Computes the expected time at which the distance between two disk-shaped objects is minimal, and the value of this distance.</summary>
 	/// <param name="position1">The current position of object 1.</param>
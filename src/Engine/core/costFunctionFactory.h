@@ -89,7 +89,9 @@ public:
 			return nullptr;
 		}
 
-		return registry[name]();
+		CostFunction* costFunction = registry[name]();
+		costFunction->typeName_ = name;
+		return costFunction;
 	}
 };
 
@@ -31,10 +31,17 @@
 #include <string>
 #include <tools/HelperFunctions.h>
 #include <tools/TrajectoryCSVWriter.h>
+#include <tools/TrajectoryBinaryWriter.h>
+#include <tools/AsyncTrajectoryWriter.h>
 #include <core/worldInfinite.h>
 #include <core/worldToric.h>
 #include <core/costFunctionFactory.h>
 #include <core/worldPlanar.h>
+#include <core/AgentKDTree.h>
+#include <core/AgentGrid.h>
+#include <core/ScenarioGenerator.h>
+#include <core/BinaryScenario.h>
+#include <tools/MemoryMappedFile.h>
 #include <memory>
 #include <clocale>
 #include <filesystem>
@@ -44,22 +51,47 @@ CrowdSimulator::CrowdSimulator()
 	CostFunctionFactory::RegisterAllCostFunctions();
 	writer_ = nullptr;
 	end_time_ = MaxFloat;
+	outputMemoryBudget_ = 0;
+	outputStepInterval_ = 1;
+	outputTimeInterval_ = 0;
 }
 
 void CrowdSimulator::StartCSVOutput(const std::string &dirname, bool flushImmediately)
 {
-	// create the CSV writer if it did not exist yet
-	if (writer_ == nullptr)
-		writer_ = new TrajectoryCSVWriter(flushImmediately);
+	// replace any previous writer by a CSV writer
+	StopCSVOutput();
+	TrajectoryCSVWriter* writer = new TrajectoryCSVWriter(flushImmediately);
 
 	// try to set the directory
-	if (!writer_->SetOutputDirectory(dirname))
+	if (!writer->SetOutputDirectory(dirname))
 	{
 		std::cerr << "Error: Could not set CSV output directory to " << dirname << "." << std::endl
 			<< "The program will be unable to write CSV output." << std::endl;
-		delete writer_;
-		writer_ = nullptr;
+		delete writer;
+		return;
 	}
+
+	writer_ = new AsyncTrajectoryWriter(writer);
+	writer_->SetMemoryBudget(outputMemoryBudget_);
+}
+
+void CrowdSimulator::StartBinaryOutput(const std::string& filename, bool flushImmediately)
+{
+	// replace any previous writer by a binary writer
+	StopCSVOutput();
+	TrajectoryBinaryWriter* writer = new TrajectoryBinaryWriter(flushImmediately);
+
+	// try to create the file
+	if (!writer->SetOutputFile(filename))
+	{
+		std::cerr << "Error: Could not create binary output file " << filename << "." << std::endl
+			<< "The program will be unable to write binary output." << std::endl;
+		delete writer;
+		return;
+	}
+
+	writer_ = new AsyncTrajectoryWriter(writer);
+	writer_->SetMemoryBudget(outputMemoryBudget_);
 }
 
 void CrowdSimulator::StopCSVOutput()
@@ -71,9 +103,76 @@ void CrowdSimulator::StopCSVOutput()
 	}
 }
 
+void CrowdSimulator::SetOutputMemoryBudget(size_t bytes)
+{
+	outputMemoryBudget_ = bytes;
+	if (writer_ != nullptr)
+		writer_->SetMemoryBudget(bytes);
+}
+
+void CrowdSimulator::SetOutputStepInterval(int nrSteps)
+{
+	outputStepInterval_ = std::max(1, nrSteps);
+}
+
+void CrowdSimulator::SetOutputTimeInterval(float seconds)
+{
+	outputTimeInterval_ = std::max(0.0f, seconds);
+}
+
+bool CrowdSimulator::isOutputStep() const
+{
+	const double t = world_->GetCurrentTime();
+	const double dt = world_->GetDeltaTime();
+
+	// with a time interval: check if the last step has crossed a multiple of the interval
+	if (outputTimeInterval_ > 0)
+		return floor(t / outputTimeInterval_ + 1e-6) > floor((t - dt) / outputTimeInterval_ + 1e-6);
+
+	// otherwise, count the steps
+	return (long long)round(t / dt) % outputStepInterval_ == 0;
+}
+
+void CrowdSimulator::SetProfilingEnabled(bool enabled)
+{
+	world_->SetProfilingEnabled(enabled);
+	if (!enabled)
+		return;
+
+	// label each cost function by its policy (and step), so that the profiler can show where the time goes
+	StepProfiler* profiler = world_->GetProfiler();
+	for (const auto& policy : policies_)
+	{
+		const std::string& policyLabel = "Policy " + std::to_string(policy.first);
+		for (const auto& costFunction : policy.second->getCostFunctions())
+			profiler->SetCostFunctionLabel(costFunction.first, policyLabel + ": " + costFunction.first->GetTypeName());
+
+		if (policy.second->getHaveSteps())
+		{
+			const auto& steps = policy.second->getSteps();
+			for (size_t i = 0; i < steps.size(); ++i)
+				for (const auto& costFunction : steps[i]->getCostFunctions())
+					profiler->SetCostFunctionLabel(costFunction.first, 
+						policyLabel + ", step " + std::to_string(i) + ": " + costFunction.first->GetTypeName());
+		}
+	}
+}
+
+void CrowdSimulator::SetTracingEnabled(bool enabled)
+{
+	world_->SetTracingEnabled(enabled);
+	if (!enabled)
+		return;
+
+	// name the runs of agents per policy
+	StepTracer* tracer = world_->GetTracer();
+	for (const auto& policy : policies_)
+		tracer->SetPolicyName(policy.second, "acceleration: Policy " + std::to_string(policy.first));
+}
+
 CrowdSimulator::~CrowdSimulator()
 {
-	// delete the CSV writer?
+	// delete the trajectory writer?
 	if (writer_ != nullptr)
 		delete writer_;
 
@@ -92,16 +191,22 @@ void CrowdSimulator::RunSimulationSteps(int nrSteps)
 	{
 		world_->DoStep();
 
-		if (writer_ != nullptr)
+		if (writer_ != nullptr && isOutputStep())
 		{
-			double t = world_->GetCurrentTime();
-			const auto& agents = world_->GetAgents();
-
-			AgentTrajectoryPoints data;
-			for (const Agent* agent : agents)
-				data[agent->getID()] = TrajectoryPoint(t, agent->getPosition(), agent->getViewingDirection());
+			StepTracer::Scope traceScope(world_->GetTracer(), StepTracer::WRITE_OUTPUT);
 
-			writer_->AppendAgentData(data);
+			// copy the agent data into a reusable buffer, using the world's threads; the writer handles the rest on another thread
+			const auto& agents = world_->GetAgents();
+			outputFrame_.time = world_->GetCurrentTime();
+			outputFrame_.Resize(agents.size());
+			world_->GetThreadPool().ParallelFor(agents.size(), [this, &agents](size_t j)
+			{
+				outputFrame_.agentIDs[j] = agents[j]->getID();
+				outputFrame_.positions[j] = agents[j]->getPosition();
+				outputFrame_.orientations[j] = agents[j]->getViewingDirection();
+			});
+
+			writer_->AppendFrame(outputFrame_);
 		}
 	}
 }
@@ -165,7 +270,10 @@ void CrowdSimulator::RunSimulationUntilEnd(bool showProgressBar, bool measureTim
 	}
 
 	if (writer_ != nullptr)
+	{
+		StepTracer::Scope traceScope(world_->GetTracer(), StepTracer::FLUSH_OUTPUT);
 		writer_->Flush();
+	}
 }
 
 #pragma region [Loading a configuration file]
@@ -237,6 +345,61 @@ bool CrowdSimulator::FromConfigFile_loadWorld(const tinyxml2::XMLElement* worldE
         }
     }
 
+	// load the spatial index for nearest-neighbor queries (optional; a KD tree by default)
+	const char* spatialIndex = worldElement->Attribute("spatial_index");
+	if (spatialIndex != nullptr)
+	{
+		SpatialIndex::Type spatialIndexType = SpatialIndex::StringToSpatialIndexType(spatialIndex);
+		if (spatialIndexType == SpatialIndex::Type::KD_TREE)
+		{
+			world_->SetSpatialIndex(new AgentKDTree());
+		}
+		else if (spatialIndexType == SpatialIndex::Type::UNIFORM_GRID)
+		{
+			float cellSize = 5;
+			worldElement->QueryFloatAttribute("cell_size", &cellSize);
+			if (cellSize <= 0)
+			{
+				std::cerr << "Error: Invalid cell_size specified for the grid in the XML file." << std::endl
+					<< "Make sure to specify a positive cell size." << std::endl;
+				return false;
+			}
+			world_->SetSpatialIndex(new AgentGrid(cellSize));
+			std::cout << "Using a uniform grid for nearest-neighbor queries, with cell size " << cellSize << "." << std::endl;
+		}
+		else
+		{
+			std::cerr << "Warning: Unknown spatial_index " << spatialIndex << " specified in the XML file. Using the default (KDTree)." << std::endl;
+		}
+	}
+
+	// reuse the results of neighbor queries in later steps, by enlarging their search radius with a skin (optional; disabled by default)
+	float neighborSkin = 0;
+	worldElement->QueryFloatAttribute("neighbor_skin", &neighborSkin);
+	if (neighborSkin < 0)
+	{
+		std::cerr << "Error: Invalid neighbor_skin specified in the XML file." << std::endl
+			<< "Make sure to specify a non-negative distance." << std::endl;
+		return false;
+	}
+	world_->SetNeighborSkin(neighborSkin);
+
+	// sort the agents by position every few steps, to improve memory locality (optional; disabled by default)
+	int reorderInterval = 0;
+	worldElement->QueryIntAttribute("reorder_interval", &reorderInterval);
+	if (reorderInterval < 0)
+	{
+		std::cerr << "Error: Invalid reorder_interval specified in the XML file." << std::endl
+			<< "Make sure to specify a non-negative number of steps." << std::endl;
+		return false;
+	}
+	world_->SetReorderInterval((size_t)reorderInterval);
+
+	// compute the contact between two agents once per pair of agents (optional; disabled by default)
+	bool symmetricContactForces = false;
+	worldElement->QueryBoolAttribute("symmetric_contact_forces", &symmetricContactForces);
+	world_->SetSymmetricContactForces(symmetricContactForces);
+
 	return true;
 }
 
@@ -325,6 +488,10 @@ bool CrowdSimulator::FromConfigFile_loadPoliciesBlock(const tinyxml2::XMLElement
 
 bool CrowdSimulator::FromConfigFile_loadAgentsBlock(const tinyxml2::XMLElement* xmlBlock)
 {
+	// if the block specifies a generator, create the generated agents first
+	if (xmlBlock->Attribute("generator") != nullptr && !FromConfigFile_generateAgents(xmlBlock))
+		return false;
+
 	// load the elements one by one
 	const tinyxml2::XMLElement* element = xmlBlock->FirstChildElement();
 	while (element != nullptr)
@@ -541,6 +708,53 @@ bool CrowdSimulator::FromConfigFile_loadSinglePolicy(const tinyxml2::XMLElement*
 	return true;
 }
 
+bool CrowdSimulator::FromConfigFile_generateAgents(const tinyxml2::XMLElement* agentsBlock)
+{
+	ScenarioGenerator::Settings settings;
+
+	// layout
+	const std::string& layoutName = agentsBlock->Attribute("generator");
+	if (!ScenarioGenerator::LayoutFromString(layoutName, settings.layout))
+	{
+		std::cerr << "Error: The agent generator " << layoutName << " does not exist." << std::endl
+			<< "Valid options are circle, crossing_flows, bidirectional_corridor, and random_dense." << std::endl;
+		return false;
+	}
+
+	// number of agents
+	unsigned int count = 0;
+	agentsBlock->QueryUnsignedAttribute("count", &count);
+	settings.count = count;
+
+	// policy
+	int policyID = -1;
+	agentsBlock->QueryIntAttribute("policy", &policyID);
+	settings.agentSettings.policy_ = GetPolicy(policyID);
+	if (settings.agentSettings.policy_ == nullptr)
+	{
+		std::cerr << "Error: The policy with id " << policyID << " for generated agents doesn't exist." << std::endl;
+		return false;
+	}
+
+	// optional agent parameters, with the same names as for single agents
+	agentsBlock->QueryFloatAttribute("rad", &settings.agentSettings.radius_);
+	agentsBlock->QueryFloatAttribute("pref_speed", &settings.agentSettings.preferred_speed_);
+	agentsBlock->QueryFloatAttribute("max_speed", &settings.agentSettings.max_speed_);
+	agentsBlock->QueryFloatAttribute("max_acceleration", &settings.agentSettings.max_acceleration_);
+	agentsBlock->QueryFloatAttribute("mass", &settings.agentSettings.mass_);
+	agentsBlock->QueryBoolAttribute("remove_at_goal", &settings.agentSettings.remove_at_goal_);
+
+	// optional layout parameters
+	agentsBlock->QueryFloatAttribute("center_x", &settings.center.x);
+	agentsBlock->QueryFloatAttribute("center_y", &settings.center.y);
+	agentsBlock->QueryFloatAttribute("spacing", &settings.spacing);
+	agentsBlock->QueryFloatAttribute("width", &settings.corridorWidth);
+	agentsBlock->QueryFloatAttribute("density", &settings.density);
+	agentsBlock->QueryUnsignedAttribute("seed", &settings.seed);
+
+	return ScenarioGenerator::Generate(world_.get(), settings);
+}
+
 bool CrowdSimulator::FromConfigFile_loadSingleAgent(const tinyxml2::XMLElement* agentElement)
 {
 	// optional ID
@@ -649,6 +863,10 @@ CrowdSimulator* CrowdSimulator::FromConfigFile(const std::string& filename)
 {
 	std::setlocale(LC_NUMERIC, "en_US.UTF-8");
 
+	// binary scenario files are loaded separately
+	if (BinaryScenario::IsBinaryFile(filename))
+		return FromBinaryFile(filename);
+
 	// Parse the XML into the property tree.
 	// If the path cannot be resolved, an exception is thrown.
 	tinyxml2::XMLDocument doc;
@@ -721,6 +939,14 @@ CrowdSimulator* CrowdSimulator::FromConfigFile(const std::string& filename)
 	float end_time = -1;
 	simulationElement->QueryFloatAttribute("end_time", &crowdsimulator->end_time_);
 
+	// how often the output should be recorded (optional; every step by default)
+	int outputStepInterval = 1;
+	float outputTimeInterval = 0;
+	simulationElement->QueryIntAttribute("output_step_interval", &outputStepInterval);
+	simulationElement->QueryFloatAttribute("output_time_interval", &outputTimeInterval);
+	crowdsimulator->SetOutputStepInterval(outputStepInterval);
+	crowdsimulator->SetOutputTimeInterval(outputTimeInterval);
+
 	//
 	// --- Read policies
 	//
@@ -800,3 +1026,152 @@ Policy* CrowdSimulator::GetPolicy(int id)
 		return nullptr;
 	return findIt->second;
 }
+
+CrowdSimulator* CrowdSimulator::FromBinaryFile(const std::string& filename)
+{
+	std::setlocale(LC_NUMERIC, "en_US.UTF-8");
+
+	MemoryMappedFile file;
+	if (!file.Open(filename))
+	{
+		std::cerr << "Error: Could not open binary scenario file at " << filename << std::endl;
+		return nullptr;
+	}
+
+	const BinaryScenario::Header* header = BinaryScenario::GetHeader(file);
+	if (header == nullptr)
+		return nullptr;
+
+	const char* data = file.GetData();
+	CrowdSimulator* crowdsimulator = new CrowdSimulator();
+	crowdsimulator->scenarioFilename_ = filename;
+
+	// the world, policies, and agent generator are stored as XML text
+	const auto& parseXML = [data](const BinaryScenario::Section& section, tinyxml2::XMLDocument& doc, const char* elementName)
+	{
+		if (section.count == 0 || doc.Parse(data + section.offset, (size_t)section.count) != tinyxml2::XML_SUCCESS)
+			return (const tinyxml2::XMLElement*)nullptr;
+		return (const tinyxml2::XMLElement*)doc.FirstChildElement(elementName);
+	};
+
+	//
+	// --- Read the world and simulation parameters
+	//
+
+	tinyxml2::XMLDocument worldDoc;
+	const tinyxml2::XMLElement* worldElement = parseXML(header->world, worldDoc, "World");
+	if (worldElement == nullptr || !crowdsimulator->FromConfigFile_loadWorld(worldElement))
+	{
+		std::cerr << "Error: Failed to load the world from the binary file" << std::endl;
+		delete crowdsimulator;
+		return nullptr;
+	}
+
+	if (header->deltaTime <= 0)
+	{
+		std::cerr << "Error: No valid value for delta_time found in the binary file." << std::endl;
+		delete crowdsimulator;
+		return nullptr;
+	}
+	crowdsimulator->GetWorld()->SetDeltaTime(header->deltaTime);
+	crowdsimulator->end_time_ = header->endTime;
+	crowdsimulator->SetOutputStepInterval(header->outputStepInterval);
+	crowdsimulator->SetOutputTimeInterval(header->outputTimeInterval);
+
+	//
+	// --- Read policies
+	//
+
+	tinyxml2::XMLDocument policiesDoc;
+	const tinyxml2::XMLElement* policiesElement = parseXML(header->policies, policiesDoc, "Policies");
+	if (policiesElement != nullptr && !crowdsimulator->FromConfigFile_loadPoliciesBlock(policiesElement))
+	{
+		std::cerr << "Error while loading policies. The simulation cannot be loaded." << std::endl;
+		delete crowdsimulator;
+		return nullptr;
+	}
+
+	if (!crowdsimulator->HasPolicies())
+	{
+		std::cerr
+			<< "Error: Failed to load any policies for the simulation." << std::endl
+			<< "A simulation needs a Policy block with at least one valid Policy element." << std::endl;
+		delete crowdsimulator;
+		return nullptr;
+	}
+
+	//
+	// --- Read agents
+	//
+
+	tinyxml2::XMLDocument generatorDoc;
+	const tinyxml2::XMLElement* generatorElement = parseXML(header->generator, generatorDoc, "Agents");
+	if (generatorElement != nullptr && !crowdsimulator->FromConfigFile_generateAgents(generatorElement))
+	{
+		std::cerr << "Error while generating agents. The simulation cannot be loaded." << std::endl;
+		delete crowdsimulator;
+		return nullptr;
+	}
+
+	WorldBase* world = crowdsimulator->GetWorld();
+	world->ReserveAgents((size_t)header->agents.count);
+
+	const BinaryScenario::AgentRecord* records = (const BinaryScenario::AgentRecord*)(data + header->agents.offset);
+	for (size_t i = 0; i < header->agents.count; ++i)
+	{
+		const BinaryScenario::AgentRecord& record = records[i];
+
+		Agent::Settings settings;
+		settings.radius_ = record.radius;
+		settings.preferred_speed_ = record.preferredSpeed;
+		settings.max_speed_ = record.maxSpeed;
+		settings.max_acceleration_ = record.maxAcceleration;
+		settings.mass_ = record.mass;
+		settings.remove_at_goal_ = record.removeAtGoal != 0;
+		settings.color_ = Color(record.color[0], record.color[1], record.color[2]);
+		settings.policy_ = crowdsimulator->GetPolicy(record.policyID);
+		if (settings.policy_ == nullptr)
+		{
+			std::cerr << "Error: The policy with id " << record.policyID << " doesn't exist." << std::endl;
+			delete crowdsimulator;
+			return nullptr;
+		}
+
+		const size_t agentID = (record.id == std::numeric_limits<uint64_t>::max() ? std::numeric_limits<size_t>::max() : (size_t)record.id);
+		Agent* agent = world->AddAgent(Vector2D(record.position[0], record.position[1]), settings, agentID, record.startTime);
+		agent->setGoal(Vector2D(record.goal[0], record.goal[1]));
+	}
+
+	if (world->GetAgents().empty())
+	{
+		std::cerr << "Warning: Failed to load any agents for the simulation." << std::endl
+			<< "The simulation will start without agents." << std::endl;
+	}
+
+	//
+	// --- Read obstacles
+	//
+
+	const uint32_t* obstacleSizes = (const uint32_t*)(data + header->obstacleSizes.offset);
+	const float* obstaclePoints = (const float*)(data + header->obstaclePoints.offset);
+	uint64_t pointIndex = 0;
+	for (size_t i = 0; i < header->obstacleSizes.count; ++i)
+	{
+		if (obstacleSizes[i] > header->obstaclePoints.count - pointIndex)
+		{
+			std::cerr << "Error: The obstacles in the binary file are damaged. The simulation cannot be loaded." << std::endl;
+			delete crowdsimulator;
+			return nullptr;
+		}
+
+		std::vector<Vector2D> points(obstacleSizes[i]);
+		for (Vector2D& point : points)
+		{
+			point = Vector2D(obstaclePoints[2 * pointIndex], obstaclePoints[2 * pointIndex + 1]);
+			++pointIndex;
+		}
+		world->AddObstacle(points);
+	}
+
+	return crowdsimulator;
+}
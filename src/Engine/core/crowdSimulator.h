@@ -32,10 +32,11 @@
 #include <core/policy.h>
 #include <core/worldBase.h>
 #include <core/agent.h>
+#include <tools/Trajectory.h>
 #include <map>
 #include <memory>
 
-class TrajectoryCSVWriter;
+class TrajectoryWriter;
 
 /// <summary>Wrapper object that manages the overall crowd simulation.</summary>
 class CrowdSimulator
@@ -45,8 +46,19 @@ private:
   /// <summary>The world in which the simulation takes place.</summary>
   std::unique_ptr<WorldBase> world_;
 
-  /// <summary>A pointer to an optional TrajectoryCSVWriter that can write the simulation output to CSV files.</summary>
-  TrajectoryCSVWriter* writer_;
+  /// <summary>A pointer to an optional TrajectoryWriter that can write the simulation output to CSV files or a binary file.</summary>
+  TrajectoryWriter* writer_;
+
+  /// <summary>A buffer for the positions and orientations of all agents in the current frame, 
+  /// reused in each step to pass the simulation output to writer_.</summary>
+  TrajectoryFrame outputFrame_;
+
+  /// <summary>The maximum number of bytes to use for buffered output, or 0 if there is no limit.</summary>
+  size_t outputMemoryBudget_;
+  /// <summary>The number of simulation steps between two recorded output frames.</summary>
+  int outputStepInterval_;
+  /// <summary>The simulation time between two recorded output frames, or 0 if outputStepInterval_ should be used instead.</summary>
+  float outputTimeInterval_;
 
   /// <summary>An optional time at which the simulation should end.
   /// Only used if this number is set in a configuration file.</summary>
@@ -61,10 +73,20 @@ private:
 public:
 
   /// <summary>Creates a new CrowdSimulator object by loading a given configuration file.</summary>
-  /// <remarks>Note: The caller of this method is responsible for deleting the resulting CrowdSimulator object.</remarks>
+  /// <remarks>The Agents element may use a generator instead of (or in addition to) a list of Agent elements, 
+  /// e.g. <c>&lt;Agents generator="circle" count="100000" policy="0" /&gt;</c>; see ScenarioGenerator for the available layouts.
+  /// Note: The caller of this method is responsible for deleting the resulting CrowdSimulator object.</remarks>
   /// <param name="filename">The name of the configuration file to load.</param>
   /// <returns>A pointer to new CrowdSimulator object, or nullptr if the loading failed for any reason.</returns>
   static CrowdSimulator* FromConfigFile(const std::string& filename);
+
+  /// <summary>Creates a new CrowdSimulator object by loading a binary scenario file (see BinaryScenario).
+  /// The file is mapped into memory, and its agents are created in bulk.</summary>
+  /// <remarks>FromConfigFile() calls this method automatically for binary files.
+  /// Note: The caller of this method is responsible for deleting the resulting CrowdSimulator object.</remarks>
+  /// <param name="filename">The name of the binary scenario file to load.</param>
+  /// <returns>A pointer to new CrowdSimulator object, or nullptr if the loading failed for any reason.</returns>
+  static CrowdSimulator* FromBinaryFile(const std::string& filename);
   
   /// <summary>Destroys this CrowdSimulator object.</summary>
   ~CrowdSimulator();
@@ -72,14 +94,53 @@ public:
   const std::string& GetScenarioFilename() const { return scenarioFilename_; }
 
   /// <summary>Prepares this CrowdSimulator for writing simulation output (as CSV files) to the given directory.</summary>
+  /// <remarks>The files are written on a background thread, so the simulation does not wait for them.</remarks>
   /// <param name="dirname">The name of the directory to use for output.</param>
   /// <param name="flushImmediately">Whether or not the CSV writer should write its output files as fast as possible. 
   /// If it is true, the output files will be updated after each simulation frame.
-  /// If it is false, the data to write will be cached, and files will be written when the CrowdSimulator gets destroyed.</param>
+  /// If it is false, the data to write will be cached (up to the memory budget; see SetOutputMemoryBudget()), 
+  /// and files will be written when the CrowdSimulator gets destroyed.</param>
   void StartCSVOutput(const std::string& dirname, bool flushImmediately);
 
+  /// <summary>Prepares this CrowdSimulator for writing simulation output to a single binary file (see TrajectoryBinaryWriter).
+  /// This is much faster than CSV output when there are many agents. The file is written on a background thread.</summary>
+  /// <param name="filename">The name of the file to use for output.</param>
+  /// <param name="flushImmediately">Whether or not the binary writer should write its output as fast as possible. 
+  /// If it is true, the output file will be updated after each simulation frame.
+  /// If it is false, the data to write will be cached (up to the memory budget; see SetOutputMemoryBudget()), 
+  /// and the file will be written when the CrowdSimulator gets destroyed.</param>
+  void StartBinaryOutput(const std::string& filename, bool flushImmediately);
+
+  /// <summary>Stops writing simulation output, after writing all output that is still buffered.</summary>
   void StopCSVOutput();
 
+  /// <summary>Limits the amount of memory used for buffered simulation output. 
+  /// When the buffered output exceeds this limit, it is spilled to the output files.</summary>
+  /// <param name="bytes">The maximum number of bytes to use for buffered output, or 0 (the default) to buffer without limits.</param>
+  void SetOutputMemoryBudget(size_t bytes);
+
+  /// <summary>Sets how often the simulation output should be recorded: once every k simulation steps. 
+  /// This setting is ignored if a time interval has been set via SetOutputTimeInterval().</summary>
+  /// <param name="nrSteps">The number of simulation steps between two recorded frames. The default value is 1, i.e. every step is recorded.</param>
+  void SetOutputStepInterval(int nrSteps);
+
+  /// <summary>Sets how often the simulation output should be recorded: once every T seconds of simulation time. 
+  /// In particular, the first step at or after each multiple of T is recorded.</summary>
+  /// <param name="seconds">The time between two recorded frames, or 0 to use the step interval instead (see SetOutputStepInterval()).</param>
+  void SetOutputTimeInterval(float seconds);
+
+  /// <summary>Enables or disables the profiling of simulation steps (see WorldBase::SetProfilingEnabled()).</summary>
+  /// <remarks>When profiling is enabled, all cost functions of all policies are registered in the profiler with a readable label, 
+  /// so that the profiler's report can show which policy each cost function belongs to.</remarks>
+  /// <param name="enabled">Whether or not to profile the simulation steps.</param>
+  void SetProfilingEnabled(bool enabled);
+
+  /// <summary>Enables or disables the tracing of simulation steps (see WorldBase::SetTracingEnabled()).</summary>
+  /// <remarks>When tracing is enabled, the tracer also records the time spent on writing trajectory output, 
+  /// and it shows the agents of each policy separately in the acceleration phase.</remarks>
+  /// <param name="enabled">Whether or not to trace the simulation steps.</param>
+  void SetTracingEnabled(bool enabled);
+
   /// <summary>Runs the given number of simulation steps.</summary>
   /// <param name="nrSteps">The number of simulation steps to run; should be at least 1, otherwise nothing happens.</param>
   void RunSimulationSteps(int nrSteps=1);
@@ -109,6 +170,9 @@ public:
 private:
 	CrowdSimulator();
 
+	/// <summary>Checks whether the output of the current simulation step should be recorded, according to the output interval.</summary>
+	bool isOutputStep() const;
+
 	bool FromConfigFile_loadWorld(const tinyxml2::XMLElement* worldElement);
 
 	bool FromConfigFile_loadPoliciesBlock_ExternallyOrNot(const tinyxml2::XMLElement* policiesBlock, const std::string& fileFolder);
@@ -119,6 +183,7 @@ private:
 	bool FromConfigFile_loadAgentsBlock_ExternallyOrNot(const tinyxml2::XMLElement* agentsBlock, const std::string& fileFolder);
 	bool FromConfigFile_loadAgentsBlock(const tinyxml2::XMLElement* agentsBlock);
 	bool FromConfigFile_loadSingleAgent(const tinyxml2::XMLElement* agentElement);
+	bool FromConfigFile_generateAgents(const tinyxml2::XMLElement* agentsBlock);
 
 	bool FromConfigFile_loadObstaclesBlock_ExternallyOrNot(const tinyxml2::XMLElement* obstaclesBlock, const std::string& fileFolder);
 	bool FromConfigFile_loadObstaclesBlock(const tinyxml2::XMLElement* obstaclesBlock);
@@ -48,6 +48,13 @@ float Policy::getInteractionRange() const
 	for (const auto& costFunction : cost_functions_)
 		range = std::max(range, costFunction.first->GetRange());
 
+	// a policy with steps needs the neighbors of all its steps
+	if (haveSteps)
+	{
+		for (const PolicyStep* step : policy_steps_)
+			range = std::max(range, step->getInteractionRange());
+	}
+
 	return range;
 }
 
@@ -83,13 +90,22 @@ float Policy::ComputeCostForVelocity(const Vector2D& velocity, Agent* agent, Wor
 	// compute the cost for this velocity
 	float totalCost = 0;
 	for (auto& costFunction : cost_functions_)
+	{
+		StepProfiler::CostFunctionTimer timer(world->GetProfiler(), costFunction.first, 1);
 		totalCost += costFunction.second * costFunction.first->GetCost(velocity, agent, world);
+	}
 
 	return totalCost;
 }
 
 //TODO:吴越洋1030添加
 void Policy::ComputeSPHDensity(Agent *agent, WorldBase *world, SPH::DensityData& res, SPH::DensityData& res_p) {
+    // the SPH cost function may live in one of the steps of this policy
+    if (haveSteps) {
+        for (PolicyStep* step : policy_steps_)
+            step->ComputeSPHDensity(agent, world, res, res_p);
+    }
+
     for (auto& costFunction: cost_functions_) {
         const SPH *sph = dynamic_cast<const SPH *>(costFunction.first);
         if (sph == nullptr) continue;
@@ -104,7 +120,10 @@ Vector2D Policy::getAccelerationFromGradient(Agent* agent, WorldBase * world)
 	// sum up the gradient of all cost functions
 	Vector2D TotalGradient(0, 0);
 	for (auto& costFunction : cost_functions_)
+	{
+		StepProfiler::CostFunctionTimer timer(world->GetProfiler(), costFunction.first, 0);
 		TotalGradient += costFunction.second * costFunction.first->GetGradientFromCurrentVelocity(agent, world);
+	}
 
 	// move in the opposite direction of this gradient
 	return -1 * TotalGradient;
@@ -116,9 +135,13 @@ Vector2D Policy::getBestVelocityGlobal(Agent* agent, WorldBase * world)
 	// because it requires a closed-form solution that has to be implemented per function.
 	// If no such closed-form solution is given (or if there are multiple cost functions), we have to resort to sampling.
 
-	return cost_functions_.size() == 1
-		? cost_functions_[0].first->GetGlobalMinimum(agent, world)
-		: getBestVelocitySampling(agent, world, SamplingParameters::ApproximateGlobalOptimization());
+	if (cost_functions_.size() == 1)
+	{
+		StepProfiler::CostFunctionTimer timer(world->GetProfiler(), cost_functions_[0].first, 0);
+		return cost_functions_[0].first->GetGlobalMinimum(agent, world);
+	}
+	
+	return getBestVelocitySampling(agent, world, SamplingParameters::ApproximateGlobalOptimization());
 }
 
 Vector2D Policy::getBestVelocitySampling(Agent* agent, WorldBase * world, const SamplingParameters& params)
@@ -126,7 +149,7 @@ Vector2D Policy::getBestVelocitySampling(Agent* agent, WorldBase * world, const
 	return CostFunction::ApproximateGlobalMinimumBySampling(agent, world, params, cost_functions_);
 }
 
-Vector2D Policy::ComputeContactForces(Agent* agent, WorldBase * world)
+Vector2D Policy::ComputeContactForces(Agent* agent, WorldBase * world, bool includeAgents)
 {
 	Vector2D totalForce(0, 0);
 	const Vector2D& position = agent->getPosition();
@@ -137,12 +160,15 @@ Vector2D Policy::ComputeContactForces(Agent* agent, WorldBase * world)
 		const auto& neighbors = agent->getNeighbors();
 
 		// check all colliding agents
-		for (const auto& neighborAgent : neighbors.first)
+		if (includeAgents)
 		{
-			const auto& diff = position - neighborAgent.GetPosition();
-			const float intersectionDistance = radius + neighborAgent.realAgent->getRadius() - diff.magnitude();
-			if (intersectionDistance > 0)
-				totalForce += diff.getnormalized() * (contactForceScale_ * intersectionDistance);
+			for (const auto& neighborAgent : neighbors.first)
+			{
+				const auto& diff = position - neighborAgent.GetPosition();
+				const float intersectionDistance = radius + neighborAgent.GetRadius() - diff.magnitude();
+				if (intersectionDistance > 0)
+					totalForce += diff.getnormalized() * (contactForceScale_ * intersectionDistance);
+			}
 		}
 
 		// check all colliding obstacles
@@ -125,7 +125,7 @@ public:
 	static bool OptimizationMethodFromString(const std::string &method, OptimizationMethod& result);
 
 private:
-    bool haveSteps;
+    bool haveSteps = false;
     PolicyStepList policy_steps_;
     std::map<int, PolicyStep*> policy_steps_map_;
 	/// <summary>A weighted list of cost functions used by this Policy.</summary>
@@ -170,7 +170,9 @@ public:
 	/// This force is already scaled by the scaling factor stored in this Policy.</summary>
 	/// <param name="agent">The agent for which a new velocity should be computed.</param>
 	/// <param name="world">The world in which the simulation takes place.</param>
-	Vector2D ComputeContactForces(Agent* agent, WorldBase* world);
+	/// <param name="includeAgents">Whether to include the forces with neighboring agents. 
+	/// Use false if the agent computes these itself, e.g. once per pair of agents (see Agent::ComputeContactForces()).</param>
+	Vector2D ComputeContactForces(Agent* agent, WorldBase* world, bool includeAgents = true);
 
     //TODO:吴越洋1030添加
     void ComputeSPHDensity(Agent* agent, WorldBase* world, SPH::DensityData& res, SPH::DensityData& res_p);
@@ -187,12 +189,15 @@ public:
         return cost_functions_.size();
     }
 
+    /// <summary>Returns the weighted list of cost functions used by this Policy (excluding those of its steps).</summary>
+    inline const CostFunctionList& getCostFunctions() const { return cost_functions_; }
+
     size_t GetNumberOfPolicySteps() const {
         return policy_steps_map_.size();
     }
 
 	/// <summary>Finds and returns the range of interaction of this policy.</summary>
-	/// <remarks>This is the largest "range" value among all cost functions in this policy.
+	/// <remarks>This is the largest "range" value among all cost functions in this policy (and in all of its steps, if it has any).
 	/// It is the radius (in meters) that the agent should use for its nearest-neighbor query.</remarks>
 	float getInteractionRange() const;
 
@@ -207,6 +212,8 @@ public:
     inline void setContactForceScale(float s) {
         contactForceScale_ = s;
     }
+	/// <summary>Returns the scaling factor that this Policy applies to contact forces.</summary>
+	inline float getContactForceScale() const { return contactForceScale_; }
 
     inline bool getHaveSteps() const {
         return haveSteps;
@@ -27,9 +27,12 @@
 */
 
 #include <core/worldBase.h>
-#include <omp.h>
+#include <core/AgentKDTree.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
 
-using namespace nanoflann;
 using namespace std;
 
 WorldBase::Type WorldBase::StringToWorldType(const std::string& type)
@@ -47,47 +50,96 @@ WorldBase::Type WorldBase::StringToWorldType(const std::string& type)
 WorldBase::WorldBase(WorldBase::Type type) : type_(type)
 {
 	time_ = 0;
-	agentKDTree = nullptr;
+	stepNumber_ = 0;
+	spatialIndex_ = new AgentKDTree();
+	reorderInterval_ = 0;
+	stepsUntilReordering_ = 0;
+	neighborSkin_ = 0;
+	neighborCandidatesValid_ = false;
+	reuseNeighborCandidates_ = false;
+	spatialIndexUpToDate_ = false;
+	symmetricContactForces_ = false;
+	profiler_ = nullptr;
+	tracer_ = nullptr;
 	SetNumberOfThreads(1);
 	nextUnusedAgentID = 0;
 }
 
 void WorldBase::SetNumberOfThreads(int nrThreads)
 {
-	omp_set_num_threads(nrThreads);
+	threadPool_.SetNumberOfThreads(nrThreads);
 }
 
-void WorldBase::computeNeighboringAgents_Flat(const Vector2D& position, float search_radius, const Agent* queryingAgent, std::vector<const Agent*>& result) const
+void WorldBase::SetProfilingEnabled(bool enabled)
 {
-	// get the IDs of neighbors
-	const auto& agentIDs = agentKDTree->FindAllAgentsInRange(position, search_radius, queryingAgent);
+	if (enabled && profiler_ == nullptr)
+		profiler_ = new StepProfiler();
+	else if (!enabled)
+	{
+		delete profiler_;
+		profiler_ = nullptr;
+	}
+}
 
-	// convert them to agent pointers
-	result.resize(agentIDs.size());
-	for (int i = 0; i < agentIDs.size(); ++i)
-		result[i] = GetAgent_const(agentIDs[i]);
+void WorldBase::SetTracingEnabled(bool enabled)
+{
+	if (enabled && tracer_ == nullptr)
+		tracer_ = new StepTracer();
+	else if (!enabled)
+	{
+		delete tracer_;
+		tracer_ = nullptr;
+	}
 }
 
-void WorldBase::computeNeighboringObstacles_Flat(const Vector2D& position, float search_radius, std::vector<LineSegment2D>& result) const
+void WorldBase::SetSpatialIndex(SpatialIndex* spatialIndex)
 {
-	// TODO: implement more efficient neighbor search for obstacles
-	const float radiusSquared = search_radius * search_radius;
+	delete spatialIndex_;
+	spatialIndex_ = spatialIndex;
+	neighborCandidatesValid_ = false;
+}
 
-	// loop over all obstacle edges
-	for (const auto& obs : obstacles_)
+void WorldBase::SetReorderInterval(size_t interval)
+{
+	reorderInterval_ = interval;
+	stepsUntilReordering_ = 0;
+}
+
+void WorldBase::SetNeighborSkin(float skin)
+{
+	neighborSkin_ = std::max(skin, 0.0f);
+	neighborCandidatesValid_ = false;
+}
+
+void WorldBase::computeNeighboringAgents_Flat(const Vector2D& position, float search_radius, const Agent* queryingAgent, std::vector<SpatialIndex::Entry>& result) const
+{
+	// the spatial index returns pointers to the agents directly, so no lookups by ID are needed here
+	spatialIndex_->FindAllAgentsInRange(position, search_radius, queryingAgent, result);
+
+	if (profiler_ != nullptr)
+		profiler_->AddNeighborQuery(result.size());
+}
+
+void WorldBase::RefreshSpatialIndex()
+{
+	// the agents may have moved since the spatial index was last built
+	if (!spatialIndexUpToDate_)
 	{
-		for (const auto& edge : obs.GetEdges())
-		{
-			// if this line segment is clsoe enough, add it to the result
-			if (distanceToLineSquared(position, edge.first, edge.second, true) <= radiusSquared)
-				result.push_back(edge);
-		}
+		DoStep_UpdateSpatialIndex();
+		spatialIndexUpToDate_ = true;
 	}
 }
 
+void WorldBase::computeNeighboringObstacles_Flat(const Vector2D& position, float search_radius, std::vector<LineSegment2D>& result) const
+{
+	obstacleBVH_.FindAllSegmentsInRange(position, search_radius, result);
+}
+
 void WorldBase::DoStep()
 {
 	// Before the simulation frame begins, add agents that need to be added now
+	++stepNumber_;
+	startPhase(StepProfiler::INSERTION);
 	while (!agentsToAdd.empty() && agentsToAdd.top().second <= time_)
 	{
 		addAgentToList(agentsToAdd.top().first);
@@ -95,58 +147,333 @@ void WorldBase::DoStep()
 	}
 	
 	// --- Main simulation tasks:
-	// 1. build the KD tree for nearest-neighbor computations
-	if (agentKDTree != nullptr)
-		delete agentKDTree;
-	agentKDTree = new AgentKDTree(agents_);
-
-	int n = (int)agents_.size();
-
-// These missions processed in ComputeAcceleration
-    // 2. compute nearest neighbors for each agent
-// #pragma omp parallel for
-//     for (int i = 0; i < n; ++i)
-// 		agents_[i]->ComputeNeighbors(this);
-
-// 	// 3. compute a preferred velocity for each agent
-// #pragma omp parallel for
-// 	for (int i = 0; i < n; ++i)
-// 		agents_[i]->ComputePreferredVelocity();
-
-    // TODO:吴越洋1030添加，计算SPH密度
-#pragma omp parallel for
-    for (int i = 1; i < n; ++i)
-        agents_[i]->ComputeSPHDensity(this);
-
-	// 4. perform local navigation for each agent, to compute an acceleration vector for them
-#pragma omp parallel for
-	for (int i = 0; i < n; ++i)
-		agents_[i]->ComputeAcceleration(this);
-
-	// 5. compute contact forces for all agents
-#pragma omp parallel for
-	for (int i = 0; i < n; ++i)
-		agents_[i]->ComputeContactForces(this);
-
-	// 6. move all agents to their new positions
-	DoStep_MoveAllAgents();
+	// The step consists of a few parallel loops over all agents, separated by barriers.
+	// Passes whose results are not needed by other agents in the same loop are fused into one loop (see forAllAgentsFused()).
+
+	// 1. update the spatial index for nearest-neighbor computations, and include new obstacles (if any) in the obstacle hierarchy;
+	//    these two structures are independent, so they are built at the same time.
+	//    If the agents can still use their neighbor candidates, no queries are performed in this step, so the spatial index is not needed.
+	//    Before this, sort the agents by position if it is time to do so.
+	startPhase(StepProfiler::SPATIAL_INDEX);
+	if (reorderInterval_ > 0)
+	{
+		if (stepsUntilReordering_ == 0)
+		{
+			reorderAgents();
+			stepsUntilReordering_ = reorderInterval_;
+		}
+		--stepsUntilReordering_;
+	}
+	reuseNeighborCandidates_ = canReuseNeighborCandidates();
+	if (!reuseNeighborCandidates_)
+	{
+		threadPool_.ParallelFor(2, [this](size_t task)
+		{
+			if (task == 0)
+				DoStep_UpdateSpatialIndex();
+			else
+				obstacleBVH_.Build();
+		});
+		spatialIndexUpToDate_ = true;
+	}
+
+	const size_t n = agents_.size();
+
+	// 2. compute nearest neighbors for each agent
+	//    (a single query per agent, at the largest range of its policy; policy steps filter this result by their own range);
+	//    each thread collects the results of its own agents, and these are then copied to one buffer in the order of the agents
+	startNeighborSearch();
+	const auto& findNeighbors = [this](Agent* agent) { this->findNeighbors(agent); };
+	forAllAgentsFused(agentPass(StepProfiler::NEIGHBOR_SEARCH, findNeighbors));
+	finishNeighborSearch();
+	if (neighborSkin_ > 0)
+		neighborCandidatesValid_ = true;
+
+	// 3. store the neighbors of each agent, and compute SPH densities, which only use the agent's own neighbors and their positions and masses
+	const auto& storeNeighbors = [this](Agent* agent) { this->storeNeighbors(agent); };
+	const auto& computeDensity = [this](Agent* agent) { agent->ComputeSPHDensity(this); };
+	forAllAgentsFused(agentPass(StepProfiler::NEIGHBOR_SEARCH, storeNeighbors), agentPass(StepProfiler::SPH_DENSITY, computeDensity));
+
+	// 4. perform local navigation for each agent, to compute an acceleration vector for them, and compute contact forces for all agents;
+	//    both depend on the positions, velocities, and densities of the neighbors, but not on each other's results.
+	//    If contacts are computed once per pair of agents, the forces for the neighbors go to a buffer of the current thread.
+	const auto& computeAcceleration = [this](Agent* agent)
+	{
+		// show the agents of each policy separately in the trace
+		if (tracer_ != nullptr)
+			tracer_->SwitchPolicyRun(agent->getPolicy());
+		agent->ComputeAcceleration(this);
+	};
+
+	if (symmetricContactForces_)
+		prepareReactionForces();
+	const auto& computeContactForces = [this](Agent* agent)
+	{
+		agent->ComputeContactForces(this, symmetricContactForces_ ? reactionForces_[ThreadPool::GetCurrentThreadIndex()].data() : nullptr);
+	};
+	forAllAgentsFused(agentPass(StepProfiler::ACCELERATION, computeAcceleration), agentPass(StepProfiler::CONTACT_FORCES, computeContactForces));
+
+	// 5. move all agents to their new positions (after adding the contact forces from the other threads, if any), 
+	//    and check which agents should be removed
+	agentsToRemove_.resize(n);
+	const auto& moveAgent = [this](Agent* agent)
+	{
+		if (symmetricContactForces_)
+			addReactionForces(agent);
+		DoStep_MoveAgent(agent);
+		agentsToRemove_[agent->getIndex()] = agent->getRemoveAtGoal() && agent->hasReachedGoal();
+	};
+	forAllAgentsFused(agentPass(StepProfiler::INTEGRATION, moveAgent));
 	
 	// --- End of main simulation tasks.
 
+	// the agents have moved, so the spatial index is outdated
+	spatialIndexUpToDate_ = false;
+
 	// increase the time that has passed
 	time_ += delta_time_;
 
 	// remove agents who have reached their goal
-	for (int i = n-1; i >= 0; --i)
-		if (agents_[i]->getRemoveAtGoal() && agents_[i]->hasReachedGoal())
+	startPhase(StepProfiler::REMOVAL);
+	const size_t nrAgentsBeforeRemoval = agents_.size();
+	for (size_t i = n; i-- > 0; )
+		if (agentsToRemove_[i])
 			removeAgentAtListIndex(i);
+	if (agents_.size() < nrAgentsBeforeRemoval)
+		clearNeighbors();
+
+	endStep();
+}
+
+/// <summary>Computes the position of a point along a Hilbert curve that fills a grid of 2^16 by 2^16 cells.</summary>
+/// <param name="x">The column of the point in the grid.</param>
+/// <param name="y">The row of the point in the grid.</param>
+/// <returns>The index of the grid cell along the curve.</returns>
+static uint32_t hilbertIndex(uint32_t x, uint32_t y)
+{
+	uint32_t index = 0;
+	for (uint32_t s = 1u << 15; s > 0; s >>= 1)
+	{
+		const uint32_t rx = (x & s) > 0 ? 1 : 0;
+		const uint32_t ry = (y & s) > 0 ? 1 : 0;
+		index += s * s * ((3 * rx) ^ ry);
+
+		// rotate the quadrant, so that the curve is continuous
+		if (ry == 0)
+		{
+			if (rx == 1)
+			{
+				x = s - 1 - (x & (s - 1));
+				y = s - 1 - (y & (s - 1));
+			}
+			std::swap(x, y);
+		}
+	}
+	return index;
+}
+
+void WorldBase::reorderAgents()
+{
+	const size_t n = agents_.size();
+	if (n < 2)
+		return;
+
+	// compute the bounding box of all agents
+	float minX = std::numeric_limits<float>::max(), minY = minX;
+	float maxX = std::numeric_limits<float>::lowest(), maxY = maxX;
+	for (const Agent* agent : agents_)
+	{
+		// positions that are not finite (e.g. due to a diverging simulation) will end up at the end of the curve
+		const Vector2D& pos = agent->getPosition();
+		if (!std::isfinite(pos.x) || !std::isfinite(pos.y))
+			continue;
+		minX = std::min(minX, pos.x); maxX = std::max(maxX, pos.x);
+		minY = std::min(minY, pos.y); maxY = std::max(maxY, pos.y);
+	}
+	if (minX > maxX)
+		return;
+
+	// compute the position of each agent along a Hilbert curve through this box
+	const float gridSize = 65535.0f;
+	const float scale = gridSize / std::max({ maxX - minX, maxY - minY, 1e-6f });
+	reorderKeys_.resize(n);
+	threadPool_.ParallelFor(n, [&](size_t i)
+	{
+		const Vector2D& pos = agents_[i]->getPosition();
+		if (std::isfinite(pos.x) && std::isfinite(pos.y))
+		{
+			const uint32_t x = (uint32_t)std::min((pos.x - minX) * scale, gridSize);
+			const uint32_t y = (uint32_t)std::min((pos.y - minY) * scale, gridSize);
+			reorderKeys_[i] = { hilbertIndex(x, y), i };
+		}
+		else
+			reorderKeys_[i] = { std::numeric_limits<uint32_t>::max(), i };
+	});
+
+	// sort the agents along the curve; agents in the same cell keep their current order
+	std::sort(reorderKeys_.begin(), reorderKeys_.end());
+	std::vector<size_t> order(n);
+	for (size_t i = 0; i < n; ++i)
+		order[i] = reorderKeys_[i].second;
+
+	// move the per-step data of all agents, and then the agents themselves
+	agentStates_.Reorder(order, threadPool_);
+	std::vector<Agent*> agents(n);
+	threadPool_.ParallelFor(n, [&](size_t i)
+	{
+		agents[i] = agents_[order[i]];
+
+		// this only changes the value of an existing map entry, so it can be done in parallel
+		agentPositionsInVector.find(agents[i]->getID())->second = i;
+	});
+	agents_.swap(agents);
+
+	// the neighbor candidates of all agents refer to the old indices
+	neighborCandidatesValid_ = false;
 }
 
-void WorldBase::DoStep_MoveAllAgents()
+bool WorldBase::canReuseNeighborCandidates()
 {
-#pragma omp parallel for
-	for (int i = 0; i < (int)agents_.size(); i++)
-		agents_[i]->UpdateVelocityAndPosition(this);
+	if (neighborSkin_ <= 0 || !neighborCandidatesValid_)
+		return false;
+
+	// the candidates of all agents are complete if no agent has moved more than half the skin since they were computed
+	std::atomic<bool> expired(false);
+	threadPool_.ParallelFor(agents_.size(), [this, &expired](size_t i)
+	{
+		if (agents_[i]->NeedsNewNeighborCandidates(neighborSkin_))
+			expired.store(true, std::memory_order_relaxed);
+	});
+	return !expired.load();
+}
+
+void WorldBase::startNeighborSearch()
+{
+	const size_t n = agents_.size();
+	neighborAgentOffsets_.assign(n + 1, 0);
+	neighborObstacleOffsets_.assign(n + 1, 0);
+	stagedNeighbors_.resize(n);
+
+	// keep the memory of each thread's results, because they will be filled again in the same way
+	neighborStaging_.resize(threadPool_.GetNumberOfThreads());
+	for (NeighborStaging& staging : neighborStaging_)
+	{
+		staging.results.first.clear();
+		staging.results.second.clear();
+	}
+}
+
+void WorldBase::findNeighbors(Agent* agent)
+{
+	const int thread = ThreadPool::GetCurrentThreadIndex();
+	NeighborStaging& staging = neighborStaging_[thread];
+
+	// remember where the results will be stored
+	const size_t index = agent->getIndex();
+	stagedNeighbors_[index] = { thread, staging.results.first.size(), staging.results.second.size() };
+
+	// write the result directly after the results of the previous agents of this thread
+	if (neighborSkin_ <= 0)
+		agent->ComputeNeighbors(this, staging.results);
+	else
+	{
+		if (!reuseNeighborCandidates_)
+			agent->ComputeNeighborCandidates(this, neighborSkin_, staging.candidates);
+		agent->ComputeNeighborsFromCandidates(staging.results);
+	}
+
+	// remember how many neighbors there are
+	neighborAgentOffsets_[index + 1] = staging.results.first.size() - stagedNeighbors_[index].agentsBegin;
+	neighborObstacleOffsets_[index + 1] = staging.results.second.size() - stagedNeighbors_[index].obstaclesBegin;
+}
+
+void WorldBase::finishNeighborSearch()
+{
+	// convert the number of neighbors per agent to offsets
+	const size_t n = agents_.size();
+	for (size_t i = 0; i < n; ++i)
+	{
+		neighborAgentOffsets_[i + 1] += neighborAgentOffsets_[i];
+		neighborObstacleOffsets_[i + 1] += neighborObstacleOffsets_[i];
+	}
+
+	neighborAgents_.resize(neighborAgentOffsets_[n]);
+	neighborObstacles_.resize(neighborObstacleOffsets_[n]);
+}
+
+void WorldBase::storeNeighbors(Agent* agent)
+{
+	const size_t index = agent->getIndex();
+	const StagedNeighbors& staged = stagedNeighbors_[index];
+	const NeighborList& results = neighborStaging_[staged.thread].results;
+
+	const size_t agentsBegin = neighborAgentOffsets_[index], nrAgents = neighborAgentOffsets_[index + 1] - agentsBegin;
+	std::copy(results.first.begin() + staged.agentsBegin, results.first.begin() + staged.agentsBegin + nrAgents, neighborAgents_.begin() + agentsBegin);
+
+	const size_t obstaclesBegin = neighborObstacleOffsets_[index], nrObstacles = neighborObstacleOffsets_[index + 1] - obstaclesBegin;
+	std::copy(results.second.begin() + staged.obstaclesBegin, results.second.begin() + staged.obstaclesBegin + nrObstacles, neighborObstacles_.begin() + obstaclesBegin);
+
+	agent->neighbors_ = NeighborView(Span<PhantomAgent>(neighborAgents_.data() + agentsBegin, nrAgents), 
+		Span<LineSegment2D>(neighborObstacles_.data() + obstaclesBegin, nrObstacles));
+}
+
+void WorldBase::prepareReactionForces()
+{
+	// the existing elements are zero, because addReactionForces() clears them
+	reactionForces_.resize(threadPool_.GetNumberOfThreads());
+	for (auto& forces : reactionForces_)
+		forces.resize(agents_.size());
+}
+
+void WorldBase::addReactionForces(Agent* agent)
+{
+	const size_t index = agent->getIndex();
+	for (auto& forces : reactionForces_)
+	{
+		agent->next_contact_forces_ += forces[index];
+		forces[index] = Vector2D(0, 0);
+	}
+}
+
+void WorldBase::startPhase(StepProfiler::Phase phase)
+{
+	if (profiler_ != nullptr)
+		profiler_->StartPhase(phase, threadPool_.GetNumberOfThreads());
+
+	if (tracer_ != nullptr)
+	{
+		// end the event of the previous phase, or start the event of a new step
+		if (phase != StepProfiler::INSERTION)
+			tracer_->EndEvent();
+		else
+		{
+			tracer_->PrepareThreads(threadPool_.GetNumberOfThreads());
+			tracer_->BeginEvent(StepTracer::STEP);
+		}
+		tracer_->BeginEvent(phase);
+	}
+}
+
+void WorldBase::endStep()
+{
+	if (profiler_ != nullptr)
+		profiler_->EndStep();
+
+	if (tracer_ != nullptr)
+	{
+		tracer_->EndEvent(); // the last phase
+		tracer_->EndEvent(); // the step
+	}
+}
+
+void WorldBase::DoStep_UpdateSpatialIndex()
+{
+	spatialIndex_->Update(agents_);
+}
+
+void WorldBase::DoStep_MoveAgent(Agent* agent)
+{
+	agent->UpdateVelocityAndPosition(this);
 }
 
 #pragma region [Finding, adding, and removing agents]
@@ -182,8 +509,10 @@ Agent* WorldBase::AddAgent(const Vector2D& position, const Agent::Settings& sett
 	else // determine a good ID automatically
 		agentID = nextUnusedAgentID;
 
-	// create the agent and set its position
-	Agent* agent = new Agent(agentID, settings);
+	// create the agent and set its position;
+	// its data is stored along with the active agents or the scheduled agents, depending on when it will be added
+	const bool addNow = startTime <= time_;
+	Agent* agent = new Agent(agentID, settings, addNow ? &agentStates_ : &scheduledAgentStates_);
 	agent->setPosition(position);
 
 	// if the new ID is the highest one so far, update the next available ID
@@ -191,7 +520,7 @@ Agent* WorldBase::AddAgent(const Vector2D& position, const Agent::Settings& sett
 		nextUnusedAgentID = agentID + 1;
 
 	// if desired, add the agent immediately
-	if (startTime <= time_)
+	if (addNow)
 		addAgentToList(agent);
 
 	// otherwise, schedule the agent for insertion at a later time
@@ -203,9 +532,25 @@ Agent* WorldBase::AddAgent(const Vector2D& position, const Agent::Settings& sett
 
 void WorldBase::addAgentToList(Agent* agent)
 {
+	// if the agent was scheduled, move its data to the store of active agents
+	if (agent->states_ == &scheduledAgentStates_)
+		scheduledAgentStates_.MoveTo(agent->stateSlot_, agentStates_);
+
 	// add the agent to the list, and store where in the list it is located
 	agentPositionsInVector[agent->getID()] = agents_.size();
 	agents_.push_back(agent);
+
+	// the neighbor candidates of other agents (and the spatial index) do not include this agent yet
+	neighborCandidatesValid_ = false;
+	spatialIndexUpToDate_ = false;
+}
+
+void WorldBase::ReserveAgents(size_t nrAgents)
+{
+	const size_t capacity = agents_.size() + nrAgents;
+	agents_.reserve(capacity);
+	agentStates_.Reserve(capacity);
+	agentPositionsInVector.reserve(capacity);
 }
 
 bool WorldBase::RemoveAgent(size_t id)
@@ -216,16 +561,25 @@ bool WorldBase::RemoveAgent(size_t id)
 		return false;
 
 	removeAgentAtListIndex(positionInList->second);
+	clearNeighbors();
 	return true;
 }
 
 void WorldBase::removeAgentAtListIndex(size_t index)
 {
 	const auto removedAgentID = agents_[index]->getID();
+
+	// the neighbor candidates of other agents (and the spatial index) may refer to this agent
+	neighborCandidatesValid_ = false;
+	spatialIndexUpToDate_ = false;
+
+	// remove the agent's data; the store moves the data of the last agent to this slot, just like we do below
+	agentStates_.Remove(index);
 	
 	// if the agent is at the end of the list, simply remove it
 	if (index + 1 == agents_.size())
 	{
+		delete agents_[index];
 		agents_.pop_back();
 		agentPositionsInVector.erase(removedAgentID);
 	}
@@ -249,18 +603,34 @@ void WorldBase::removeAgentAtListIndex(size_t index)
 	}
 }
 
+void WorldBase::clearNeighbors()
+{
+	for (Agent* agent : agents_)
+	{
+		agent->neighbors_ = NeighborView();
+		agent->stepNeighbors_.first.clear();
+		agent->stepNeighbors_.second.clear();
+		agent->useStepNeighbors_ = false;
+	}
+}
+
 #pragma endregion
 
 void WorldBase::AddObstacle(const std::vector<Vector2D>& points)
 {
 	obstacles_.push_back(Polygon2D(points));
+
+	// the hierarchy of obstacle edges will be rebuilt (only once) at the start of the next simulation step
+	obstacleBVH_.AddSegments(obstacles_.back().GetEdges());
+	neighborCandidatesValid_ = false;
 }
 
 WorldBase::~WorldBase()
 {
-	// delete the KD tree
-	if (agentKDTree != nullptr)
-		delete agentKDTree;
+	// delete the spatial index, the profiler, and the tracer
+	delete spatialIndex_;
+	delete profiler_;
+	delete tracer_;
 
 	// delete all agents
 	for (Agent* agent : agents_)
@@ -30,54 +30,68 @@
 #define LIB_WORLD_BASE_H
 
 #include <tools/Polygon2D.h>
+#include <tools/SegmentBVH.h>
 #include <core/agent.h>
-#include <core/AgentKDTree.h>
+#include <core/SpatialIndex.h>
+#include <core/StepProfiler.h>
+#include <core/StepTracer.h>
+#include <core/ThreadPool.h>
 
+#include <cstdint>
 #include <queue>
 #include <unordered_map>
 typedef std::unordered_map<size_t, size_t> AgentIDMap;
 
 /// <summary>A reference to an agent in the simulation, possibly with a transposed position.
 /// Nearest-neighbor queries in WorldBase return results of this type.</summary>
+/// <remarks>A PhantomAgent stores the index of the agent in the world's AgentStateStore, and a copy of the data that most neighbor loops need 
+/// (position, velocity, radius, and distance to the query position), so that these loops do not have to visit the neighboring Agent objects.
+/// This copy is made when the neighbors are computed; the velocity and position of agents do not change until the end of the simulation step.
+/// Use Agent::getNeighborAgent() or WorldBase::GetAgents() for the rare cases that need the neighboring Agent itself.</remarks>
 struct PhantomAgent
 {
 private:
-	/// <summary>The amount by which the neighboring Agent's position should be offset, e.g. to account for wrap-around in a toric world.</summary>
-	Vector2D positionOffset;
 	Vector2D position;
+	Vector2D velocity;
+	float radius;
 	float distSqr;
+	uint32_t index;
 
 public:
-	/// <summary>A pointer to the original Agent in the simulation.</summary>
-	const Agent* realAgent;
-
 	/// <summary>Creates a PhantomAgent with the given details.</summary>
 	/// <param name="agent">A pointer to the original Agent in the simulation.</param>
 	/// <param name="queryPosition">The query position used for finding neighbors; used for precomputing the distance to this PhantomAgent.</param>
 	/// <param name="posOffset">The amount by which the neighboring Agent's position should be offset, e.g. to account for wrap-around in a toric world.</param>
 	PhantomAgent(const Agent* agent, const Vector2D& queryPosition, const Vector2D& posOffset)
-		: realAgent(agent), positionOffset(posOffset) 
+		: position(agent->getPosition() + posOffset), velocity(agent->getVelocity()), radius(agent->getRadius()), index((uint32_t)agent->getIndex())
 	{
-		UpdatePositionAndDistance(queryPosition);
+		distSqr = distanceSquared(queryPosition, position);
 	}
 
-	PhantomAgent() : realAgent(nullptr) {}
+	/// <summary>Creates a PhantomAgent with the given (already translated) position, velocity, and radius.</summary>
+	/// <param name="agentIndex">The index of the original Agent in the simulation.</param>
+	/// <param name="agentPosition">The position of the agent, translated by the desired offset.</param>
+	/// <param name="agentVelocity">The velocity of the agent.</param>
+	/// <param name="agentRadius">The radius of the agent.</param>
+	/// <param name="queryPosition">The query position used for finding neighbors; used for precomputing the distance to this PhantomAgent.</param>
+	PhantomAgent(uint32_t agentIndex, const Vector2D& agentPosition, const Vector2D& agentVelocity, float agentRadius, const Vector2D& queryPosition)
+		: position(agentPosition), velocity(agentVelocity), radius(agentRadius), index(agentIndex)
+	{
+		distSqr = distanceSquared(queryPosition, position);
+	}
+
+	PhantomAgent() : radius(0), distSqr(0), index(0) {}
 
+	/// <summary>Returns the index of this neighboring agent in the simulation, i.e. the value of Agent::getIndex().</summary>
+	inline uint32_t GetIndex() const { return index; }
 	/// <summary>Returns the (precomputed) position of this neighboring agent, translated by the offset of this PhantomAgent.</summary>
-	inline Vector2D GetPosition() const { return position; }
+	inline const Vector2D& GetPosition() const { return position; }
 	/// <summary>Returns the velocity of this neighboring agent.</summary>
-	inline Vector2D GetVelocity() const { return realAgent->getVelocity(); }
+	inline const Vector2D& GetVelocity() const { return velocity; }
+	/// <summary>Returns the radius of this neighboring agent.</summary>
+	inline float GetRadius() const { return radius; }
 	/// <summary>Returns the (precomputed) squared distance from this PhantomAgent to the query position that was used to find it.</summary>
 	inline float GetDistanceSquared() const { return distSqr; }
-
-	/// <summary>Pre-computes (or re-computes) the translated position of this PhantomAgent, as well as its distance to a query point.
-	/// Use this method if you want to correct the PhantomAgent's data in a new frame, without having search the AgentKDTree again.</summary>
-	inline void UpdatePositionAndDistance(const Vector2D& queryPosition)
-	{
-		position = realAgent->getPosition() + positionOffset;
-		distSqr = distanceSquared(queryPosition, position);
-	}
-
 };
 
 /// <summary>An abstract class describing a world in which a simulation can take place.</summary>
@@ -108,7 +122,7 @@ private:
 	/// <summary>A mapping from agent IDs to positions in the agents_ list.</summary>
 	/// <remarks>Because agents can be removed during the simulation, the ID of an agent is not necessarily the same 
 	/// as its position in the list. This is why we need this extra administration.
-	/// (We could also put all agents directly in a map, but then we could not loop over the agents in parallel with OpenMP.)</remarks>
+	/// (We could also put all agents directly in a map, but then we could not loop over the agents in parallel by index.)</remarks>
 	AgentIDMap agentPositionsInVector;
 
 	/// <summary>The agent ID that will be used for the next agent that gets added.</summary>
@@ -121,17 +135,97 @@ protected:
 
 	std::vector<Polygon2D> obstacles_;
 
+	/// <summary>A bounding volume hierarchy of all obstacle edges, used for nearest-neighbor queries. 
+	/// Obstacles that were added since the previous frame are included in it at the start of DoStep().</summary>
+	SegmentBVH obstacleBVH_;
+
 	/// <summary>A list containing all agents that are currently in the crowd.</summary>
 	std::vector<Agent*> agents_;
 
-	/// <summary>A kd-tree of agent positions, used for nearest-neighbor queries.</summary>
-	AgentKDTree* agentKDTree;
+	/// <summary>The per-step data (position, velocity, etc.) of all agents in agents_. 
+	/// The slot of each agent in this store is equal to its position in agents_.</summary>
+	AgentStateStore agentStates_;
+
+	/// <summary>The per-step data of all agents that are scheduled for insertion in the future.</summary>
+	AgentStateStore scheduledAgentStates_;
+
+	/// <summary>A spatial data structure of agent positions, used for nearest-neighbor queries. 
+	/// By default, this is an AgentKDTree.</summary>
+	SpatialIndex* spatialIndex_;
+
+	/// <summary>The distance by which the search radius of neighbor queries is enlarged, so that the results can be reused in later steps.
+	/// If this is zero, the neighbors of all agents are recomputed from scratch in each step.</summary>
+	float neighborSkin_;
+	/// <summary>Whether the neighbor candidates of all agents (see Agent::ComputeNeighborCandidates()) are still usable.
+	/// This becomes false when agents or obstacles are added or removed.</summary>
+	bool neighborCandidatesValid_;
+	/// <summary>Whether the current simulation step selects the neighbors of all agents from their candidates, instead of performing new queries.</summary>
+	bool reuseNeighborCandidates_;
+	/// <summary>Whether the spatial index contains the current positions of all agents. 
+	/// This becomes false when agents move, or when agents are added or removed.</summary>
+	bool spatialIndexUpToDate_;
+
+	/// <summary>The number of simulation steps after which the agents are sorted along a space-filling curve again, or 0 to never sort them.</summary>
+	size_t reorderInterval_;
+	/// <summary>The number of simulation steps until the agents will be sorted again.</summary>
+	size_t stepsUntilReordering_;
+	/// <summary>For each agent, its position along the space-filling curve and its current index, used while sorting the agents.</summary>
+	std::vector<std::pair<uint32_t, size_t>> reorderKeys_;
+
+	/// <summary>The threads that run the per-agent phases of each simulation step.</summary>
+	ThreadPool threadPool_;
+
+	/// <summary>The neighbors of all agents in the current step, stored contiguously in the order of agents_ (in compressed sparse row format).
+	/// The neighboring agents of the agent at index i are stored in neighborAgents_, from position neighborAgentOffsets_[i] 
+	/// up to (but not including) neighborAgentOffsets_[i+1], and similarly for obstacles. 
+	/// Each agent refers to its own part of these buffers; see Agent::getNeighbors().</summary>
+	std::vector<PhantomAgent> neighborAgents_;
+	std::vector<LineSegment2D> neighborObstacles_;
+	std::vector<size_t> neighborAgentOffsets_;
+	std::vector<size_t> neighborObstacleOffsets_;
+
+	/// <summary>The neighbors that one thread has found during the neighbor search, before they are copied to the buffers above.</summary>
+	struct alignas(64) NeighborStaging
+	{
+		/// <summary>The results of all queries of this thread in the current step, each written directly after the previous one.</summary>
+		NeighborList results;
+		/// <summary>The result of the current query with an enlarged search radius, from which an agent takes its neighbor candidates.</summary>
+		NeighborList candidates;
+	};
+	/// <summary>For each agent, the thread that has found its neighbors, and the position of these neighbors in the thread's NeighborStaging.</summary>
+	struct StagedNeighbors
+	{
+		int thread;
+		size_t agentsBegin;
+		size_t obstaclesBegin;
+	};
+	std::vector<NeighborStaging> neighborStaging_;
+	std::vector<StagedNeighbors> stagedNeighbors_;
+
+	/// <summary>Whether the contact between two agents that are each other's neighbors is computed only once per step, for both agents.</summary>
+	bool symmetricContactForces_;
+	/// <summary>If symmetricContactForces_ is true: for each thread, the contact forces that the agents of this thread have computed for their neighbors, 
+	/// with one element per agent. The buffers are cleared while the forces are added to the agents, so they contain only zeros in between steps.</summary>
+	std::vector<std::vector<Vector2D>> reactionForces_;
+
+	/// <summary>For each agent in agents_, whether it should be removed at the end of the current step.
+	/// This is filled in the same pass that moves the agents.</summary>
+	std::vector<char> agentsToRemove_;
+
+	/// <summary>A profiler that measures the phases of each simulation step, or nullptr if profiling is disabled.</summary>
+	StepProfiler* profiler_;
+
+	/// <summary>A tracer that records a timeline of each simulation step, or nullptr if tracing is disabled.</summary>
+	StepTracer* tracer_;
 
 	/// <summary>The length (in seconds) of a simulation step.</summary>
 	float delta_time_;
 
 	/// <summary>The simulation time (in seconds) that has passed so far.</summary>
 	double time_;
+
+	/// <summary>The number of simulation steps that have started so far.</summary>
+	size_t stepNumber_;
 	
 public:
 
@@ -152,10 +246,40 @@ public:
 	/// <returns>The time (in seconds) that has been simulated since the simulation started.</returns>
 	inline double GetCurrentTime() const { return time_; }
 
+	/// <summary>Returns the number of simulation steps that have started so far.</summary>
+	/// <remarks>DoStep() increases this number at the very start of a step, so it identifies the step that is currently running, 
+	/// or (in between steps) the step that has finished most recently.</remarks>
+	inline size_t GetStepNumber() const { return stepNumber_; }
+
 	/// <summary>Returns the duration of a single simulation time step (in seconds), i.e. the time that is simulated in a single execution of DoStep().</summary>
 	/// <returns>The durection of a single simulation time step (in seconds).</summary>
 	inline float GetDeltaTime() const { return delta_time_; }
 
+	/// <summary>Returns the distance by which neighbor queries are enlarged, so that their results can be reused in later steps.</summary>
+	inline float GetNeighborSkin() const { return neighborSkin_; }
+
+	/// <summary>Returns whether the contact between two agents that are each other's neighbors is computed only once per step.</summary>
+	inline bool GetSymmetricContactForces() const { return symmetricContactForces_; }
+
+	/// <summary>Returns the number of simulation steps after which the agents are sorted by their position again, or 0 if they are never sorted.</summary>
+	inline size_t GetReorderInterval() const { return reorderInterval_; }
+
+	/// <summary>Returns the profiler that measures the simulation steps of this world.</summary>
+	/// <returns>A pointer to the StepProfiler of this world, or nullptr if profiling is disabled.</returns>
+	inline StepProfiler* GetProfiler() const { return profiler_; }
+
+	/// <summary>Returns the tracer that records a timeline of the simulation steps of this world.</summary>
+	/// <returns>A pointer to the StepTracer of this world, or nullptr if tracing is disabled.</returns>
+	inline StepTracer* GetTracer() const { return tracer_; }
+
+	/// <summary>Returns the number of parallel threads that this world uses for the simulation.</summary>
+	inline int GetNumberOfThreads() const { return threadPool_.GetNumberOfThreads(); }
+
+	/// <summary>Returns the pool of threads that this world uses for the simulation.</summary>
+	/// <remarks>Programs that embed the simulation can use it for their own per-agent loops, 
+	/// so that these use the same number of threads as the simulation itself.</remarks>
+	inline ThreadPool& GetThreadPool() { return threadPool_; }
+
 	/// <summary>Returns the type of this world, i.e. infinite or toric.</summary>
 	/// <returns>The value of the Type enum describing the type of this world.</returns>
 	inline Type GetType() { return type_; }
@@ -169,10 +293,58 @@ public:
 	/// @{
 
 	/// <summary>Sets the number of parallel threads that this class may use for the simulation.</summary>
-	/// <remarks>The given number is sent to OpenMP. Whether this number can be used depends on the numer of (virtual) cores of your machine.</remarks>
+	/// <remarks>Each world has its own pool of threads, so different simulations in the same program can use different numbers of threads.
+	/// Using more threads than the number of (virtual) cores of your machine will not make the simulation faster.</remarks>
 	/// <param name="nrThreads">The desired number of threads to use.</param>
 	void SetNumberOfThreads(int nrThreads);
 
+	/// <summary>Replaces the spatial data structure that this world uses for nearest-neighbor queries.</summary>
+	/// <remarks>The world takes ownership of the given object, so you do not have to delete it yourself.</remarks>
+	/// <param name="spatialIndex">A pointer to a new SpatialIndex object (e.g. an AgentKDTree or an AgentGrid).</param>
+	void SetSpatialIndex(SpatialIndex* spatialIndex);
+
+	/// <summary>Sets the distance by which the search radius of neighbor queries is enlarged, so that their results can be reused in later steps.</summary>
+	/// <remarks>If the skin is positive, each agent stores the result of a query with its interaction range plus the skin (a Verlet neighbor list), 
+	/// and selects its neighbors from this list in the following steps. The spatial index is rebuilt and all agents perform a new query 
+	/// only when an agent has moved more than half the skin, or when agents or obstacles have been added or removed.
+	/// A larger skin leads to fewer queries, but to more candidates per agent. 
+	/// The neighbors are the same as without a skin, but they may differ slightly because of floating-point rounding.
+	/// In the steps that reuse the candidates, the spatial index is not updated; use RefreshSpatialIndex() before querying it from outside the simulation loop.</remarks>
+	/// <param name="skin">The skin distance in meters, or 0 to compute all neighbors from scratch in each step.</param>
+	void SetNeighborSkin(float skin);
+
+	/// <summary>Sets how often the agents should be sorted by their position, to improve the memory locality of the simulation.</summary>
+	/// <remarks>If the interval is positive, the agents (and their per-step data) are sorted along a Hilbert curve at the start of the next step,
+	/// and again after every "interval" steps. Agents that are close to each other then tend to be close in memory as well,
+	/// and each thread handles a spatially compact group of agents. This changes the indices of agents (see Agent::getIndex()), but not their IDs.
+	/// It also changes the order in which some sums over agents are computed, so the results may differ slightly because of floating-point rounding.</remarks>
+	/// <param name="interval">The number of steps between two sorts, or 0 to keep the agents in the order of insertion.</param>
+	void SetReorderInterval(size_t interval);
+
+	/// <summary>Sets whether the contact between two agents that are each other's neighbors should be computed only once per step.</summary>
+	/// <remarks>If this is enabled, the agent with the lowest index computes the contact force of such a pair for both agents (see Agent::ComputeContactForces()). 
+	/// The forces for the neighbors are collected in one buffer per thread during the pass that computes them, 
+	/// and each agent adds the buffers in the order of the threads just before it moves, so no extra loop over the agents is needed. 
+	/// Pairs in which only one agent sees the other, and contacts with obstacles, are still computed by each agent itself.
+	/// The results may differ slightly from the default computation because of floating-point rounding.
+	/// With more than one thread, the thread that handles each agent can change between runs (see ThreadPool), 
+	/// so two runs of the same simulation may also differ slightly.</remarks>
+	/// <param name="symmetric">Whether or not to compute the contact forces once per pair of agents.</param>
+	inline void SetSymmetricContactForces(bool symmetric) { symmetricContactForces_ = symmetric; }
+
+	/// <summary>Enables or disables the profiling of simulation steps.</summary>
+	/// <remarks>If profiling is enabled, each call to DoStep() records the time spent in each phase (see StepProfiler). 
+	/// Enabling it again does not reset the measurements so far; use GetProfiler()->Reset() for that.
+	/// Disabling it deletes all measurements.</remarks>
+	/// <param name="enabled">Whether or not to profile the simulation steps.</param>
+	void SetProfilingEnabled(bool enabled);
+
+	/// <summary>Enables or disables the tracing of simulation steps.</summary>
+	/// <remarks>If tracing is enabled, each call to DoStep() records a timeline of its phases, per thread (see StepTracer).
+	/// Disabling it deletes all recorded events.</remarks>
+	/// <param name="enabled">Whether or not to trace the simulation steps.</param>
+	void SetTracingEnabled(bool enabled);
+
 	/// <summary>Sets the length of simulation time steps.</summary>
 	/// <param name="delta_time">The desired length (in seconds) of a single simulation frame.</param>
 	inline void SetDeltaTime(float delta_time) { delta_time_ = delta_time; }
@@ -184,9 +356,34 @@ public:
 	/// All agents compute their new desired velocity and then move forward.</summary>
 	void DoStep();
 	
-	/// <summary>Computes and returns a list of all agents that are within a given radius of a given position.</summary>
-	/// <remarks>Subclasses of WorldBase must implement this method, because the result may depend on special properties (e.g. the wrap-around effect in WorldToric).</remarks>
-	virtual NeighborList ComputeNeighbors(const Vector2D& position, float search_radius, const Agent* queryingAgent) const = 0;
+	/// <summary>Computes a list of all agents and obstacles that are within a given radius of a given position.</summary>
+	/// <remarks>Subclasses of WorldBase must implement this method, because the result may depend on special properties (e.g. the wrap-around effect in WorldToric).
+	/// The result is appended to the given list, so that the queries of many agents can be written directly into one buffer 
+	/// (such as the per-thread buffers of the neighbor search) that reuses its memory. Implementations should also use per-thread buffers 
+	/// for intermediate results, so that queries do not allocate memory once all buffers are large enough.</remarks>
+	/// <param name="position">A query position.</param>
+	/// <param name="search_radius">A query radius.</param>
+	/// <param name="queryingAgent">A pointer to the Agent object performing the query. This agent will be excluded from the results.
+	/// Use nullptr to not exclude any agents.</param>
+	/// <param name="result">[out] The neighboring agents and obstacles are appended to this list. Its previous contents are kept.</param>
+	virtual void ComputeNeighbors(const Vector2D& position, float search_radius, const Agent* queryingAgent, NeighborList& result) const = 0;
+
+	/// <summary>Computes and returns a list of all agents and obstacles that are within a given radius of a given position.</summary>
+	/// <remarks>This is a convenience version of the other ComputeNeighbors() method, for queries that are not performed in every step.
+	/// Between two steps, the spatial index may still contain old positions (see RefreshSpatialIndex()).</remarks>
+	NeighborList ComputeNeighbors(const Vector2D& position, float search_radius, const Agent* queryingAgent) const
+	{
+		NeighborList result;
+		ComputeNeighbors(position, search_radius, queryingAgent, result);
+		return result;
+	}
+
+	/// <summary>Rebuilds the spatial index of agents if it does not contain the current positions of all agents.</summary>
+	/// <remarks>After a simulation step, the spatial index may still contain old positions, for example because the agents have reused their 
+	/// neighbor candidates instead of rebuilding it (see SetNeighborSkin()), or because agents have been added or removed.
+	/// Call this method before querying neighbors from outside the simulation loop (e.g. from a GUI).
+	/// It changes the spatial index, so it should not be called during a simulation step or while other threads perform queries.</remarks>
+	void RefreshSpatialIndex();
 
 #pragma region [Finding, adding, and removing agents]
 	/// @name Finding, adding, and removing agents
@@ -222,6 +419,11 @@ public:
 	/// <returns>true if the agent was successfully removed; false otherwise, i.e. if the agent with the given ID does not exist.</returns>
 	bool RemoveAgent(size_t id);
 
+	/// <summary>Reserves memory for the given number of additional active agents.
+	/// Use this before adding a large number of agents at once.</summary>
+	/// <param name="nrAgents">The number of agents that will be added.</param>
+	void ReserveAgents(size_t nrAgents);
+
 	/// @}
 #pragma endregion
 
@@ -242,23 +444,137 @@ protected:
 	/// <param name="search_radius">A query radius.</param>
 	/// <param name="queryingAgent">A pointer to the Agent object performing the query. This agent will be excluded from the results.
 	/// Use nullptr to not exclude any agents.</param>
-	/// <param name="result">[out] Will store a list of pointers to agents queryingAgent lie within "search_radius" meters of "position", 
+	/// <param name="result">[out] Will store a list of all agents (and ghost copies of agents) that lie within "search_radius" meters of "position", 
 	/// excluding the agent denoted by "queryingAgent" (if it exists).</param>
-	void computeNeighboringAgents_Flat(const Vector2D& position, float search_radius, const Agent* queryingAgent, std::vector<const Agent*>& result) const;
+	void computeNeighboringAgents_Flat(const Vector2D& position, float search_radius, const Agent* queryingAgent, std::vector<SpatialIndex::Entry>& result) const;
 
+	/// <summary>Computes a list of all obstacle edges that lie within a given radius of a given position.</summary>
+	/// <param name="position">A query position.</param>
+	/// <param name="search_radius">A query radius.</param>
+	/// <param name="result">[out] A list to which all obstacle edges within "search_radius" meters of "position" will be appended.</param>
 	void computeNeighboringObstacles_Flat(const Vector2D& position, float search_radius, std::vector<LineSegment2D>& result) const;
 
-	/// <summary>Subroutine of DoStep() that moves all agents forward using their last computed "new velocities".</summary>
-	/// <remarks>Subclasses of WorldBase may override this method if they require special behavior (e.g. the wrap-around effect in WorldToric).</remarks>
-	virtual void DoStep_MoveAllAgents();
+	/// <summary>Subroutine of DoStep() that brings the spatial index up-to-date with the current positions of all agents.</summary>
+	/// <remarks>Subclasses of WorldBase may override this method if they require special behavior (e.g. ghost copies of agents in WorldToric).</remarks>
+	virtual void DoStep_UpdateSpatialIndex();
+
+	/// <summary>Subroutine of DoStep() that moves an agent forward using its last computed "new velocity".</summary>
+	/// <remarks>Subclasses of WorldBase may override this method if they require special behavior (e.g. the wrap-around effect in WorldToric).
+	/// This method is called for all agents in parallel, so it should only change the given agent.</remarks>
+	/// <param name="agent">The agent to move.</param>
+	virtual void DoStep_MoveAgent(Agent* agent);
+
+	/// <summary>A per-agent function that belongs to a phase of the simulation step. See forAllAgentsFused().</summary>
+	template <typename AgentFunction>
+	struct AgentPass
+	{
+		StepProfiler::Phase phase;
+		const AgentFunction& function;
+	};
+
+	/// <summary>Creates an AgentPass for forAllAgentsFused().</summary>
+	template <typename AgentFunction>
+	static AgentPass<AgentFunction> agentPass(StepProfiler::Phase phase, const AgentFunction& function) { return { phase, function }; }
+
+	/// <summary>Subroutine of forAllAgentsFused() that runs a pass for a chunk of agents, 
+	/// adds its time to the profiler, and records it as an event in the trace.</summary>
+	template <typename AgentFunction>
+	void runInstrumentedAgentPass(const AgentPass<AgentFunction>& pass, size_t begin, size_t end)
+	{
+		StepProfiler::ThreadTimer timer(profiler_, pass.phase);
+		StepTracer::Scope scope(tracer_, pass.phase);
+		for (size_t i = begin; i < end; ++i)
+			pass.function(agents_[i]);
+		if (tracer_ != nullptr)
+			tracer_->EndPolicyRun();
+	}
+
+	/// <summary>Runs several per-agent passes in a single parallel loop over all agents, with one barrier at the end instead of one per pass.</summary>
+	/// <remarks>The agents are divided over the threads of threadPool_ with work stealing, 
+	/// so threads that handle cheap agents take over work from threads that handle expensive ones.
+	/// Each agent runs all passes in the given order before the next agent starts, so its data is still in the cache for the next pass.
+	/// This is only correct if no pass of one agent depends on the result of an earlier pass of another agent.
+	/// 
+	/// This method starts the phase of the first pass (see startPhase()), so the wall-clock time of the whole loop is counted for that phase; 
+	/// the profiler reports the other phases of the loop as part of it (see StepProfiler::SetFusedPhase()).
+	/// If profiling is enabled, the time that each thread spends in each pass is still measured separately, per chunk of agents.
+	/// If tracing is enabled, each thread records one event per pass for each chunk of agents that it handles, 
+	/// so the trace shows the loop exactly as it runs without tracing.</remarks>
+	/// <param name="passes">The passes to run, created with agentPass().</param>
+	template <typename... AgentFunctions>
+	void forAllAgentsFused(const AgentPass<AgentFunctions>&... passes)
+	{
+		const StepProfiler::Phase phases[] = { passes.phase... };
+		startPhase(phases[0]);
+		if (profiler_ != nullptr)
+		{
+			for (const StepProfiler::Phase phase : phases)
+				if (phase != phases[0])
+					profiler_->SetFusedPhase(phase, phases[0]);
+		}
+
+		if (profiler_ == nullptr && tracer_ == nullptr)
+		{
+			threadPool_.ParallelFor(agents_.size(), [this, &passes...](size_t i)
+			{
+				Agent* agent = agents_[i];
+				(passes.function(agent), ...);
+			});
+		}
+		else
+		{
+			threadPool_.ParallelForEachThread(agents_.size(), [this, &passes...](ThreadPool::Chunks& chunks)
+			{
+				size_t begin, end;
+				while (chunks.Next(begin, end))
+					(runInstrumentedAgentPass(passes, begin, end), ...);
+			});
+		}
+	}
 
 private:
+	/// <summary>Lets the profiler and tracer (if any) know that the next phase of the simulation step begins.</summary>
+	/// <remarks>StepProfiler::INSERTION marks the start of a new step.</remarks>
+	void startPhase(StepProfiler::Phase phase);
+
+	/// <summary>Lets the profiler and tracer (if any) know that the current simulation step has ended.</summary>
+	void endStep();
+
+	/// <summary>Sorts the list of agents (and their per-step data) along a Hilbert curve through the bounding box of all agents.</summary>
+	void reorderAgents();
+
+	/// <summary>Checks whether the neighbor candidates of all agents can be used in the current step, instead of performing new queries.</summary>
+	bool canReuseNeighborCandidates();
+
+	/// <summary>Prepares the neighbor buffers for a neighbor search of all agents.</summary>
+	void startNeighborSearch();
+
+	/// <summary>Computes the neighbors of an agent, and adds them to the NeighborStaging of the current thread.</summary>
+	void findNeighbors(Agent* agent);
+
+	/// <summary>Computes where the neighbors of each agent should be stored, after findNeighbors() has been called for all agents.</summary>
+	void finishNeighborSearch();
+
+	/// <summary>Copies the neighbors of an agent to its part of the neighbor buffers, after finishNeighborSearch() has been called.</summary>
+	void storeNeighbors(Agent* agent);
+
+	/// <summary>Gives each thread a buffer of contact forces for the neighbors of its agents, with one zero element per agent.</summary>
+	void prepareReactionForces();
+
+	/// <summary>Adds the contact forces that other agents have computed for an agent (in the order of the threads) to its own, 
+	/// and clears them in the buffers.</summary>
+	void addReactionForces(Agent* agent);
+
 	/// Adds a (previously created) agent to the simulation.
 	void addAgentToList(Agent* agent);
 
 	/// Removes the agent at a given position in the list, 
 	/// and does the necessary management to keep this list valid.
 	void removeAgentAtListIndex(size_t index);
+
+	/// <summary>Clears the neighbors of all agents, after agents have been removed.</summary>
+	/// <remarks>The neighbors refer to other agents by their index, which a removal gives to another agent.</remarks>
+	void clearNeighbors();
 };
 
 #endif //LIB_WORLD_BASE_H
@@ -28,33 +28,27 @@
 
 #include <core/worldInfinite.h>
 
-using namespace nanoflann;
 using namespace std;
 
 WorldInfinite::WorldInfinite() : WorldBase(INFINITE_WORLD)
 {
 }
 
-NeighborList WorldInfinite::ComputeNeighbors(const Vector2D& position, float search_radius, const Agent* queryingAgent) const
+/// <summary>A per-thread buffer for the agents found by a query, so that queries do not have to allocate memory.</summary>
+static thread_local vector<SpatialIndex::Entry> neighborAgents;
+
+void WorldInfinite::ComputeNeighbors(const Vector2D& position, float search_radius, const Agent* queryingAgent, NeighborList& result) const
 {
-	vector<PhantomAgent> phantoms; 
-	if (agentKDTree != nullptr)
-	{
-		// compute neighboring agents
-		vector<const Agent*> agents;
-		computeNeighboringAgents_Flat(position, search_radius, queryingAgent, agents);
-		
-		// efficiently add them to the result
-		Vector2D offset(0, 0);
-		phantoms.resize(agents.size());
-		for (size_t i = 0; i < agents.size(); ++i)
-			phantoms[i] = PhantomAgent(agents[i], position, offset);
-	}
+	// compute neighboring agents
+	computeNeighboringAgents_Flat(position, search_radius, queryingAgent, neighborAgents);
+	
+	// efficiently add them to the result
+	const size_t oldSize = result.first.size();
+	result.first.resize(oldSize + neighborAgents.size());
+	for (size_t i = 0; i < neighborAgents.size(); ++i)
+		result.first[oldSize + i] = PhantomAgent(neighborAgents[i].agent, position, neighborAgents[i].offset);
 
 	// compute neighboring obstacles
-	vector<LineSegment2D> obstacles;
-	computeNeighboringObstacles_Flat(position, search_radius, obstacles);
-
-	return { phantoms, obstacles };
+	computeNeighboringObstacles_Flat(position, search_radius, result.second);
 }
 
@@ -36,7 +36,8 @@ class WorldInfinite : public WorldBase
 {
 public:
 	WorldInfinite();
-	NeighborList ComputeNeighbors(const Vector2D& position, float search_radius, const Agent* queryingAgent) const override;
+	using WorldBase::ComputeNeighbors;
+	void ComputeNeighbors(const Vector2D& position, float search_radius, const Agent* queryingAgent, NeighborList& result) const override;
 };
 
 #endif //LIB_WORLD_INFINITE_H
@@ -33,9 +33,10 @@ public:
         return ymax_;
     }
 
-    NeighborList ComputeNeighbors(const Vector2D &position, float search_radius,
-                                  const Agent *queryingAgent) const override;
-    virtual void DoStep_MoveAllAgents() override;
+    using WorldBase::ComputeNeighbors;
+    void ComputeNeighbors(const Vector2D &position, float search_radius,
+                          const Agent *queryingAgent, NeighborList &result) const override;
+    virtual void DoStep_MoveAgent(Agent *agent) override;
 };
 
 #endif //UMANS_WORLDPLANAR_H
@@ -27,89 +27,170 @@
 */
 
 #include <core/worldToric.h>
+#include <algorithm>
 
-using namespace nanoflann;
 using namespace std;
 
 WorldToric::WorldToric(float width, float height) 
-	: WorldBase(TORIC_WORLD), width_(width), height_(height)
+	: WorldBase(TORIC_WORLD), width_(width), height_(height), ghostMargin_(0)
 {
 }
 
-void WorldToric::computeNeighbors_Displaced(const Vector2D& position, const Vector2D& displacement, float search_radius, const Agent* queryingAgent,
-	NeighborList& result) const
+void WorldToric::DoStep_UpdateSpatialIndex()
 {
-	Vector2D minDisplacement(-displacement);
-	
-	if (agentKDTree != nullptr)
+	// the ghost copies should cover the largest query radius of all agents
+	ghostMargin_ = 0;
+	for (const Agent* agent : agents_)
+		ghostMargin_ = std::max(ghostMargin_, agent->getPolicy()->getInteractionRange());
+	ghostMargin_ += GetNeighborSkin();
+
+	// copy each agent near a boundary to the other side of the world, and each agent near a corner to the three other corners
+	const float halfWidth = 0.5f * width_;
+	const float halfHeight = 0.5f * height_;
+	ghosts_.clear();
+	for (const Agent* agent : agents_)
 	{
-		// compute neighboring agents
-		vector<const Agent*> agents;
-		computeNeighboringAgents_Flat(position + displacement, search_radius, queryingAgent, agents);
-
-		// efficiently add them to the result
-		size_t oldSize = result.first.size(), extraSize = agents.size();
-		result.first.resize(oldSize + extraSize);
-		for (size_t i = 0; i < extraSize; ++i)
-			result.first[oldSize + i] = PhantomAgent(agents[i], position, minDisplacement);
-	}
+		const Vector2D& position = agent->getPosition();
+
+		float offsetsX[3] = { 0 }; size_t nrOffsetsX = 1;
+		if (position.x > halfWidth - ghostMargin_)
+			offsetsX[nrOffsetsX++] = -width_;
+		if (position.x < -halfWidth + ghostMargin_)
+			offsetsX[nrOffsetsX++] = width_;
 
-	// compute neighboring obstacles
-	vector<LineSegment2D> obstacles;
-	computeNeighboringObstacles_Flat(position + displacement, search_radius, obstacles);
+		float offsetsY[3] = { 0 }; size_t nrOffsetsY = 1;
+		if (position.y > halfHeight - ghostMargin_)
+			offsetsY[nrOffsetsY++] = -height_;
+		if (position.y < -halfHeight + ghostMargin_)
+			offsetsY[nrOffsetsY++] = height_;
+
+		for (size_t x = 0; x < nrOffsetsX; ++x)
+			for (size_t y = 0; y < nrOffsetsY; ++y)
+				if (x > 0 || y > 0)
+					ghosts_.push_back({ agent, Vector2D(offsetsX[x], offsetsY[y]) });
+	}
 
-	// efficiently add them to the result
-	size_t oldSize = result.second.size(), extraSize = obstacles.size();
-	result.second.resize(oldSize + extraSize);
-	for (size_t i = 0; i < extraSize; ++i)
-		result.second[oldSize + i] = LineSegment2D(obstacles[i].first - displacement, obstacles[i].second - displacement);
+	spatialIndex_->Update(agents_, ghosts_);
 }
 
-NeighborList WorldToric::ComputeNeighbors(const Vector2D& position, float search_radius, const Agent* queryingAgent) const
-{
-	NeighborList result;
-	computeNeighbors_Displaced(position, Vector2D(0, 0), search_radius, queryingAgent, result);
+/// <summary>A per-thread buffer for the agents found by a query, so that queries do not have to allocate memory.</summary>
+static thread_local vector<SpatialIndex::Entry> neighborAgents;
 
+size_t WorldToric::getQueryDisplacements(const Vector2D& position, float search_radius, Vector2D* displacements) const
+{
+	float displacementsX[3] = { 0 }; size_t nrDisplacementsX = 1;
 	if (position.x - search_radius < -0.5*width_)
-		computeNeighbors_Displaced(position, Vector2D(width_, 0), search_radius, queryingAgent, result);
-	
+		displacementsX[nrDisplacementsX++] = width_;
 	if (position.x + search_radius > 0.5*width_)
-		computeNeighbors_Displaced(position, Vector2D(-width_, 0), search_radius, queryingAgent, result);
-	
-	if (position.y - search_radius < -0.5*height_)
-		computeNeighbors_Displaced(position, Vector2D(0, height_), search_radius, queryingAgent, result);
+		displacementsX[nrDisplacementsX++] = -width_;
 
+	float displacementsY[3] = { 0 }; size_t nrDisplacementsY = 1;
+	if (position.y - search_radius < -0.5*height_)
+		displacementsY[nrDisplacementsY++] = height_;
 	if (position.y + search_radius > 0.5*height_)
-		computeNeighbors_Displaced(position, Vector2D(0, -height_), search_radius, queryingAgent, result);
+		displacementsY[nrDisplacementsY++] = -height_;
 
-	return result;
+	// first the horizontal and vertical displacements (in the order in which UMANS has always used them), then the corners
+	size_t nrDisplacements = 0;
+	for (size_t x = 1; x < nrDisplacementsX; ++x)
+		displacements[nrDisplacements++] = Vector2D(displacementsX[x], 0);
+	for (size_t y = 1; y < nrDisplacementsY; ++y)
+		displacements[nrDisplacements++] = Vector2D(0, displacementsY[y]);
+	for (size_t x = 1; x < nrDisplacementsX; ++x)
+		for (size_t y = 1; y < nrDisplacementsY; ++y)
+			displacements[nrDisplacements++] = Vector2D(displacementsX[x], displacementsY[y]);
+	return nrDisplacements;
 }
 
-void WorldToric::DoStep_MoveAllAgents()
+void WorldToric::computeNeighboringAgents_Displaced(const Vector2D& position, const Vector2D& displacement, float search_radius, const Agent* queryingAgent,
+	NeighborList& result) const
 {
-	const float halfWidth = 0.5f * width_;
-	const float halfHeight = 0.5f * height_;
+	Vector2D minDisplacement(-displacement);
+	
+	// compute neighboring agents, ignoring the ghost copies (because the displacement already takes care of the wrap-around effect)
+	computeNeighboringAgents_Flat(position + displacement, search_radius, queryingAgent, neighborAgents);
+	for (const SpatialIndex::Entry& entry : neighborAgents)
+		if (entry.offset.isZero())
+			result.first.push_back(PhantomAgent(entry.agent, position, minDisplacement));
+}
+
+void WorldToric::computeNeighboringObstacles_Displaced(const Vector2D& position, const Vector2D& displacement, float search_radius,
+	NeighborList& result) const
+{
+	// compute neighboring obstacles, directly in the result, and then translate them
+	size_t oldSize = result.second.size();
+	computeNeighboringObstacles_Flat(position + displacement, search_radius, result.second);
+	for (size_t i = oldSize; i < result.second.size(); ++i)
+		result.second[i] = LineSegment2D(result.second[i].first - displacement, result.second[i].second - displacement);
+}
+
+void WorldToric::ComputeNeighbors(const Vector2D& position, float search_radius, const Agent* queryingAgent, NeighborList& result) const
+{
+	Vector2D displacements[8];
+	const size_t nrDisplacements = getQueryDisplacements(position, search_radius, displacements);
 
-#pragma omp parallel for
-	for (int i = 0; i < (int)agents_.size(); i++)
+	// compute neighboring agents: if the ghost copies cover the search radius, a single query finds them all
+	if (search_radius <= ghostMargin_)
+	{
+		computeNeighboringAgents_Flat(position, search_radius, queryingAgent, neighborAgents);
+		if (nrDisplacements == 0)
+		{
+			const size_t oldSize = result.first.size();
+			result.first.resize(oldSize + neighborAgents.size());
+			for (size_t i = 0; i < neighborAgents.size(); ++i)
+				result.first[oldSize + i] = PhantomAgent(neighborAgents[i].agent, position, neighborAgents[i].offset);
+		}
+		else
+		{
+			// list the direct neighbors first, and then the ghost copies grouped per displacement, 
+			// in the same order as the separate displaced queries; this way, sums over the neighbors do not change
+			const auto& getGroup = [&displacements, nrDisplacements](const Vector2D& offset)
+			{
+				if (offset.isZero())
+					return (size_t)0;
+				for (size_t i = 0; i < nrDisplacements; ++i)
+					if (offset == -displacements[i])
+						return i + 1;
+				return nrDisplacements + 1;
+			};
+			for (size_t group = 0; group <= nrDisplacements + 1; ++group)
+				for (const SpatialIndex::Entry& entry : neighborAgents)
+					if (getGroup(entry.offset) == group)
+						result.first.push_back(PhantomAgent(entry.agent, position, entry.offset));
+		}
+	}
+	else
 	{
-		Agent* agent = agents_[i];
-		
-		// update the agent's velocity and position as usual
-		agent->UpdateVelocityAndPosition(this);
-		
-		// if the agent has crossed the bounding rectangle, warp it to the other side
-		float x = agent->getPosition().x;
-		float y = agent->getPosition().y;
-		if (x > halfWidth)
-			x -= width_;
-		else if (x < -halfWidth)
-			x += width_;
-		if (y > halfHeight)
-			y -= height_;
-		else if (y < -halfHeight)
-			y += height_;
-
-		agent->setPosition(Vector2D(x,y));
+		computeNeighboringAgents_Displaced(position, Vector2D(0, 0), search_radius, queryingAgent, result);
+		for (size_t i = 0; i < nrDisplacements; ++i)
+			computeNeighboringAgents_Displaced(position, displacements[i], search_radius, queryingAgent, result);
 	}
+
+	// compute neighboring obstacles, for which there are no ghost copies
+	computeNeighboringObstacles_Flat(position, search_radius, result.second);
+	for (size_t i = 0; i < nrDisplacements; ++i)
+		computeNeighboringObstacles_Displaced(position, displacements[i], search_radius, result);
+}
+
+void WorldToric::DoStep_MoveAgent(Agent* agent)
+{
+	const float halfWidth = 0.5f * width_;
+	const float halfHeight = 0.5f * height_;
+
+	// update the agent's velocity and position as usual
+	agent->UpdateVelocityAndPosition(this);
+	
+	// if the agent has crossed the bounding rectangle, warp it to the other side
+	float x = agent->getPosition().x;
+	float y = agent->getPosition().y;
+	if (x > halfWidth)
+		x -= width_;
+	else if (x < -halfWidth)
+		x += width_;
+	if (y > halfHeight)
+		y -= height_;
+	else if (y < -halfHeight)
+		y += height_;
+
+	agent->setPosition(Vector2D(x,y));
 }
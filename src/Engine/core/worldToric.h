@@ -41,6 +41,13 @@ private:
 	float width_;
 	float height_;
 
+	/// <summary>Ghost copies of all agents that lie within ghostMargin_ of the world boundaries, translated to the other side of the world.
+	/// These are stored in the spatial index along with the agents themselves, so that a single query finds all neighbors across the boundaries.</summary>
+	std::vector<SpatialIndex::Entry> ghosts_;
+	/// <summary>The distance to the world boundaries within which agents have ghost copies. 
+	/// This is the largest query radius of all agents in the current step.</summary>
+	float ghostMargin_;
+
 public:
 	/// <summary>Creates a WorldToric object with the given width and height.</summary>
 	/// <param name="width">The width of the world, in meters.</param>
@@ -48,12 +55,17 @@ public:
 	WorldToric(float width, float height);
 
 	/// <summary>WorldToric's version of ComputeNeighbors().
-	/// It performs multiple nearest-neighbor queries to account for the world's wrap-around effect.</summary>
-	NeighborList ComputeNeighbors(const Vector2D& position, float search_radius, const Agent* queryingAgent) const override;
+	/// It uses the ghost copies of agents in the spatial index to account for the world's wrap-around effect, 
+	/// so that a single query suffices. Queries with a larger radius than the ghost margin (which are rare) 
+	/// are repeated for each necessary displacement instead.
+	/// In both cases, the result first lists the direct neighbors and then the neighbors across the boundaries, grouped per displacement,
+	/// so that the order of neighbors (and thus of any sums over them) matches that of separate queries per displacement.</summary>
+	void ComputeNeighbors(const Vector2D& position, float search_radius, const Agent* queryingAgent, NeighborList& result) const override;
+	using WorldBase::ComputeNeighbors;
 	
-	/// <summary>WorldToric's version of DoStep_MoveAllAgents(). 
-	/// It moves all agents forward and then possibly teleports them to the other end of the world, to simulate a wrap-around effect.</summary>
-	virtual void DoStep_MoveAllAgents() override;
+	/// <summary>WorldToric's version of DoStep_MoveAgent(). 
+	/// It moves an agent forward and then possibly teleports it to the other end of the world, to simulate a wrap-around effect.</summary>
+	virtual void DoStep_MoveAgent(Agent* agent) override;
 
 	/// <summary>Returns the width of this toric world.</summary>
 	inline float GetWidth() const { return width_; }
@@ -70,8 +82,22 @@ public:
 		return { Vector2D(-halfW,-halfH), Vector2D(halfW, halfH) };
 	}
 
+protected:
+	/// <summary>WorldToric's version of DoStep_UpdateSpatialIndex(). 
+	/// It adds ghost copies of all agents near the world boundaries to the spatial index.</summary>
+	virtual void DoStep_UpdateSpatialIndex() override;
+
 private:
-	void computeNeighbors_Displaced(const Vector2D& position, const Vector2D& displacement, float search_radius, const Agent* queryingAgent,
+	/// <summary>Computes the displacements by which a query should be repeated to find all results across the world boundaries.</summary>
+	/// <param name="position">A query position.</param>
+	/// <param name="search_radius">A query radius.</param>
+	/// <param name="displacements">[out] An array of at least 8 elements, which will store the displacements.</param>
+	/// <returns>The number of displacements, excluding the zero displacement.</returns>
+	size_t getQueryDisplacements(const Vector2D& position, float search_radius, Vector2D* displacements) const;
+
+	void computeNeighboringAgents_Displaced(const Vector2D& position, const Vector2D& displacement, float search_radius, const Agent* queryingAgent,
+		NeighborList& result) const;
+	void computeNeighboringObstacles_Displaced(const Vector2D& position, const Vector2D& displacement, float search_radius,
 		NeighborList& result) const;
 };
 
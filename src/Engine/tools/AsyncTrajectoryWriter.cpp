@@ -0,0 +1,116 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#include <tools/AsyncTrajectoryWriter.h>
+
+AsyncTrajectoryWriter::AsyncTrajectoryWriter(TrajectoryWriter* writer) 
+	: writer_(writer), nrPendingFrames_(0), pendingBytes_(0), nrWorkingFrames_(0), writing_(false), stopping_(false)
+{
+	thread_ = std::thread(&AsyncTrajectoryWriter::run, this);
+}
+
+void AsyncTrajectoryWriter::SetMemoryBudget(size_t bytes)
+{
+	// wait until the wrapped writer is idle, so that its budget can be changed safely
+	std::unique_lock<std::mutex> lock(mtx_);
+	writerProgress_.wait(lock, [this] { return nrPendingFrames_ == 0 && !writing_; });
+
+	memoryBudget_ = bytes / 4;
+	writer_->SetMemoryBudget(bytes / 2);
+}
+
+void AsyncTrajectoryWriter::AppendFrame(const TrajectoryFrame& frame)
+{
+	{
+		std::unique_lock<std::mutex> lock(mtx_);
+
+		// if the pending batch is too large, wait until the background thread takes it
+		if (memoryBudget_ > 0)
+			writerProgress_.wait(lock, [this] { return nrPendingFrames_ == 0 || pendingBytes_ < memoryBudget_; });
+
+		// copy the frame into a recycled buffer if possible, to reuse its memory
+		if (nrPendingFrames_ < pendingFrames_.size())
+			pendingFrames_[nrPendingFrames_] = frame;
+		else
+			pendingFrames_.push_back(frame);
+		++nrPendingFrames_;
+		pendingBytes_ += frame.agentIDs.size() * (sizeof(size_t) + 2 * sizeof(Vector2D));
+	}
+
+	framesAvailable_.notify_one();
+}
+
+void AsyncTrajectoryWriter::run()
+{
+	std::unique_lock<std::mutex> lock(mtx_);
+	while (true)
+	{
+		framesAvailable_.wait(lock, [this] { return nrPendingFrames_ > 0 || stopping_; });
+		if (nrPendingFrames_ == 0) // stopping, and nothing left to write
+			break;
+
+		// swap the batches, so that the simulation thread can continue filling the other one
+		std::swap(pendingFrames_, workingFrames_);
+		nrWorkingFrames_ = nrPendingFrames_;
+		nrPendingFrames_ = 0;
+		pendingBytes_ = 0;
+		writing_ = true;
+		writerProgress_.notify_all();
+
+		// pass the frames to the real writer without holding the lock
+		lock.unlock();
+		for (size_t i = 0; i < nrWorkingFrames_; ++i)
+			writer_->AppendFrame(workingFrames_[i]);
+		lock.lock();
+
+		writing_ = false;
+		writerProgress_.notify_all();
+	}
+}
+
+bool AsyncTrajectoryWriter::Flush()
+{
+	// wait until the background thread has passed all frames to the real writer
+	std::unique_lock<std::mutex> lock(mtx_);
+	writerProgress_.wait(lock, [this] { return nrPendingFrames_ == 0 && !writing_; });
+
+	return writer_->Flush();
+}
+
+AsyncTrajectoryWriter::~AsyncTrajectoryWriter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mtx_);
+		stopping_ = true;
+	}
+	framesAvailable_.notify_one();
+	thread_.join();
+
+	// the wrapped writer does its final flush when it is deleted
+	delete writer_;
+}
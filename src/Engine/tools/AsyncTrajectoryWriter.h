@@ -0,0 +1,99 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#ifndef LIB_ASYNCTRAJECTORYWRITER_H
+#define LIB_ASYNCTRAJECTORYWRITER_H
+
+#include <tools/TrajectoryWriter.h>
+
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+/// <summary>A TrajectoryWriter that passes frames to another TrajectoryWriter on a background thread, 
+/// so that the simulation does not have to wait for file output.</summary>
+/// <remarks>Frames are double-buffered: the simulation thread copies each frame into a pending batch, 
+/// while the background thread hands the previous batch to the wrapped writer. 
+/// Frame buffers are recycled, so that a steady stream of frames does not cause memory allocations.
+/// If a memory budget is set, a quarter of it is used for each of the two batches: 
+/// when the pending batch is full, the simulation thread waits for the background thread.
+/// The other half of the budget is passed on to the wrapped writer.</remarks>
+class AsyncTrajectoryWriter : public TrajectoryWriter
+{
+private:
+	/// <summary>The writer that does the actual output. It is only used by the background thread, except in Flush().</summary>
+	TrajectoryWriter* writer_;
+
+	std::thread thread_;
+	std::mutex mtx_;
+	/// <summary>Notified when the simulation thread adds a frame, or when the writer should stop.</summary>
+	std::condition_variable framesAvailable_;
+	/// <summary>Notified when the background thread takes a batch of frames, and when it has finished writing that batch.</summary>
+	std::condition_variable writerProgress_;
+
+	/// <summary>The batch of frames that the simulation thread fills. Only the first nrPendingFrames_ elements are in use.</summary>
+	std::vector<TrajectoryFrame> pendingFrames_;
+	size_t nrPendingFrames_;
+	/// <summary>The approximate size of the frames in the pending batch, in bytes.</summary>
+	size_t pendingBytes_;
+	/// <summary>The batch of frames that the background thread is writing. Only the first nrWorkingFrames_ elements are in use.</summary>
+	std::vector<TrajectoryFrame> workingFrames_;
+	size_t nrWorkingFrames_;
+
+	/// <summary>Whether or not the background thread is currently writing frames.</summary>
+	bool writing_;
+	/// <summary>Whether or not the background thread should stop after writing all remaining frames.</summary>
+	bool stopping_;
+
+	/// <summary>The main loop of the background thread.</summary>
+	void run();
+
+public:
+	/// <summary>Creates an AsyncTrajectoryWriter that writes its output via the given writer, and starts the background thread.</summary>
+	/// <param name="writer">The writer that does the actual output. The AsyncTrajectoryWriter takes ownership of this object.</param>
+	AsyncTrajectoryWriter(TrajectoryWriter* writer);
+
+	/// <summary>Limits the memory used for buffered output; see the remarks of this class.</summary>
+	/// <param name="bytes">The maximum number of bytes to use for buffered output, or 0 to buffer without limits.</param>
+	void SetMemoryBudget(size_t bytes) override;
+
+	/// <summary>Copies a frame into the pending batch, and returns immediately 
+	/// (unless the pending batch exceeds the memory budget, in which case it first waits for the background thread).</summary>
+	/// <param name="frame">The positions and orientations of all agents at the current time.</param>
+	void AppendFrame(const TrajectoryFrame& frame) override;
+
+	/// <summary>Waits until the background thread has passed all frames to the wrapped writer, and then flushes that writer.</summary>
+	/// <returns>The result of the wrapped writer's Flush() method.</returns>
+	bool Flush() override;
+
+	/// <summary>Writes all remaining frames, stops the background thread, and deletes the wrapped writer.</summary>
+	~AsyncTrajectoryWriter();
+};
+
+#endif // LIB_ASYNCTRAJECTORYWRITER_H
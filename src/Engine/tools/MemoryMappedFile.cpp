@@ -0,0 +1,125 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#include <tools/MemoryMappedFile.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MemoryMappedFile::MemoryMappedFile() : data_(nullptr), size_(0),
+#ifdef _WIN32
+	fileHandle_(INVALID_HANDLE_VALUE), mappingHandle_(nullptr)
+#else
+	fileDescriptor_(-1)
+#endif
+{
+}
+
+MemoryMappedFile::~MemoryMappedFile()
+{
+	Close();
+}
+
+bool MemoryMappedFile::Open(const std::string& filename)
+{
+	Close();
+
+#ifdef _WIN32
+	fileHandle_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle_ == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle_, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	size_ = (size_t)fileSize.QuadPart;
+
+	mappingHandle_ = CreateFileMappingA(fileHandle_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle_ == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	data_ = (const char*)MapViewOfFile(mappingHandle_, FILE_MAP_READ, 0, 0, 0);
+#else
+	fileDescriptor_ = open(filename.c_str(), O_RDONLY);
+	if (fileDescriptor_ < 0)
+		return false;
+
+	struct stat fileStatus;
+	if (fstat(fileDescriptor_, &fileStatus) != 0 || fileStatus.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+	size_ = (size_t)fileStatus.st_size;
+
+	void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fileDescriptor_, 0);
+	data_ = (data == MAP_FAILED ? nullptr : (const char*)data);
+#endif
+
+	if (data_ == nullptr)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MemoryMappedFile::Close()
+{
+#ifdef _WIN32
+	if (data_ != nullptr)
+		UnmapViewOfFile(data_);
+	if (mappingHandle_ != nullptr)
+		CloseHandle(mappingHandle_);
+	if (fileHandle_ != INVALID_HANDLE_VALUE)
+		CloseHandle(fileHandle_);
+	mappingHandle_ = nullptr;
+	fileHandle_ = INVALID_HANDLE_VALUE;
+#else
+	if (data_ != nullptr)
+		munmap((void*)data_, size_);
+	if (fileDescriptor_ >= 0)
+		close(fileDescriptor_);
+	fileDescriptor_ = -1;
+#endif
+
+	data_ = nullptr;
+	size_ = 0;
+}
@@ -0,0 +1,73 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#ifndef LIB_MEMORY_MAPPED_FILE_H
+#define LIB_MEMORY_MAPPED_FILE_H
+
+#include <string>
+
+/// <summary>A read-only view of a file's contents, mapped into memory by the operating system.
+/// Data is only read from disk when it is actually accessed, so opening a large file is nearly instantaneous.</summary>
+class MemoryMappedFile
+{
+private:
+	const char* data_;
+	size_t size_;
+
+#ifdef _WIN32
+	void* fileHandle_;
+	void* mappingHandle_;
+#else
+	int fileDescriptor_;
+#endif
+
+public:
+	/// <summary>Creates a MemoryMappedFile that does not refer to any file yet.</summary>
+	MemoryMappedFile();
+
+	/// <summary>Unmaps the file, if necessary.</summary>
+	~MemoryMappedFile();
+
+	MemoryMappedFile(const MemoryMappedFile&) = delete;
+	MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+	/// <summary>Tries to map the given file into memory. Any previously opened file is closed first.</summary>
+	/// <param name="filename">The name of the file to open.</param>
+	/// <returns>true if the file was mapped successfully; false otherwise.</returns>
+	bool Open(const std::string& filename);
+
+	/// <summary>Unmaps the current file, if there is one.</summary>
+	void Close();
+
+	/// <summary>Returns a pointer to the file's contents, or nullptr if no file is open.</summary>
+	inline const char* GetData() const { return data_; }
+	/// <summary>Returns the size of the file in bytes.</summary>
+	inline size_t GetSize() const { return size_; }
+};
+
+#endif //LIB_MEMORY_MAPPED_FILE_H
@@ -0,0 +1,154 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#include <tools/SegmentBVH.h>
+#include <algorithm>
+#include <numeric>
+
+void SegmentBVH::AddSegments(const std::vector<LineSegment2D>& segments)
+{
+	segments_.insert(segments_.end(), segments.begin(), segments.end());
+}
+
+void SegmentBVH::Build()
+{
+	if (!HasPendingSegments())
+		return;
+
+	nrSegmentsInTree_ = segments_.size();
+	segmentOrder_.resize(segments_.size());
+	std::iota(segmentOrder_.begin(), segmentOrder_.end(), 0);
+
+	nodes_.clear();
+	if (segments_.empty())
+		return;
+
+	// a binary tree with at most one segment per leaf has fewer than 2n nodes
+	nodes_.reserve(2 * segments_.size());
+	nodes_.push_back(Node());
+	buildNode(0, 0, segments_.size());
+}
+
+void SegmentBVH::buildNode(size_t nodeIndex, size_t begin, size_t end)
+{
+	// compute the bounding box of all segments in this node, and of their midpoints
+	Vector2D boxMin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+	Vector2D boxMax(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+	Vector2D midMin(boxMin), midMax(boxMax);
+	for (size_t i = begin; i < end; ++i)
+	{
+		const LineSegment2D& segment = segments_[segmentOrder_[i]];
+		const Vector2D mid = (segment.first + segment.second) / 2;
+		boxMin = Vector2D(std::min({ boxMin.x, segment.first.x, segment.second.x }), std::min({ boxMin.y, segment.first.y, segment.second.y }));
+		boxMax = Vector2D(std::max({ boxMax.x, segment.first.x, segment.second.x }), std::max({ boxMax.y, segment.first.y, segment.second.y }));
+		midMin = Vector2D(std::min(midMin.x, mid.x), std::min(midMin.y, mid.y));
+		midMax = Vector2D(std::max(midMax.x, mid.x), std::max(midMax.y, mid.y));
+	}
+	nodes_[nodeIndex].boxMin = boxMin;
+	nodes_[nodeIndex].boxMax = boxMax;
+
+	// create a leaf if there are only a few segments left
+	if (end - begin <= maxLeafSize_)
+	{
+		nodes_[nodeIndex].first = begin;
+		nodes_[nodeIndex].count = end - begin;
+		return;
+	}
+
+	// otherwise, split the segments at the median midpoint along the longest axis
+	const bool splitX = (midMax.x - midMin.x) >= (midMax.y - midMin.y);
+	const size_t middle = begin + (end - begin) / 2;
+	std::nth_element(segmentOrder_.begin() + begin, segmentOrder_.begin() + middle, segmentOrder_.begin() + end,
+		[this, splitX](size_t a, size_t b)
+	{
+		const Vector2D midA = segments_[a].first + segments_[a].second;
+		const Vector2D midB = segments_[b].first + segments_[b].second;
+		return splitX ? midA.x < midB.x : midA.y < midB.y;
+	});
+
+	// create the two child nodes
+	const size_t firstChild = nodes_.size();
+	nodes_.push_back(Node());
+	nodes_.push_back(Node());
+	nodes_[nodeIndex].first = firstChild;
+	nodes_[nodeIndex].count = 0;
+
+	buildNode(firstChild, begin, middle);
+	buildNode(firstChild + 1, middle, end);
+}
+
+/// <summary>A per-thread buffer for the segments found by a query, so that queries do not have to allocate memory.</summary>
+static thread_local std::vector<size_t> foundSegments;
+
+void SegmentBVH::FindAllSegmentsInRange(const Vector2D& position, float radius, std::vector<LineSegment2D>& result) const
+{
+	const float radiusSquared = radius * radius;
+
+	// traverse the tree, skipping all nodes whose bounding box is too far away
+	foundSegments.clear();
+	size_t stack[64]; size_t stackSize = 0;
+	if (!nodes_.empty())
+		stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const Node& node = nodes_[stack[--stackSize]];
+
+		const float dx = std::max({ node.boxMin.x - position.x, 0.0f, position.x - node.boxMax.x });
+		const float dy = std::max({ node.boxMin.y - position.y, 0.0f, position.y - node.boxMax.y });
+		if (dx * dx + dy * dy > radiusSquared)
+			continue;
+
+		if (node.count > 0)
+		{
+			for (size_t i = node.first; i < node.first + node.count; ++i)
+			{
+				const LineSegment2D& segment = segments_[segmentOrder_[i]];
+				if (distanceToLineSquared(position, segment.first, segment.second, true) <= radiusSquared)
+					foundSegments.push_back(segmentOrder_[i]);
+			}
+		}
+		else
+		{
+			stack[stackSize++] = node.first;
+			stack[stackSize++] = node.first + 1;
+		}
+	}
+
+	// report the segments in their original order, so that the result does not depend on the shape of the tree
+	std::sort(foundSegments.begin(), foundSegments.end());
+	for (size_t index : foundSegments)
+		result.push_back(segments_[index]);
+
+	// check all pending segments one by one
+	for (size_t i = nrSegmentsInTree_; i < segments_.size(); ++i)
+	{
+		const LineSegment2D& segment = segments_[i];
+		if (distanceToLineSquared(position, segment.first, segment.second, true) <= radiusSquared)
+			result.push_back(segment);
+	}
+}
@@ -0,0 +1,92 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#ifndef LIB_SEGMENTBVH_H
+#define LIB_SEGMENTBVH_H
+
+#include <vector>
+#include <tools/vector2D.h>
+
+/// <summary>A bounding volume hierarchy (BVH) of static line segments, which can be used for finding all segments near a query point.</summary>
+/// <remarks>The hierarchy is a binary tree of axis-aligned bounding boxes. 
+/// Segments added via AddSegments() are first stored in a "pending" list, which queries check one by one, until Build() is called.
+/// This way, many segments can be added one after the other, and the hierarchy only needs to be built once afterwards.
+/// Queries do not change the hierarchy, so they can be performed in parallel.</remarks>
+class SegmentBVH
+{
+private:
+	/// <summary>A node in the hierarchy.</summary>
+	struct Node
+	{
+		/// <summary>The bottom-left corner of this node's bounding box.</summary>
+		Vector2D boxMin;
+		/// <summary>The top-right corner of this node's bounding box.</summary>
+		Vector2D boxMax;
+		/// <summary>For an internal node: the index of its first child node (the second child is stored directly after it).
+		/// For a leaf node: the index of its first segment in segmentOrder_.</summary>
+		size_t first;
+		/// <summary>The number of segments in this node if it is a leaf, or 0 if it is an internal node.</summary>
+		size_t count;
+	};
+
+	/// <summary>All segments that have been added, in their original order.</summary>
+	std::vector<LineSegment2D> segments_;
+	/// <summary>The number of segments (at the start of segments_) that are included in the tree. All other segments are pending.</summary>
+	size_t nrSegmentsInTree_ = 0;
+	/// <summary>The indices of all segments, ordered such that each leaf node refers to a consecutive range.</summary>
+	std::vector<size_t> segmentOrder_;
+	/// <summary>The nodes of the hierarchy. The root node (if it exists) is stored at index 0.</summary>
+	std::vector<Node> nodes_;
+
+	/// <summary>The maximum number of segments in a leaf node.</summary>
+	const size_t maxLeafSize_ = 4;
+
+public:
+	/// <summary>Adds a list of segments to this SegmentBVH. They will be included in the tree upon the next call to Build().</summary>
+	/// <param name="segments">A list of line segments.</param>
+	void AddSegments(const std::vector<LineSegment2D>& segments);
+
+	/// <summary>Builds the tree for all segments that have been added so far. Does nothing if there are no pending segments.</summary>
+	void Build();
+
+	/// <summary>Checks and returns whether there are segments that have been added after the last call to Build().</summary>
+	inline bool HasPendingSegments() const { return nrSegmentsInTree_ < segments_.size(); }
+
+	/// <summary>Finds all segments whose distance to a given position is at most a given radius.</summary>
+	/// <param name="position">A query position.</param>
+	/// <param name="radius">A query radius.</param>
+	/// <param name="result">[out] A list to which all segments within "radius" meters of "position" will be appended, 
+	/// in the order in which they were added.</param>
+	void FindAllSegmentsInRange(const Vector2D& position, float radius, std::vector<LineSegment2D>& result) const;
+
+private:
+	/// <summary>Recursively fills the node at a given index, using the range [begin, end) of segmentOrder_.</summary>
+	void buildNode(size_t nodeIndex, size_t begin, size_t end);
+};
+
+#endif //LIB_SEGMENTBVH_H
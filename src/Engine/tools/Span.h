@@ -0,0 +1,63 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#ifndef LIB_SPAN_H
+#define LIB_SPAN_H
+
+#include <vector>
+#include <cstddef>
+
+/// <summary>A read-only view of a contiguous range of elements that are stored elsewhere, e.g. a part of a larger buffer.</summary>
+/// <remarks>This is a minimal version of C++20's std::span. A Span does not own its elements, 
+/// so it is only valid as long as the storage that it refers to does not change.</remarks>
+template <typename T>
+class Span
+{
+private:
+	const T* begin_;
+	const T* end_;
+
+public:
+	/// <summary>Creates an empty Span.</summary>
+	Span() : begin_(nullptr), end_(nullptr) {}
+
+	/// <summary>Creates a Span of the given number of elements, starting at the given address.</summary>
+	Span(const T* begin, size_t size) : begin_(begin), end_(begin + size) {}
+
+	/// <summary>Creates a Span of all elements of a vector. The Span becomes invalid when the vector changes its size.</summary>
+	Span(const std::vector<T>& vector) : begin_(vector.data()), end_(vector.data() + vector.size()) {}
+
+	inline const T* begin() const { return begin_; }
+	inline const T* end() const { return end_; }
+	inline const T* data() const { return begin_; }
+	inline size_t size() const { return (size_t)(end_ - begin_); }
+	inline bool empty() const { return begin_ == end_; }
+	inline const T& operator[](size_t index) const { return begin_[index]; }
+};
+
+#endif //LIB_SPAN_H
@@ -46,6 +46,24 @@ struct TrajectoryPoint
 
 typedef std::vector<TrajectoryPoint> Trajectory;
 
+///<summary>A struct describing the positions and orientations of many agents at a particular time, stored in flat arrays.
+/// The i-th position and orientation belong to the agent with the i-th ID.</summary>
+struct TrajectoryFrame
+{
+	double time = 0;
+	std::vector<size_t> agentIDs;
+	std::vector<Vector2D> positions;
+	std::vector<Vector2D> orientations;
+
+	/// <summary>Sets the number of agents in this frame. The arrays keep their memory, so a frame can be reused without reallocations.</summary>
+	inline void Resize(size_t nrAgents)
+	{
+		agentIDs.resize(nrAgents);
+		positions.resize(nrAgents);
+		orientations.resize(nrAgents);
+	}
+};
+
 typedef std::map<size_t, TrajectoryPoint> AgentTrajectoryPoints;
 typedef std::map<size_t, Trajectory> AgentTrajectories;
 
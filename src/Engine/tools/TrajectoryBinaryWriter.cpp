@@ -0,0 +1,186 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#include <tools/TrajectoryBinaryWriter.h>
+#include <cstring>
+
+const char TrajectoryBinaryWriter::Magic[8] = { 'U', 'M', 'A', 'N', 'S', 'T', 'R', 'J' };
+
+bool TrajectoryBinaryWriter::SetOutputFile(const std::string& filename)
+{
+	std::lock_guard<std::mutex> lock(mtx_);
+
+	// complete the previous file, if any
+	close();
+
+	file_.open(filename, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!file_.is_open())
+		return false;
+
+	filename_ = filename;
+	index_.clear();
+	dataEnd_ = sizeof(FileHeader);
+
+	// write a header without an index; frames will be appended after it
+	writeHeader(0, 0);
+	file_.flush();
+
+	return (bool)file_;
+}
+
+void TrajectoryBinaryWriter::AppendFrame(const TrajectoryFrame& data)
+{
+	const size_t n = data.agentIDs.size();
+
+	Frame frame;
+	frame.time = data.time;
+	frame.ids.resize(n);
+	frame.x.resize(n);
+	frame.y.resize(n);
+	frame.orientationX.resize(n);
+	frame.orientationY.resize(n);
+
+	for (size_t i = 0; i < n; ++i)
+	{
+		frame.ids[i] = (uint64_t)data.agentIDs[i];
+		frame.x[i] = data.positions[i].x;
+		frame.y[i] = data.positions[i].y;
+		frame.orientationX[i] = data.orientations[i].x;
+		frame.orientationY[i] = data.orientations[i].y;
+	}
+
+	mtx_.lock();
+	frames_.push_back(std::move(frame));
+	bufferedBytes_ += sizeof(FrameHeader) + n * (sizeof(uint64_t) + 4 * sizeof(float));
+	const bool exceedsBudget = memoryBudget_ > 0 && bufferedBytes_ >= memoryBudget_;
+	mtx_.unlock();
+
+	if (flushImmediately || exceedsBudget)
+		Flush();
+}
+
+bool TrajectoryBinaryWriter::Flush()
+{
+	std::lock_guard<std::mutex> lock(mtx_);
+
+	if (!file_.is_open())
+		return false;
+
+	writeFrames();
+	file_.flush();
+
+	return (bool)file_;
+}
+
+bool TrajectoryBinaryWriter::Close()
+{
+	std::lock_guard<std::mutex> lock(mtx_);
+	return close();
+}
+
+void TrajectoryBinaryWriter::writeFrames()
+{
+	// append the new frames after the previous ones
+	file_.seekp(dataEnd_);
+	for (const Frame& frame : frames_)
+	{
+		const size_t n = frame.ids.size();
+		index_.push_back({ frame.time, dataEnd_, (uint64_t)n });
+
+		const FrameHeader frameHeader = { frame.time, (uint64_t)n };
+		file_.write((const char*)&frameHeader, sizeof(frameHeader));
+		file_.write((const char*)frame.ids.data(), n * sizeof(uint64_t));
+		file_.write((const char*)frame.x.data(), n * sizeof(float));
+		file_.write((const char*)frame.y.data(), n * sizeof(float));
+		file_.write((const char*)frame.orientationX.data(), n * sizeof(float));
+		file_.write((const char*)frame.orientationY.data(), n * sizeof(float));
+
+		dataEnd_ += sizeof(FrameHeader) + n * (sizeof(uint64_t) + 4 * sizeof(float));
+	}
+	frames_.clear();
+	bufferedBytes_ = 0;
+}
+
+bool TrajectoryBinaryWriter::close()
+{
+	if (!file_.is_open())
+		return false;
+
+	writeFrames();
+
+	// write the index after the frames, and let the header point to it
+	file_.write((const char*)index_.data(), index_.size() * sizeof(IndexEntry));
+	writeHeader(dataEnd_, index_.size());
+
+	file_.close();
+	return !file_.fail();
+}
+
+void TrajectoryBinaryWriter::writeHeader(uint64_t indexOffset, uint64_t nrFrames)
+{
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, Magic, sizeof(Magic));
+	header.version = Version;
+	header.byteOrderMark = ByteOrderMark;
+	header.indexOffset = indexOffset;
+	header.nrFrames = nrFrames;
+
+	file_.seekp(0);
+	file_.write((const char*)&header, sizeof(header));
+}
+
+bool TrajectoryBinaryWriter::WriteTrajectories(const AgentTrajectories& trajectories, const std::string& filename)
+{
+	// group all points by time
+	std::map<double, TrajectoryFrame> frames;
+	for (const auto& trajectory : trajectories)
+	{
+		for (const TrajectoryPoint& point : trajectory.second)
+		{
+			TrajectoryFrame& frame = frames[point.time];
+			frame.time = point.time;
+			frame.agentIDs.push_back(trajectory.first);
+			frame.positions.push_back(point.position);
+			frame.orientations.push_back(point.orientation);
+		}
+	}
+
+	// write the frames in order
+	TrajectoryBinaryWriter writer(false);
+	if (!writer.SetOutputFile(filename))
+		return false;
+	for (const auto& frame : frames)
+		writer.AppendFrame(frame.second);
+	return writer.Close();
+}
+
+TrajectoryBinaryWriter::~TrajectoryBinaryWriter()
+{
+	Close();
+}
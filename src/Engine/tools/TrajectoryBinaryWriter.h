@@ -0,0 +1,166 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#ifndef LIB_TRAJECTORYBINARYWRITER_H
+#define LIB_TRAJECTORYBINARYWRITER_H
+
+#include <tools/TrajectoryWriter.h>
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <fstream>
+#include <cstdint>
+
+/// <summary>A class for writing agent trajectories to a single binary file, one block per simulation frame.</summary>
+/// <remarks>The file starts with a FileHeader, followed by the frames. Each frame starts with a FrameHeader, 
+/// followed by its data in columns: all agent IDs (as 64-bit integers), then all x coordinates, y coordinates, 
+/// x components of the viewing direction, and y components of the viewing direction (as floats).
+/// Flush() only appends frames to the file. When the writer is closed (see Close()), it adds a frame index at the end of the file: 
+/// one IndexEntry per frame, and it lets the FileHeader point to this index.
+/// A file that was never closed (e.g. because the program crashed) has no index; its frames can still be recovered 
+/// by reading the frame headers one after another, up to the last complete frame.
+/// Use TrajectoryCSVReader::ReadTrajectoriesFromBinaryFile() to load such a file.</remarks>
+class TrajectoryBinaryWriter : public TrajectoryWriter
+{
+public:
+	/// <summary>The version of the format written by this class.</summary>
+	static const uint32_t Version = 1;
+	/// <summary>The value of FileHeader::byteOrderMark in files written on a machine with the same byte order.</summary>
+	static const uint32_t ByteOrderMark = 0x01020304;
+	/// <summary>The signature at the start of each file.</summary>
+	static const char Magic[8];
+
+	/// <summary>The header at the start of a binary trajectory file.</summary>
+	struct FileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t byteOrderMark;
+		/// <summary>The position of the frame index, in bytes from the start of the file, or 0 if the file has no index yet.</summary>
+		uint64_t indexOffset;
+		/// <summary>The number of frames in the file (and in the frame index).</summary>
+		uint64_t nrFrames;
+	};
+
+	/// <summary>The header at the start of each frame.</summary>
+	struct FrameHeader
+	{
+		double time;
+		uint64_t nrAgents;
+	};
+
+	/// <summary>An entry in the frame index at the end of the file.</summary>
+	struct IndexEntry
+	{
+		double time;
+		/// <summary>The position of the frame's FrameHeader, in bytes from the start of the file.</summary>
+		uint64_t offset;
+		uint64_t nrAgents;
+	};
+
+private:
+	/// <summary>The data of one frame, stored in columns.</summary>
+	struct Frame
+	{
+		double time;
+		std::vector<uint64_t> ids;
+		std::vector<float> x, y, orientationX, orientationY;
+	};
+
+	std::mutex mtx_;
+	std::fstream file_;
+	std::string filename_;
+
+	/// <summary>The frames that have been appended but not yet written.</summary>
+	std::vector<Frame> frames_;
+	/// <summary>The total size of all frames in frames_, in bytes.</summary>
+	size_t bufferedBytes_ = 0;
+	/// <summary>The index entries of all frames that have been written so far.</summary>
+	std::vector<IndexEntry> index_;
+	/// <summary>The position in the file where the next frame should be written.</summary>
+	uint64_t dataEnd_;
+
+	/// <summary>Whether or not this TrajectoryBinaryWriter immediately calls Flush() at the end of each call to AppendAgentData().</summary>
+	bool flushImmediately;
+
+	/// <summary>Writes the file header at the start of the file.</summary>
+	/// <param name="indexOffset">The position of the frame index, or 0 if the file does not have an index yet.</param>
+	/// <param name="nrFrames">The number of frames in the frame index.</param>
+	void writeHeader(uint64_t indexOffset, uint64_t nrFrames);
+
+	/// <summary>Appends all buffered frames to the file, and then cleans the buffer. The caller should hold mtx_.</summary>
+	void writeFrames();
+
+	/// <summary>Writes all buffered frames and the frame index, and closes the file. The caller should hold mtx_.</summary>
+	/// <returns>true if the file was successfully completed; false otherwise.</returns>
+	bool close();
+
+public:
+	/// <summary>Creates a TrajectoryBinaryWriter object.</summary>
+	/// <param name="flushImmediately">Whether or not this TrajectoryBinaryWriter should immediately call Flush() at the end of each call to AppendAgentData().</param>
+	TrajectoryBinaryWriter(bool flushImmediately) : dataEnd_(0), flushImmediately(flushImmediately) {}
+
+	/// <summary>Tries to create (or overwrite) the file to which the output will be written.</summary>
+	/// <param name="filename">The path to the desired output file. Its directory should already exist.</param>
+	/// <returns>true if the file was successfully created; false otherwise.</returns>
+	bool SetOutputFile(const std::string& filename);
+
+	/// <summary>Appends the data of one simulation frame to the output buffer.
+	/// Note: if the flushImmediately parameter is false, the result is not yet written to the file, and you need to call Flush() yourself.</summary>
+	/// <param name="frame">The positions and orientations of all agents at the current time.</param>
+	void AppendFrame(const TrajectoryFrame& frame) override;
+
+	/// <summary>Appends all buffered frames to the file, and then cleans the buffer.</summary>
+	/// <remarks>This does not update the frame index, so the cost of a call only depends on the number of buffered frames.</remarks>
+	/// <returns>true if the output was successfully written; 
+	/// false otherwise, e.g. if the output file was never specified via SetOutputFile().</returns>
+	bool Flush() override;
+
+	/// <summary>Writes all buffered frames and the frame index, and closes the file.</summary>
+	/// <remarks>After this, nothing more can be written until you call SetOutputFile() again.</remarks>
+	/// <returns>true if the file was successfully completed; 
+	/// false otherwise, e.g. if the output file was never specified via SetOutputFile().</returns>
+	bool Close();
+
+	/// <summary>Writes a complete set of trajectories to a binary file at once, e.g. to archive trajectories that were loaded from CSV files.</summary>
+	/// <remarks>The points of all agents are grouped into frames by their time stamps.</remarks>
+	/// <param name="trajectories">The trajectories to write.</param>
+	/// <param name="filename">The name of the file to create (or overwrite).</param>
+	/// <returns>true if the file was written successfully; false otherwise.</returns>
+	static bool WriteTrajectories(const AgentTrajectories& trajectories, const std::string& filename);
+
+	/// <summary>Cleans up this TrajectoryBinaryWriter for removal. This includes a final call to Close().</summary>
+	~TrajectoryBinaryWriter();
+};
+
+static_assert(sizeof(TrajectoryBinaryWriter::FileHeader) == 32, "The binary trajectory header should not contain implicit padding");
+static_assert(sizeof(TrajectoryBinaryWriter::FrameHeader) == 16, "The binary frame header should not contain implicit padding");
+static_assert(sizeof(TrajectoryBinaryWriter::IndexEntry) == 24, "The binary index entry should not contain implicit padding");
+
+#endif // LIB_TRAJECTORYBINARYWRITER_H
@@ -28,11 +28,45 @@
 
 #include <tools/TrajectoryCSVReader.h>
 #include <tools/HelperFunctions.h>
+#include <tools/TrajectoryBinaryWriter.h>
+#include <tools/MemoryMappedFile.h>
+#include <core/ThreadPool.h>
 
-#include <fstream>
 #include <filesystem>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
 
-AgentTrajectories TrajectoryCSVReader::ReadTrajectoriesFromCSVFolder(const std::string& foldername)
+/// <summary>Parses a number at the start of a CSV field, and moves the pointer to the end of the number.
+/// Like std::istream, this skips leading whitespace and ignores any characters after the number.</summary>
+/// <returns>true if a number was found; false otherwise.</returns>
+template <typename T> static bool parseNumber(const char*& ptr, const char* end, T& value)
+{
+	while (ptr < end && (*ptr == ' ' || *ptr == '\t'))
+		++ptr;
+	if (ptr < end && *ptr == '+')
+		++ptr;
+
+	const auto& result = std::from_chars(ptr, end, value);
+	if (result.ptr == ptr)
+		return false;
+
+	// numbers that are too small to represent (e.g. denormals in an orientation) are read as zero
+	if (result.ec == std::errc::result_out_of_range)
+		value = 0;
+
+	ptr = result.ptr;
+	return true;
+}
+
+/// <summary>Moves a pointer to the start of the next CSV field in a line, or to the end of the line if there is no next field.</summary>
+static void skipToNextField(const char*& ptr, const char* end)
+{
+	const char* comma = (const char*)memchr(ptr, ',', end - ptr);
+	ptr = (comma == nullptr ? end : comma + 1);
+}
+
+AgentTrajectories TrajectoryCSVReader::ReadTrajectoriesFromCSVFolder(const std::string& foldername, int nrThreads)
 {
 	AgentTrajectories result;
 
@@ -40,7 +74,8 @@ AgentTrajectories TrajectoryCSVReader::ReadTrajectoriesFromCSVFolder(const std::
 	if (!HelperFunctions::DirectoryExists(foldername))
 		return result;
 
-	// loop over the folder (non-recursively)
+	// loop over the folder (non-recursively), and collect the files to read
+	std::vector<std::pair<size_t, std::string>> files;
 	using namespace std::filesystem;
 	directory_iterator end_itr;
 	for (directory_iterator itr(foldername); itr != end_itr; ++itr)
@@ -51,25 +86,41 @@ AgentTrajectories TrajectoryCSVReader::ReadTrajectoriesFromCSVFolder(const std::
 
 		// check if it has the CSV extension
 		const std::string& filename = itr->path().string();
-		if (filename.substr(filename.length()-4) != ".csv")
+		if (filename.length() < 4 || filename.substr(filename.length()-4) != ".csv")
 			continue;
 
 		// check if an agent ID can be obtained from the filename
 		const size_t index_underscore = filename.find_last_of("_");
 		if (index_underscore == std::string::npos)
 			continue;
-		const std::string& number = filename.substr(index_underscore + 1, filename.length() - index_underscore - 5);
+		const char* numberStart = filename.data() + index_underscore + 1;
+		const char* numberEnd = filename.data() + filename.length() - 4;
+		size_t agentID;
+		const auto& parseResult = std::from_chars(numberStart, numberEnd, agentID);
+		if (parseResult.ec == std::errc() && parseResult.ptr == numberEnd)
+			files.push_back({ agentID, filename });
+	}
+
+	// read the files in parallel, on a pool of our own; files that cannot be read are skipped
+	std::vector<Trajectory> trajectories(files.size());
+	std::vector<char> succeeded(files.size(), 0);
+
+	ThreadPool threadPool(nrThreads);
+	threadPool.ParallelFor(files.size(), [&](size_t i)
+	{
 		try
 		{
-			size_t agentID = HelperFunctions::ParseInt(number);
-			if (agentID >= 0)
-			{
-				// read a single trajectory; add it to the result
-				result.insert({ agentID, ReadTrajectoryFromCSVFile(filename) });
-			}
+			trajectories[i] = ReadTrajectoryFromCSVFile(files[i].second);
+			succeeded[i] = 1;
 		}
-		catch (std::exception&) {}
+		catch (std::string&) {}
+	});
 
+	// add the trajectories to the result
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		if (succeeded[i])
+			result.insert({ files[i].first, std::move(trajectories[i]) });
 	}
 
 	return result;
@@ -77,45 +128,132 @@ AgentTrajectories TrajectoryCSVReader::ReadTrajectoriesFromCSVFolder(const std::
 
 Trajectory TrajectoryCSVReader::ReadTrajectoryFromCSVFile(const std::string& filename)
 {
-	// open the file
-	std::ifstream fs;
-	fs.open(filename);
-	if (!fs.is_open())
+	Trajectory result;
+
+	// map the file into memory; an empty file is valid and contains no points
+	if (!std::filesystem::exists(filename))
 		throw std::string("CSV file not found.");
+	MemoryMappedFile file;
+	if (!file.Open(filename))
+		return result;
 
-	Trajectory result;
-	std::string line;
-	while (std::getline(fs, line))
+	const char* ptr = file.GetData();
+	const char* end = ptr + file.GetSize();
+
+	// a rough estimate of the number of lines, to avoid reallocations
+	result.reserve(file.GetSize() / 40);
+
+	while (ptr < end)
 	{
-		const auto& parts = HelperFunctions::SplitString(line, ',');
-		if (parts.size() < 3)
-			continue;
+		// find the end of the current line, and ignore a carriage return at the end
+		const char* newline = (const char*)memchr(ptr, '\n', end - ptr);
+		const char* lineEnd = (newline == nullptr ? end : newline);
+		const char* next = (newline == nullptr ? end : newline + 1);
+		if (lineEnd > ptr && *(lineEnd - 1) == '\r')
+			--lineEnd;
 
-		TrajectoryPoint point;
+		// a line needs at least 3 fields: time, x, and y
+		const size_t nrFields = 1 + std::count(ptr, lineEnd, ',');
+		if (nrFields >= 3)
+		{
+			TrajectoryPoint point;
+			point.orientation = Vector2D(0, 0);
 
-		// read the time
-		point.time = HelperFunctions::ParseDouble(parts[0]);
+			// read the time and the position
+			bool valid = parseNumber(ptr, lineEnd, point.time);
+			skipToNextField(ptr, lineEnd);
+			valid = valid && parseNumber(ptr, lineEnd, point.position.x);
+			skipToNextField(ptr, lineEnd);
+			valid = valid && parseNumber(ptr, lineEnd, point.position.y);
 
-		// read the position
-		point.position.x = HelperFunctions::ParseFloat(parts[1]);
-		point.position.y = HelperFunctions::ParseFloat(parts[2]);
+			// read the orientation, if it exists
+			if (valid && nrFields >= 5)
+			{
+				skipToNextField(ptr, lineEnd);
+				valid = parseNumber(ptr, lineEnd, point.orientation.x);
+				skipToNextField(ptr, lineEnd);
+				valid = valid && parseNumber(ptr, lineEnd, point.orientation.y);
+			}
 
-		if (parts.size() >= 5)
-		{
-			// read the orientation
-			point.orientation.x = HelperFunctions::ParseFloat(parts[3]);
-			point.orientation.y = HelperFunctions::ParseFloat(parts[4]);
+			if (!valid)
+				throw std::string("Could not parse CSV file " + filename + ".");
+
+			// add this point to the result
+			result.push_back(point);
 		}
-		else
+
+		ptr = next;
+	}
+
+	return result;
+}
+
+/// <summary>Adds the points of one frame of a binary trajectory file to a set of trajectories.</summary>
+/// <param name="frame">A pointer to the frame's data, directly after its FrameHeader.</param>
+/// <param name="time">The time of the frame.</param>
+/// <param name="n">The number of agents in the frame.</param>
+/// <param name="result">[out] The trajectories to which the points should be added.</param>
+static void readBinaryFrame(const char* frame, double time, size_t n, AgentTrajectories& result)
+{
+	const uint64_t* ids = (const uint64_t*)frame;
+	const float* x = (const float*)(frame + n * sizeof(uint64_t));
+	const float* y = x + n;
+	const float* orientationX = y + n;
+	const float* orientationY = orientationX + n;
+
+	for (size_t j = 0; j < n; ++j)
+		result[(size_t)ids[j]].push_back(TrajectoryPoint(time, Vector2D(x[j], y[j]), Vector2D(orientationX[j], orientationY[j])));
+}
+
+AgentTrajectories TrajectoryCSVReader::ReadTrajectoriesFromBinaryFile(const std::string& filename)
+{
+	using Writer = TrajectoryBinaryWriter;
+	AgentTrajectories result;
+
+	// map the file into memory, and check its header
+	MemoryMappedFile file;
+	if (!file.Open(filename) || file.GetSize() < sizeof(Writer::FileHeader))
+		return result;
+
+	const char* data = file.GetData();
+	const size_t size = file.GetSize();
+	const Writer::FileHeader* header = (const Writer::FileHeader*)data;
+	if (memcmp(header->magic, Writer::Magic, sizeof(Writer::Magic)) != 0
+		|| header->version != Writer::Version || header->byteOrderMark != Writer::ByteOrderMark
+		|| header->indexOffset > size || header->nrFrames > (size - header->indexOffset) / sizeof(Writer::IndexEntry))
+		return result;
+
+	const size_t bytesPerAgent = sizeof(uint64_t) + 4 * sizeof(float);
+
+	// if the writer was never closed, there is no index: read the frames one after another, and ignore an incomplete last frame
+	if (header->indexOffset == 0)
+	{
+		size_t offset = sizeof(Writer::FileHeader);
+		while (size - offset >= sizeof(Writer::FrameHeader))
 		{
-			// leave the orientation empty
-			point.orientation.x = 0;
-			point.orientation.y = 0;
+			const Writer::FrameHeader* frameHeader = (const Writer::FrameHeader*)(data + offset);
+			offset += sizeof(Writer::FrameHeader);
+			if (frameHeader->nrAgents > (size - offset) / bytesPerAgent)
+				break;
+
+			const size_t n = (size_t)frameHeader->nrAgents;
+			readBinaryFrame(data + offset, frameHeader->time, n, result);
+			offset += n * bytesPerAgent;
 		}
+		return result;
+	}
 
-		// add this point to the result
-		result.push_back(point);
+	// read the frames one by one, via the index
+	const Writer::IndexEntry* index = (const Writer::IndexEntry*)(data + header->indexOffset);
+	for (size_t i = 0; i < header->nrFrames; ++i)
+	{
+		const size_t n = (size_t)index[i].nrAgents;
+		const size_t frameSize = sizeof(Writer::FrameHeader) + n * bytesPerAgent;
+		if (index[i].offset > header->indexOffset || frameSize > header->indexOffset - index[i].offset)
+			return AgentTrajectories();
+
+		readBinaryFrame(data + index[i].offset + sizeof(Writer::FrameHeader), index[i].time, n, result);
 	}
 
 	return result;
-}
\ No newline at end of file
+}
@@ -45,12 +45,22 @@ public:
 	/// <summary>Loads a set of agent trajectories from a folder with CSV files.</summary>
 	/// <remarks>This function loads all CSV files that have a name in the format "prefix_ID.csv". 
 	/// Here, "prefix" can be any prefix, and "ID" must be a non-negative integer that is unique within that folder. 
-	/// Files that do not meet these constraints will not be loaded.</remarks>
+	/// Files that do not meet these constraints will not be loaded, and neither will files that cannot be parsed.
+	/// The files are read in parallel, on a ThreadPool with the given number of threads that exists only during this call.</remarks>
+	/// <param name="folderName">The folder that contains the CSV files.</param>
+	/// <param name="nrThreads">The number of threads that should read files, including the calling thread.</param>
 	/// <returns>A set of agent IDs and trajectories. The result is empty if the loading fails.</returns>
-	static AgentTrajectories ReadTrajectoriesFromCSVFolder(const std::string& folderName);
+	static AgentTrajectories ReadTrajectoriesFromCSVFolder(const std::string& folderName, int nrThreads = 1);
 
 	/// <summary>Loads a trajectory from a single CSV file.</summary>
+	/// <remarks>The file is mapped into memory and parsed in place, without creating a string per line or per number.
+	/// Lines with fewer than 3 fields are ignored. If the file does not exist or contains an invalid number, this function throws a std::string.</remarks>
 	static Trajectory ReadTrajectoryFromCSVFile(const std::string& filename);
+
+	/// <summary>Loads a set of agent trajectories from a binary file written by TrajectoryBinaryWriter.</summary>
+	/// <remarks>If the writer was not closed properly, the file has no frame index; all complete frames are then recovered by scanning the file.</remarks>
+	/// <returns>A set of agent IDs and trajectories. The result is empty if the loading fails.</returns>
+	static AgentTrajectories ReadTrajectoriesFromBinaryFile(const std::string& filename);
 };
 
 #endif // LIB_TRAJECTORYCSVREADER_H
@@ -50,8 +50,9 @@ bool TrajectoryCSVWriter::Flush()
 		return false;
 
     mtx_.lock();
-	AgentTrajectories pos_log_copy = pos_log_;
-    pos_log_.clear();
+	AgentTrajectories pos_log_copy;
+	pos_log_copy.swap(pos_log_);
+	nrBufferedPoints_ = 0;
     mtx_.unlock();
 
     for (auto& data : pos_log_copy)
@@ -77,9 +78,24 @@ void TrajectoryCSVWriter::AppendAgentData(const AgentTrajectoryPoints& data)
     mtx_.lock();
     for (const auto& d : data)
         pos_log_[d.first].push_back(d.second);
+    nrBufferedPoints_ += data.size();
+    const bool exceedsBudget = memoryBudget_ > 0 && nrBufferedPoints_ * sizeof(TrajectoryPoint) >= memoryBudget_;
     mtx_.unlock();
 
-	if (flushImmediately)
+    if (flushImmediately || exceedsBudget)
+        Flush();
+}
+
+void TrajectoryCSVWriter::AppendFrame(const TrajectoryFrame& frame)
+{
+	mtx_.lock();
+	for (size_t i = 0; i < frame.agentIDs.size(); ++i)
+		pos_log_[frame.agentIDs[i]].push_back(TrajectoryPoint(frame.time, frame.positions[i], frame.orientations[i]));
+	nrBufferedPoints_ += frame.agentIDs.size();
+	const bool exceedsBudget = memoryBudget_ > 0 && nrBufferedPoints_ * sizeof(TrajectoryPoint) >= memoryBudget_;
+	mtx_.unlock();
+
+	if (flushImmediately || exceedsBudget)
 		Flush();
 }
 
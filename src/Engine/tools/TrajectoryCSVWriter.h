@@ -29,7 +29,7 @@
 #ifndef LIB_TRAJECTORYCSVWRITER_H
 #define LIB_TRAJECTORYCSVWRITER_H
 
-#include <tools/Trajectory.h>
+#include <tools/TrajectoryWriter.h>
 
 #include <string>
 #include <vector>
@@ -40,7 +40,7 @@ typedef std::map<size_t, TrajectoryPoint> AgentTrajectoryPoints;
 typedef std::map<size_t, Trajectory> AgentTrajectories;
 
 /// <summary>A class for writing agent trajectories to CSV files in a specified folder.</summary>
-class TrajectoryCSVWriter
+class TrajectoryCSVWriter : public TrajectoryWriter
 {
 private:
     std::mutex mtx_;
@@ -50,6 +50,9 @@ private:
 	/// <summary>Whether or not this TrajectoryCSVWriter immediately calls Flush() at the end of each call to AppendAgentPositions().</summary>
 	bool flushImmediately;
 
+	/// <summary>The number of trajectory points in pos_log_.</summary>
+	size_t nrBufferedPoints_ = 0;
+
 public:
 	/// <summary>Creates a TrajectoryCSVWriter object.</summary>
 	/// <param name="flushImmediately">Whether or not this TrajectoryCSVWriter should immediately call Flush() at the end of each call to AppendAgentPositions().</param>
@@ -68,11 +71,16 @@ public:
 	/// <param name="t">The current simulation time.</param>
     void AppendAgentData(const AgentTrajectoryPoints& data);
 
+	/// <summary>Appends the data of one simulation frame to the output buffer. 
+	/// Note: if the flushImmediately parameter is false, the result is not yet written to a file, and you need to call Flush() yourself.</summary>
+	/// <param name="frame">The positions and orientations of all agents at the current time.</param>
+	void AppendFrame(const TrajectoryFrame& frame) override;
+
 	/// <summary>Writes all buffered output to CSV files, and then cleans the buffer.</summary>
 	/// <remarks>Call this method whenever you have finished gathering trajectory data via AppendAgentPositions().</remarks>
 	/// <returns>true if the output was successfully written; 
 	/// false otherwise, e.g. if the output folder was never specified via SetOutputDirectory().</returns>
-	bool Flush();
+	bool Flush() override;
 
 	/// <summary>Cleans up this TrajectoryCSVWriter for removal. This includes a final call to flush().</summary>
 	~TrajectoryCSVWriter();
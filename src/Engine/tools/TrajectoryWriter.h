@@ -0,0 +1,60 @@
+/* UMANS: Unified Microscopic Agent Navigation Simulator
+** MIT License
+** Copyright (C) 2018-2020  Inria Rennes Bretagne Atlantique - Rainbow - Julien Pettré
+**
+** Permission is hereby granted, free of charge, to any person obtaining
+** a copy of this software and associated documentation files (the
+** "Software"), to deal in the Software without restriction, including
+** without limitation the rights to use, copy, modify, merge, publish,
+** distribute, sublicense, and/or sell copies of the Software, and to
+** permit persons to whom the Software is furnished to do so, subject
+** to the following conditions:
+**
+** The above copyright notice and this permission notice shall be
+** included in all copies or substantial portions of the Software.
+**
+** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+** EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+** OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+** NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+** LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+** ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+** CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+**
+** Contact: crowd_group@inria.fr
+** Website: https://project.inria.fr/crowdscience/
+** See the file AUTHORS.md for a list of all contributors.
+*/
+
+#ifndef LIB_TRAJECTORYWRITER_H
+#define LIB_TRAJECTORYWRITER_H
+
+#include <tools/Trajectory.h>
+
+/// <summary>Abstract base class for objects that write agent trajectories to files, e.g. TrajectoryCSVWriter or TrajectoryBinaryWriter.</summary>
+class TrajectoryWriter
+{
+protected:
+	/// <summary>The maximum number of bytes that this writer should use for buffered output, or 0 if there is no limit.</summary>
+	size_t memoryBudget_ = 0;
+
+public:
+	/// <summary>Limits the amount of memory that this writer uses for buffered output. 
+	/// When the buffered output exceeds this limit, the writer spills it to its files, as if Flush() were called.</summary>
+	/// <param name="bytes">The maximum number of bytes to use for buffered output, or 0 to buffer without limits.</param>
+	virtual void SetMemoryBudget(size_t bytes) { memoryBudget_ = bytes; }
+
+	/// <summary>Appends the data of one simulation frame to the output buffer.
+	/// Depending on the writer, the result may not be written to a file until you call Flush().</summary>
+	/// <param name="frame">The positions and orientations of all agents at the current time.</param>
+	virtual void AppendFrame(const TrajectoryFrame& frame) = 0;
+
+	/// <summary>Writes all buffered output to files, and then cleans the buffer.</summary>
+	/// <returns>true if the output was successfully written; false otherwise.</returns>
+	virtual bool Flush() = 0;
+
+	/// <summary>Cleans up this TrajectoryWriter for removal.</summary>
+	virtual ~TrajectoryWriter() {}
+};
+
+#endif // LIB_TRAJECTORYWRITER_H
@@ -516,6 +516,8 @@ void UMANSOpenGLWidget::drawAgentCostCircle(Agent& agent)
 	// If the agent uses ORCA, then the code above has caused its internal ORCA data to be overwritten. 
 	// To prevent changes in behavior, we now "invalidate" this internal data, so that it will be recomputed in the next frame as usual.
 	agent.GetOrcaSolution().currentSimulationTime = -1;
+	// The same holds for the data that cost functions have prepared for this agent.
+	agent.ResetCostFunctionScratch();
 
 	// - draw these values in a circle
 
@@ -776,6 +778,7 @@ void UMANSOpenGLWidget::mouseReleaseEvent(QMouseEvent *event)
 		if (inAgentSelectMode)
 		{
 			// select the agent closest to the mouse position, if it is nearby enough
+			simulator->GetWorld()->RefreshSpatialIndex();
 			const auto& nearest = simulator->GetWorld()->ComputeNeighbors(p, 50, nullptr);
 			if (!nearest.first.empty())
 			{
@@ -785,7 +788,7 @@ void UMANSOpenGLWidget::mouseReleaseEvent(QMouseEvent *event)
 
 				// if the agent is close enough, select it
 				if (screenDistance <= 50)
-					setActiveAgent(simulator->GetWorld()->GetAgent(nearest.first[0].realAgent->getID()));
+					setActiveAgent(simulator->GetWorld()->GetAgents()[nearest.first[0].GetIndex()]);
 
 				// otherwise, don't select anything
 				else
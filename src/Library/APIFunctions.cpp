@@ -32,9 +32,9 @@
 
 #include <core/crowdSimulator.h>
 #include <algorithm>
-#include <omp.h>
 #include <cstring>
 #include <string>
+#include <fstream>
 
 extern "C"
 {
@@ -52,8 +52,6 @@ extern "C"
 
 	API_FUNCTION bool StartSimulation(const char* configFileName, int numberOfThreads)
 	{
-    	omp_set_num_threads(numberOfThreads);
-
 		// initialize a new crowd simulation; we'll fill it with the contents of the given config file
 		cs = CrowdSimulator::FromConfigFile(configFileName);
 		if (cs == nullptr)
@@ -108,8 +106,7 @@ extern "C"
 			resizeAgentData(true);
 
 		// fill the AgentData array with the current agent data
-#pragma omp parallel for
-		for (int i = 0; i < (int)agents.size(); ++i)
+		cs->GetWorld()->GetThreadPool().ParallelFor(agents.size(), [&agents](size_t i)
 		{
 			agentData[i].id = (int)agents[i]->getID();
 			agentData[i].position_x = agents[i]->getPosition().x;
@@ -118,7 +115,7 @@ extern "C"
 			agentData[i].velocity_y = agents[i]->getVelocity().y;
 			agentData[i].viewingDirection_x = agents[i]->getViewingDirection().x;
 			agentData[i].viewingDirection_y = agents[i]->getViewingDirection().y;
-		}
+		});
 
 		// store references to these results, for the client program to use
 		result_agentData = agentData;
@@ -129,8 +126,7 @@ extern "C"
 
 	API_FUNCTION bool SetAgentPositions(AgentData* agentData, int nrAgents)
 	{
-#pragma omp parallel for
-		for (int i = 0; i < nrAgents; ++i)
+		cs->GetWorld()->GetThreadPool().ParallelFor(nrAgents > 0 ? (size_t)nrAgents : 0, [agentData](size_t i)
 		{
 			// find the agent with the given ID
 			auto agent = cs->GetWorld()->GetAgent(agentData[i].id);
@@ -144,8 +140,7 @@ extern "C"
 				agent->setPosition(position);
 				agent->setVelocity_ExternalApplication(velocity, viewingDirection);
 			}
-
-		}
+		});
 		return true;
 	}
 
@@ -295,4 +290,69 @@ extern "C"
 		return true;
 	}
 
+
+	API_FUNCTION bool SetProfilingEnabled(bool enabled)
+	{
+		if (cs == nullptr)
+			return false;
+
+		cs->SetProfilingEnabled(enabled);
+		return true;
+	}
+
+	API_FUNCTION bool GetProfileData(ProfileData& result_profileData)
+	{
+		if (cs == nullptr || cs->GetWorld()->GetProfiler() == nullptr)
+			return false;
+
+		static_assert(sizeof(ProfileData::phaseMilliseconds) == StepProfiler::NR_PHASES * sizeof(double), 
+			"ProfileData should contain one entry per phase of StepProfiler");
+
+		const StepProfiler* profiler = cs->GetWorld()->GetProfiler();
+		result_profileData.nrSteps = (int)profiler->GetNumberOfSteps();
+		for (int phase = 0; phase < StepProfiler::NR_PHASES; ++phase)
+			result_profileData.phaseMilliseconds[phase] = profiler->GetPhaseMilliseconds((StepProfiler::Phase)phase);
+		result_profileData.nrNeighborQueries = (long long)profiler->GetNumberOfNeighborQueries();
+		result_profileData.nrNeighborsFound = (long long)profiler->GetNumberOfNeighborsFound();
+		result_profileData.nrCostEvaluations = (long long)profiler->GetNumberOfCostEvaluations();
+
+		return true;
+	}
+
+	API_FUNCTION bool WriteProfileReport(const char* fileName)
+	{
+		if (cs == nullptr || cs->GetWorld()->GetProfiler() == nullptr)
+			return false;
+
+		std::ofstream stream(fileName);
+		if (!stream)
+			return false;
+
+		cs->GetWorld()->GetProfiler()->WriteReport(stream);
+		return true;
+	}
+
+
+	API_FUNCTION bool SetTracingEnabled(bool enabled)
+	{
+		if (cs == nullptr)
+			return false;
+
+		cs->SetTracingEnabled(enabled);
+		return true;
+	}
+
+	API_FUNCTION bool WriteTrace(const char* fileName)
+	{
+		if (cs == nullptr || cs->GetWorld()->GetTracer() == nullptr)
+			return false;
+
+		std::ofstream stream(fileName);
+		if (!stream)
+			return false;
+
+		cs->GetWorld()->GetTracer()->WriteJSON(stream);
+		return true;
+	}
+
 }
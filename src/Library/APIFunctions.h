@@ -55,6 +55,23 @@ extern "C"{
 		float viewingDirection_y;
 	};
 
+	/// <summary>A struct that summarizes the profile of the simulation steps performed so far.
+	/// This struct is used for communication between the UMANS library and external applications.</summary>
+	struct ProfileData
+	{
+		/// The number of simulation steps that have been profiled.
+		int nrSteps;
+		/// The wall-clock time (in milliseconds) spent in each phase of a simulation step, in this order: 
+		/// insertion, spatial index, neighbor search, SPH density, acceleration, contact forces, integration, removal.
+		double phaseMilliseconds[8];
+		/// The number of queries in the spatial index of agents.
+		long long nrNeighborQueries;
+		/// The total number of agents returned by these queries.
+		long long nrNeighborsFound;
+		/// The number of velocities whose cost has been requested from any cost function.
+		long long nrCostEvaluations;
+	};
+
 	/// <summary>Sets up a simulation based on a configuration file. 
 	/// After this function call, the simulation will be ready for its first time step.</summary>
 	/// <returns>true if the operation was successful; false otherwise, e.g. if the configuration file is invalid.</returns>
@@ -156,4 +173,32 @@ extern "C"{
 
 	API_FUNCTION bool AddObstacle(float* points, int nbr_points);
 
+	/// <summary>Enables or disables the profiling of simulation steps. Disabling it deletes all measurements so far.</summary>
+	/// <param ref="enabled">Whether or not to profile the simulation steps.</param>
+	/// <returns>true if the operation was successful; false otherwise, i.e. if the simulation has not been initialized (correctly) yet.</returns>
+	API_FUNCTION bool SetProfilingEnabled(bool enabled);
+
+	/// <summary>Gets a summary of the profile of all simulation steps since profiling was enabled.</summary>
+	/// <param ref="result_profileData">[out] Will store the profile data.</param>
+	/// <returns>true if the operation was successful; false otherwise, 
+	///  i.e. if the simulation has not been initialized (correctly) yet, or if profiling is not enabled.</returns>
+	API_FUNCTION bool GetProfileData(ProfileData& result_profileData);
+
+	/// <summary>Writes a readable report of the profile (including the time per thread and per cost function) to a text file.</summary>
+	/// <param ref="fileName">The name of the file to write.</param>
+	/// <returns>true if the operation was successful; false otherwise, 
+	///  i.e. if the simulation has not been initialized (correctly) yet, if profiling is not enabled, or if the file could not be written.</returns>
+	API_FUNCTION bool WriteProfileReport(const char* fileName);
+
+	/// <summary>Enables or disables the tracing of simulation steps. Disabling it deletes all recorded events.</summary>
+	/// <param ref="enabled">Whether or not to record a timeline of the simulation steps.</param>
+	/// <returns>true if the operation was successful; false otherwise, i.e. if the simulation has not been initialized (correctly) yet.</returns>
+	API_FUNCTION bool SetTracingEnabled(bool enabled);
+
+	/// <summary>Writes all events recorded since tracing was enabled to a Chrome trace (JSON) file.</summary>
+	/// <param ref="fileName">The name of the file to write.</param>
+	/// <returns>true if the operation was successful; false otherwise, 
+	///  i.e. if the simulation has not been initialized (correctly) yet, if tracing is not enabled, or if the file could not be written.</returns>
+	API_FUNCTION bool WriteTrace(const char* fileName);
+
 }
\ No newline at end of file